@@ -4,6 +4,7 @@
 
 QT += widgets network svg printsupport
 CONFIG += c++14
+DEFINES += QCUSTOMPLOT_USE_BLOCK_STORAGE QCUSTOMPLOT_COMPACT_GRAPH_DATA
 TEMPLATE = app
 TARGET = Birdview
 RESOURCES = Birdview.qrc
@@ -11,10 +12,16 @@ INCLUDEPATH += .
 !win32:QMAKE_CXXFLAGS += -Wfatal-errors
 
 # Input
-HEADERS += src/Birdview.hpp \
+HEADERS += src/Birdcage.hpp \
+           src/Birdview.hpp \
            src/ConnectDialog.hpp \
+           src/MemoryBudget.hpp \
+           src/SealedChunk.hpp \
            qcustomplot/qcustomplot.h
-SOURCES += src/Birdview.cpp \
+SOURCES += src/Birdcage.cpp \
+           src/Birdview.cpp \
            src/ConnectDialog.cpp \
+           src/MemoryBudget.cpp \
+           src/SealedChunk.cpp \
            src/main.cpp \
            qcustomplot/qcustomplot.cpp
@@ -24,6 +24,12 @@
 ****************************************************************************/
 
 #include "qcustomplot.h"
+#ifdef Q_OS_LINUX
+#  include <sys/mman.h>
+#endif
+#ifdef QCP_AVX2_DISPATCH
+#  include <immintrin.h>
+#endif
 
 
 /* including file 'src/vector2d.cpp', size 7340                              */
@@ -499,9 +505,11 @@ void QCPPainter::makeNonCosmetic()
   previous frame.
 
   The simplest paint buffer implementation is \ref QCPPaintBufferPixmap which allows regular
-  software rendering via the raster engine. Hardware accelerated rendering via pixel buffers and
-  frame buffer objects is provided by \ref QCPPaintBufferGlPbuffer and \ref QCPPaintBufferGlFbo.
-  They are used automatically if \ref QCustomPlot::setOpenGl is enabled.
+  software rendering via the raster engine. \ref QCPPaintBufferImage does the same on a QImage, so
+  it can be drawn to from other threads (see \ref QCP::phParallelLayers). Hardware accelerated
+  rendering via pixel buffers and frame buffer objects is provided by \ref QCPPaintBufferGlPbuffer
+  and \ref QCPPaintBufferGlFbo. They are used automatically if \ref QCustomPlot::setOpenGl is
+  enabled.
 */
 
 /* start documentation of pure virtual functions */
@@ -706,6 +714,75 @@ void QCPPaintBufferPixmap::reallocateBuffer()
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPPaintBufferImage
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPPaintBufferImage
+  \brief A paint buffer based on QImage, using software raster rendering
+
+  This paint buffer works like \ref QCPPaintBufferPixmap, but uses a QImage as internal buffer.
+  Unlike pixmaps, images may be painted on outside the GUI thread, so this paint buffer is used if
+  the plotting hint \ref QCP::phParallelLayers is set (and \ref QCustomPlot::setOpenGl is false).
+*/
+
+/*!
+  Creates an image paint buffer instance with the specified \a size and \a devicePixelRatio, if
+  applicable.
+*/
+QCPPaintBufferImage::QCPPaintBufferImage(const QSize &size, double devicePixelRatio) :
+  QCPAbstractPaintBuffer(size, devicePixelRatio)
+{
+  QCPPaintBufferImage::reallocateBuffer();
+}
+
+QCPPaintBufferImage::~QCPPaintBufferImage()
+{
+}
+
+/* inherits documentation from base class */
+QCPPainter *QCPPaintBufferImage::startPainting()
+{
+  QCPPainter *result = new QCPPainter(&mBuffer);
+  result->setRenderHint(QPainter::HighQualityAntialiasing);
+  return result;
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::draw(QCPPainter *painter) const
+{
+  if (painter && painter->isActive())
+    painter->drawImage(0, 0, mBuffer);
+  else
+    qDebug() << Q_FUNC_INFO << "invalid or inactive painter passed";
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::clear(const QColor &color)
+{
+  mBuffer.fill(color);
+}
+
+/* inherits documentation from base class */
+void QCPPaintBufferImage::reallocateBuffer()
+{
+  setInvalidated();
+  if (!qFuzzyCompare(1.0, mDevicePixelRatio))
+  {
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+    mBuffer = QImage(mSize*mDevicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    mBuffer.setDevicePixelRatio(mDevicePixelRatio);
+#else
+    qDebug() << Q_FUNC_INFO << "Device pixel ratios not supported for Qt versions before 5.4";
+    mDevicePixelRatio = 1.0;
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+#endif
+  } else
+  {
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+  }
+}
+
 
 #ifdef QCP_OPENGL_PBUFFER
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -8522,6 +8599,115 @@ double QCPAxis::coordToPixel(double value) const
   }
 }
 
+/*! \internal
+  
+  Transforms \a count coordinates of a linear axis to pixels like \ref QCPAxis::coordToPixel. If \a
+  reversed is false, the pixel is \a origin + (coord - \a from) / \a size * \a extent, otherwise \a
+  origin + (\a from - coord) / \a size * \a extent, with the operations in the same order as in \ref
+  QCPAxis::coordToPixel so the result is identical. \a extent is negative for vertical axes.
+  
+  This is the portable implementation, see \ref qcpLinearCoordsToPixels.
+*/
+static void qcpLinearCoordsToPixelsGeneric(const double *coords, double *pixels, int count, bool reversed, double from, double size, double extent, double origin)
+{
+  if (!reversed)
+  {
+    for (int i=0; i<count; ++i)
+      pixels[i] = (coords[i]-from)/size*extent+origin;
+  } else
+  {
+    for (int i=0; i<count; ++i)
+      pixels[i] = (from-coords[i])/size*extent+origin;
+  }
+}
+
+#ifdef QCP_AVX2_DISPATCH
+/*! \internal
+  
+  The AVX2 implementation of \ref qcpLinearCoordsToPixelsGeneric, transforming four coordinates at
+  once with the same operations.
+*/
+__attribute__((target("avx2"))) static void qcpLinearCoordsToPixelsAvx2(const double *coords, double *pixels, int count, bool reversed, double from, double size, double extent, double origin)
+{
+  const __m256d fromVector = _mm256_set1_pd(from);
+  const __m256d sizeVector = _mm256_set1_pd(size);
+  const __m256d extentVector = _mm256_set1_pd(extent);
+  const __m256d originVector = _mm256_set1_pd(origin);
+  int i = 0;
+  for (; i+4 <= count; i += 4)
+  {
+    const __m256d coord = _mm256_loadu_pd(coords+i);
+    const __m256d offset = reversed ? _mm256_sub_pd(fromVector, coord) : _mm256_sub_pd(coord, fromVector);
+    _mm256_storeu_pd(pixels+i, _mm256_add_pd(_mm256_mul_pd(_mm256_div_pd(offset, sizeVector), extentVector), originVector));
+  }
+  qcpLinearCoordsToPixelsGeneric(coords+i, pixels+i, count-i, reversed, from, size, extent, origin);
+}
+#endif
+
+typedef void (*QCPLinearCoordsToPixelsFunction)(const double *coords, double *pixels, int count, bool reversed, double from, double size, double extent, double origin);
+
+/*! \internal
+  
+  Returns the fastest implementation of \ref qcpLinearCoordsToPixelsGeneric the CPU supports.
+*/
+static QCPLinearCoordsToPixelsFunction qcpLinearCoordsToPixelsImplementation()
+{
+#ifdef QCP_AVX2_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return qcpLinearCoordsToPixelsAvx2;
+#endif
+  return qcpLinearCoordsToPixelsGeneric;
+}
+
+/*! \internal
+  
+  The implementation of \ref qcpLinearCoordsToPixelsGeneric that is used by \ref
+  QCPAxis::coordsToPixels, chosen once at runtime.
+*/
+static const QCPLinearCoordsToPixelsFunction qcpLinearCoordsToPixels = qcpLinearCoordsToPixelsImplementation();
+
+/*!
+  Transforms the \a count values in \a coords, in coordinates of the axis, to pixel coordinates of
+  the QCustomPlot widget, and writes them to \a pixels. \a coords and \a pixels may be the same
+  array.
+  
+  The result is identical to calling \ref coordToPixel for every value, but the scale type,
+  orientation and range of the axis are only looked at once. For linear axes, the values are
+  transformed with SIMD instructions where the CPU supports them.
+*/
+void QCPAxis::coordsToPixels(const double *coords, double *pixels, int count) const
+{
+  const bool horizontal = orientation() == Qt::Horizontal;
+  if (mScaleType == stLinear)
+  {
+    // horizontal: (value-lower)/size*width+left, vertical: bottom-(value-lower)/size*height, and likewise with upper-value if reversed
+    const double extent = horizontal ? mAxisRect->width() : -(double)mAxisRect->height();
+    const double origin = horizontal ? mAxisRect->left() : mAxisRect->bottom();
+    qcpLinearCoordsToPixels(coords, pixels, count, mRangeReversed, mRangeReversed ? mRange.upper : mRange.lower, mRange.size(), extent, origin);
+  } else // mScaleType == stLogarithmic
+  {
+    const double rangeLog = qLn(mRange.upper/mRange.lower);
+    const double extent = horizontal ? mAxisRect->width() : mAxisRect->height();
+    const double nearEnd = horizontal ? mAxisRect->left() : mAxisRect->bottom(); // where the range lower bound (or upper bound if reversed) is drawn
+    const double farEnd = horizontal ? mAxisRect->right() : mAxisRect->top();
+    const double outsideDirection = horizontal ? 1 : -1;
+    for (int i=0; i<count; ++i)
+    {
+      const double value = coords[i];
+      if (value >= 0 && mRange.upper < 0) // invalid value for logarithmic scale, just draw it outside visible range
+        pixels[i] = !mRangeReversed ? farEnd+200*outsideDirection : nearEnd-200*outsideDirection;
+      else if (value <= 0 && mRange.upper > 0) // invalid value for logarithmic scale, just draw it outside visible range
+        pixels[i] = !mRangeReversed ? nearEnd-200*outsideDirection : farEnd+200*outsideDirection;
+      else
+      {
+        const double pixelOffset = (!mRangeReversed ? qLn(value/mRange.lower) : qLn(mRange.upper/value))/rangeLog*extent;
+        pixels[i] = horizontal ? pixelOffset+nearEnd : nearEnd-pixelOffset;
+      }
+    }
+  }
+}
+
 /*!
   Returns the part of the axis that is hit by \a pos (in pixels). The return value of this function
   is independent of the user-selectable parts defined with \ref setSelectableParts. Further, this
@@ -10038,6 +10224,297 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
 
 //amalgamation: add datacontainer.cpp
 
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPBlockAllocator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPBlockAllocator
+  \brief Provides the memory for the blocks of QCPDataBlockStorage
+  
+  Every \ref QCPDataBlockStorage gets the memory for its blocks from an allocator. This base class
+  simply allocates every block on the heap. Subclasses may pool the blocks instead, like \ref
+  QCPHugePageAllocator does.
+  
+  The allocator that new storages use is set process-wide with \ref setInstance. A storage keeps
+  using the allocator it was constructed with, so an allocator must outlive all containers that
+  were created while it was set, including the snapshots taken of them (see \ref
+  QCPDataSnapshot). Since snapshots may release blocks when they are destroyed, \ref allocate and
+  \ref deallocate must be safe to call from any thread.
+*/
+
+static QCPBlockAllocator *qcpDefaultBlockAllocator()
+{
+  static QCPBlockAllocator allocator;
+  return &allocator;
+}
+
+static QAtomicPointer<QCPBlockAllocator> qcpCurrentBlockAllocator;
+
+/*!
+  Constructs a block allocator that allocates every block on the heap.
+*/
+QCPBlockAllocator::QCPBlockAllocator()
+{
+}
+
+QCPBlockAllocator::~QCPBlockAllocator()
+{
+}
+
+/*!
+  Returns \a bytes of memory for one block, suitably aligned for any data type.
+*/
+void *QCPBlockAllocator::allocate(qint64 bytes)
+{
+  return ::operator new(size_t(bytes));
+}
+
+/*!
+  Releases the \a memory of a block of \a bytes bytes that was returned by \ref allocate.
+*/
+void QCPBlockAllocator::deallocate(void *memory, qint64 bytes)
+{
+  Q_UNUSED(bytes)
+  ::operator delete(memory);
+}
+
+/*!
+  Returns the allocator that newly constructed block storages use.
+  
+  \see setInstance
+*/
+QCPBlockAllocator *QCPBlockAllocator::instance()
+{
+  QCPBlockAllocator *allocator = qcpCurrentBlockAllocator.loadAcquire();
+  return allocator ? allocator : qcpDefaultBlockAllocator();
+}
+
+/*!
+  Sets the \a allocator that block storages use that are constructed from now on. Storages that
+  already exist keep using their allocator. Pass 0 to restore the default, heap allocating
+  instance.
+  
+  The allocator isn't owned by QCustomPlot and must outlive the storages that use it.
+*/
+void QCPBlockAllocator::setInstance(QCPBlockAllocator *allocator)
+{
+  qcpCurrentBlockAllocator.storeRelease(allocator);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPHugePageAllocator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPHugePageAllocator
+  \brief A block allocator that packs the blocks of QCPDataBlockStorage into huge pages
+  
+  Containers with tens of millions of data points spread over thousands of pages of the default
+  page size. Every first write to such a page causes a page fault, and iterating over the data
+  misses the TLB every few kilobytes. This allocator carves blocks of the same size out of slabs
+  of \ref slabSize bytes (2 MB by default), aligned to their size. On Linux, the slabs are marked
+  with <tt>madvise(MADV_HUGEPAGE)</tt>, so with transparent huge pages enabled in "madvise" or
+  "always" mode, each slab is backed by a single huge page. On other systems, the pooling still
+  saves allocator calls.
+  
+  The slabs that still have room are kept in a list per block size, and blocks are taken from the
+  one that was used last. Allocating and deallocating a block thus takes constant time, no matter
+  how many slabs the containers occupy.
+  
+  A slab is released when its last block is deallocated, except for one spare slab that is kept
+  so that containers which keep dropping old blocks and allocating new ones don't release and
+  allocate slabs all the time. Blocks larger than a quarter slab are allocated on the heap.
+  
+  To use it, construct one before the containers, and make it the current allocator:
+  \code
+  QCPHugePageAllocator allocator;
+  QCPBlockAllocator::setInstance(&allocator);
+  \endcode
+*/
+
+/*!
+  Constructs an allocator with slabs of \a slabSize bytes, rounded up to the next power of two.
+  Choose the huge page size of the system for the slabs to be backed by huge pages.
+*/
+QCPHugePageAllocator::QCPHugePageAllocator(qint64 slabSize) :
+  mSlabSize(4096),
+  mSpareSlab(0)
+{
+  while (mSlabSize < slabSize) // blocks are mapped to their slab by address, which requires a power of two
+    mSlabSize *= 2;
+}
+
+/*!
+  Releases all slabs. Blocks that are still in use become invalid, so the allocator must outlive
+  the storages that use it.
+*/
+QCPHugePageAllocator::~QCPHugePageAllocator()
+{
+  QHash<quintptr, Slab*>::const_iterator it;
+  for (it=mSlabs.constBegin(); it!=mSlabs.constEnd(); ++it)
+  {
+    qFreeAligned(it.value()->memory);
+    delete it.value();
+  }
+  if (mSpareSlab)
+  {
+    qFreeAligned(mSpareSlab->memory);
+    delete mSpareSlab;
+  }
+}
+
+/*!
+  Returns the number of slabs that are currently allocated, including the spare one.
+*/
+int QCPHugePageAllocator::slabCount() const
+{
+  QMutexLocker locker(&mMutex);
+  return mSlabs.size() + (mSpareSlab ? 1 : 0);
+}
+
+/* inherits documentation from base class */
+void *QCPHugePageAllocator::allocate(qint64 bytes)
+{
+  if (bytes > mSlabSize/4)
+    return QCPBlockAllocator::allocate(bytes);
+  
+  QMutexLocker locker(&mMutex);
+  QVector<Slab*> &partialSlabs = mPartialSlabs[bytes];
+  Slab *target;
+  if (!partialSlabs.isEmpty())
+  {
+    target = partialSlabs.last(); // the most recently used slab, which is likely still cached
+  } else
+  {
+    target = createSlab(bytes);
+    if (!target)
+    {
+      locker.unlock();
+      return QCPBlockAllocator::allocate(bytes);
+    }
+    addPartialSlab(target);
+  }
+  
+  void *block;
+  if (!target->freeBlocks.isEmpty())
+  {
+    block = target->freeBlocks.last();
+    target->freeBlocks.removeLast();
+  } else
+  {
+    block = target->memory+target->usedBytes;
+    target->usedBytes += bytes;
+  }
+  ++target->liveBlocks;
+  if (isFull(target))
+    removePartialSlab(target);
+  return block;
+}
+
+/* inherits documentation from base class */
+void QCPHugePageAllocator::deallocate(void *memory, qint64 bytes)
+{
+  if (!memory)
+    return;
+  {
+    QMutexLocker locker(&mMutex);
+    Slab *slab = mSlabs.value(quintptr(memory) & ~quintptr(mSlabSize-1));
+    if (slab)
+    {
+      const bool wasFull = isFull(slab);
+      if (--slab->liveBlocks == 0)
+      {
+        destroySlab(slab);
+      } else
+      {
+        slab->freeBlocks.append(memory);
+        if (wasFull)
+          addPartialSlab(slab);
+      }
+      return;
+    }
+  }
+  QCPBlockAllocator::deallocate(memory, bytes); // the block didn't fit in a slab, or no slab could be allocated
+}
+
+/*! \internal
+  
+  Returns a new slab for blocks of \a blockBytes bytes, or 0 if no memory is available. The
+  spare slab is reused if there is one. Must be called with the mutex locked.
+*/
+QCPHugePageAllocator::Slab *QCPHugePageAllocator::createSlab(qint64 blockBytes)
+{
+  Slab *slab = mSpareSlab;
+  mSpareSlab = 0;
+  if (!slab)
+  {
+    char *memory = static_cast<char*>(qMallocAligned(size_t(mSlabSize), size_t(mSlabSize)));
+    if (!memory)
+      return 0;
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+    madvise(memory, size_t(mSlabSize), MADV_HUGEPAGE); // only a hint, without transparent huge pages the slab uses normal pages
+#endif
+    slab = new Slab;
+    slab->memory = memory;
+  }
+  slab->blockBytes = blockBytes;
+  slab->usedBytes = 0;
+  slab->liveBlocks = 0;
+  slab->partialIndex = -1;
+  slab->freeBlocks.clear();
+  mSlabs.insert(quintptr(slab->memory), slab);
+  return slab;
+}
+
+/*! \internal
+  
+  Releases \a slab, which has no blocks in use anymore, or keeps it as the spare slab. Must be
+  called with the mutex locked.
+*/
+void QCPHugePageAllocator::destroySlab(Slab *slab)
+{
+  mSlabs.remove(quintptr(slab->memory));
+  removePartialSlab(slab); // a slab holds at least four blocks, so it wasn't full before its last one was deallocated
+  if (!mSpareSlab)
+  {
+    mSpareSlab = slab;
+  } else
+  {
+    qFreeAligned(slab->memory);
+    delete slab;
+  }
+}
+
+/*! \internal
+  
+  Appends \a slab to the list of slabs with room for its block size, so it is the next one blocks
+  of that size are taken from. Must be called with the mutex locked.
+*/
+void QCPHugePageAllocator::addPartialSlab(Slab *slab)
+{
+  QVector<Slab*> &partialSlabs = mPartialSlabs[slab->blockBytes];
+  slab->partialIndex = partialSlabs.size();
+  partialSlabs.append(slab);
+}
+
+/*! \internal
+  
+  Removes \a slab from the list of slabs with room in constant time, by moving the last slab of
+  the list to its position. Does nothing if \a slab is full. Must be called with the mutex locked.
+*/
+void QCPHugePageAllocator::removePartialSlab(Slab *slab)
+{
+  if (slab->partialIndex < 0)
+    return;
+  QVector<Slab*> &partialSlabs = mPartialSlabs[slab->blockBytes];
+  Slab *last = partialSlabs.last();
+  partialSlabs[slab->partialIndex] = last;
+  last->partialIndex = slab->partialIndex;
+  partialSlabs.removeLast();
+  slab->partialIndex = -1;
+}
+
 /* including file 'src/plottable.cpp', size 38861                            */
 /* commit 633339dadc92cb10c58ef3556b55570685fafb99 2016-09-13 23:54:56 +0200 */
 
@@ -10964,6 +11441,30 @@ void QCPAbstractPlottable::applyScattersAntialiasingHint(QCPPainter *painter) co
   applyAntialiasingHint(painter, mAntialiasedScatters, QCP::aeScatters);
 }
 
+/*! \internal
+  
+  Brings the data of this plottable into a state in which drawing only reads it. \ref
+  QCustomPlot::drawLayersParallel calls this in the GUI thread for all plottables, before it draws
+  layers concurrently.
+  
+  The default implementation does nothing. \ref QCPAbstractPlottable1D reimplements it to call
+  \ref QCPDataContainer::prepareForReading.
+*/
+void QCPAbstractPlottable::prepareDataForReading() const
+{
+}
+
+/*! \internal
+  
+  Returns the object that holds the data of this plottable, e.g. its data container, or 0 if it
+  has none. Several plottables may share the same data object, and \ref
+  QCustomPlot::drawLayersParallel doesn't draw them concurrently.
+*/
+const void *QCPAbstractPlottable::dataObject() const
+{
+  return 0;
+}
+
 /* inherits documentation from base class */
 void QCPAbstractPlottable::selectEvent(QMouseEvent *event, bool additive, const QVariant &details, bool *selectionStateChanged)
 {
@@ -12912,8 +13413,14 @@ void QCustomPlot::setNoAntialiasingOnDrag(bool enabled)
 */
 void QCustomPlot::setPlottingHints(const QCP::PlottingHints &hints)
 {
+  const bool parallelLayersChanged = (hints^mPlottingHints).testFlag(QCP::phParallelLayers);
   mPlottingHints = hints;
-}
+  if (parallelLayersChanged && !mOpenGl) // switch between pixmap and image paint buffers
+  {
+    mPaintBuffers.clear();
+    setupPaintBuffers();
+  }
+}
 
 /*!
   Sets the specified plotting \a hint to \a enabled.
@@ -14127,6 +14634,14 @@ void QCustomPlot::deselectAll()
   If a layer is in mode \ref QCPLayer::lmBuffered (\ref QCPLayer::setMode), it is also possible to
   replot only that specific layer via \ref QCPLayer::replot. See the documentation there for
   details.
+  
+  With the plotting hint \ref QCP::phParallelLayers, the buffered layers are drawn concurrently to
+  each other and to the logical layers (see \ref drawLayersParallel), which spreads the
+  rasterization of e.g. one layer of graphs per device over several cores. This method still
+  returns only once all layers are drawn. Layers whose layerables depend on each other while
+  drawing, e.g. a graph and its channel fill graph (\ref QCPGraph::setChannelFillGraph), are drawn
+  by the same thread, and layers that paint QPixmaps, e.g. pixmap items or axes with cached tick
+  labels (\ref QCP::phCacheLabels), are drawn in the GUI thread.
 */
 void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
 {
@@ -14149,8 +14664,13 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority)
   updateLayout();
   // draw all layered objects (grid, axes, plottables, items, legend,...) into their buffers:
   setupPaintBuffers();
-  foreach (QCPLayer *layer, mLayers)
-    layer->drawToPaintBuffer();
+  if (mPlottingHints.testFlag(QCP::phParallelLayers) && !mOpenGl)
+    drawLayersParallel();
+  else
+  {
+    foreach (QCPLayer *layer, mLayers)
+      layer->drawToPaintBuffer();
+  }
   for (int i=0; i<mPaintBuffers.size(); ++i)
     mPaintBuffers.at(i)->setInvalidated(false);
   
@@ -14829,8 +15349,8 @@ void QCustomPlot::setupPaintBuffers()
 
   This method is used by \ref setupPaintBuffers when it needs to create new paint buffers.
 
-  Depending on the current setting of \ref setOpenGl, and the current Qt version, different
-  backends (subclasses of \ref QCPAbstractPaintBuffer) are created, initialized with the proper
+  Depending on the current setting of \ref setOpenGl, the plotting hint \ref QCP::phParallelLayers
+  and the current Qt version, different backends (subclasses of \ref QCPAbstractPaintBuffer) are created, initialized with the proper
   size and device pixel ratio, and returned.
 */
 QCPAbstractPaintBuffer *QCustomPlot::createPaintBuffer()
@@ -14845,10 +15365,229 @@ QCPAbstractPaintBuffer *QCustomPlot::createPaintBuffer()
     qDebug() << Q_FUNC_INFO << "OpenGL enabled even though no support for it compiled in, this shouldn't have happened. Falling back to pixmap paint buffer.";
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 #endif
-  } else
+  } else if (mPlottingHints.testFlag(QCP::phParallelLayers))
+    return new QCPPaintBufferImage(viewport().size(), mBufferDevicePixelRatio);
+  else
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 }
 
+/*! \internal
+  
+  The state of one group of layers of \ref QCustomPlot::drawLayersParallel. It is shared between
+  the GUI thread and a \ref QCPLayerDrawTask, and whichever claims it first draws the layers, in
+  order.
+*/
+class QCPLayerDrawJob
+{
+public:
+  QCPLayerDrawJob() : done(0) {}
+  
+  bool claim() { return claimed.testAndSetOrdered(0, 1); }
+  void draw() { foreach (QCPLayer *layer, layers) layer->drawToPaintBuffer(); }
+  
+  QAtomicInt claimed;
+  QSemaphore *done;
+  QList<QCPLayer*> layers;
+};
+
+/*! \internal
+  
+  Draws the layers of a \ref QCPLayerDrawJob on a thread of the pool, unless the GUI thread has
+  already claimed it. The task may run after the replot has finished, so it only holds a shared
+  reference to the job.
+*/
+class QCPLayerDrawTask : public QRunnable
+{
+public:
+  explicit QCPLayerDrawTask(const QSharedPointer<QCPLayerDrawJob> &job) : mJob(job) {}
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    if (mJob->claim())
+    {
+      mJob->draw();
+      mJob->done->release();
+    }
+  }
+  
+private:
+  QSharedPointer<QCPLayerDrawJob> mJob;
+};
+
+/*! \internal
+  
+  Returns the index of the layer that represents the group of the layer with index \a layer in \a
+  groups, which holds the index of a layer of the same group for every layer (see \ref
+  qcpJoinLayerGroups).
+*/
+static int qcpLayerGroup(QVector<int> &groups, int layer)
+{
+  while (groups.at(layer) != layer)
+  {
+    groups[layer] = groups.at(groups.at(layer)); // shortens the path for later lookups
+    layer = groups.at(layer);
+  }
+  return layer;
+}
+
+/*! \internal
+  
+  Merges the groups of the layers \a first and \a second in \a groups, so \ref
+  QCustomPlot::drawLayersParallel draws them in the same thread. Does nothing if either is 0.
+*/
+static void qcpJoinLayerGroups(QVector<int> &groups, QCPLayer *first, QCPLayer *second)
+{
+  if (first && second)
+    groups[qcpLayerGroup(groups, first->index())] = qcpLayerGroup(groups, second->index());
+}
+
+/*! \internal
+  
+  Returns whether \a layerable may paint QPixmaps, which is only supported in the GUI thread. These
+  are pixmap items, scatters of type \ref QCPScatterStyle::ssPixmap, legend icons of color maps,
+  axis rect backgrounds and axes with cached tick labels (see \ref QCP::phCacheLabels).
+*/
+static bool qcpDrawsPixmaps(QCPLayerable *layerable)
+{
+  if (QCPPlottableLegendItem *legendItem = qobject_cast<QCPPlottableLegendItem*>(layerable))
+  {
+    if (qobject_cast<QCPColorMap*>(legendItem->plottable()))
+      return true;
+    layerable = legendItem->plottable();
+  }
+  QCPScatterStyle scatterStyle;
+  if (QCPGraph *graph = qobject_cast<QCPGraph*>(layerable))
+    scatterStyle = graph->scatterStyle();
+  else if (QCPCurve *curve = qobject_cast<QCPCurve*>(layerable))
+    scatterStyle = curve->scatterStyle();
+  else if (qobject_cast<QCPItemPixmap*>(layerable))
+    return true;
+  else if (QCPAxisRect *axisRect = qobject_cast<QCPAxisRect*>(layerable))
+    return !axisRect->background().isNull();
+  else if (QCPAxis *axis = qobject_cast<QCPAxis*>(layerable))
+    return axis->parentPlot()->plottingHints().testFlag(QCP::phCacheLabels);
+  else
+    return false;
+  
+  QCPAbstractPlottable *plottable = static_cast<QCPAbstractPlottable*>(layerable);
+  if (plottable->selectionDecorator())
+    scatterStyle = plottable->selectionDecorator()->getFinalScatterStyle(scatterStyle);
+  return scatterStyle.shape() == QCPScatterStyle::ssPixmap;
+}
+
+/*! \internal
+  
+  Draws all layers into their paint buffers like \ref replot does without the plotting hint \ref
+  QCP::phParallelLayers, but the layers in mode \ref QCPLayer::lmBuffered, which have a paint buffer
+  of their own, are drawn on QThreadPool::globalInstance. Meanwhile, the calling thread draws the
+  \ref QCPLayer::lmLogical layers in order, which share paint buffers and usually hold the axes,
+  grids and legends. Afterwards, it draws the buffered layers that no pool thread has started yet,
+  so this never waits for pool threads that are busy with other work. When this returns, all
+  layers are drawn, and \ref paintEvent only composites the paint buffers.
+  
+  Layerables on different layers may depend on each other while drawing: A graph computes the lines
+  of its channel fill graph (\ref QCPGraph::setChannelFillGraph), plottables may share their data
+  (see \ref QCPAbstractPlottable::dataObject), a tracer reads the data of its graph, and items
+  may be positioned relative to the anchors of other items. Such layers are joined into one group,
+  which is drawn by a single thread. Groups that contain a logical layer, or a layerable that
+  paints QPixmaps (see \ref qcpDrawsPixmaps), are drawn by the calling thread. Before any layer is
+  drawn, the data of all plottables is prepared, so that drawing only reads it (see \ref
+  QCPAbstractPlottable::prepareDataForReading).
+*/
+void QCustomPlot::drawLayersParallel()
+{
+  updateLayerIndices();
+  foreach (QCPAbstractPlottable *plottable, mPlottables)
+    plottable->prepareDataForReading();
+  
+  // join the layers of layerables that depend on each other while drawing:
+  QVector<int> groups(mLayers.size());
+  for (int i=0; i<groups.size(); ++i)
+    groups[i] = i;
+  QHash<const void*, QCPLayer*> dataLayers;
+  foreach (QCPAbstractPlottable *plottable, mPlottables)
+  {
+    if (QCPGraph *graph = qobject_cast<QCPGraph*>(plottable))
+    {
+      if (graph->channelFillGraph())
+        qcpJoinLayerGroups(groups, graph->layer(), graph->channelFillGraph()->layer());
+    }
+    if (const void *data = plottable->dataObject())
+    {
+      if (dataLayers.contains(data))
+        qcpJoinLayerGroups(groups, plottable->layer(), dataLayers.value(data));
+      else
+        dataLayers.insert(data, plottable->layer());
+    }
+  }
+  QHash<QCPItemAnchor*, QCPAbstractItem*> anchorItems;
+  foreach (QCPAbstractItem *item, mItems)
+  {
+    foreach (QCPItemAnchor *anchor, item->anchors())
+      anchorItems.insert(anchor, item);
+  }
+  foreach (QCPAbstractItem *item, mItems)
+  {
+    if (QCPItemTracer *tracer = qobject_cast<QCPItemTracer*>(item))
+    {
+      if (tracer->graph())
+        qcpJoinLayerGroups(groups, tracer->layer(), tracer->graph()->layer());
+    }
+    foreach (QCPItemPosition *position, item->positions())
+    {
+      if (QCPAbstractItem *parentItem = anchorItems.value(position->parentAnchorX()))
+        qcpJoinLayerGroups(groups, item->layer(), parentItem->layer());
+      if (QCPAbstractItem *parentItem = anchorItems.value(position->parentAnchorY()))
+        qcpJoinLayerGroups(groups, item->layer(), parentItem->layer());
+    }
+  }
+  
+  // groups with logical layers or pixmaps are drawn by this thread:
+  QVector<bool> serialGroups(mLayers.size(), false);
+  foreach (QCPLayer *layer, mLayers)
+  {
+    bool serial = layer->mode() == QCPLayer::lmLogical;
+    for (int i=0; i<layer->children().size() && !serial; ++i)
+      serial = qcpDrawsPixmaps(layer->children().at(i));
+    if (serial)
+      serialGroups[qcpLayerGroup(groups, layer->index())] = true;
+  }
+  
+  QSemaphore done;
+  QVector<QSharedPointer<QCPLayerDrawJob> > groupJobs(mLayers.size());
+  QList<QSharedPointer<QCPLayerDrawJob> > jobs;
+  foreach (QCPLayer *layer, mLayers)
+  {
+    const int group = qcpLayerGroup(groups, layer->index());
+    if (serialGroups.at(group) || layer->children().isEmpty()) // an empty layer leaves its paint buffer cleared
+      continue;
+    if (!groupJobs.at(group))
+    {
+      groupJobs[group] = QSharedPointer<QCPLayerDrawJob>(new QCPLayerDrawJob);
+      groupJobs[group]->done = &done;
+      jobs.append(groupJobs.at(group));
+    }
+    groupJobs[group]->layers.append(layer);
+  }
+  for (int i=0; i<jobs.size(); ++i)
+    QThreadPool::globalInstance()->start(new QCPLayerDrawTask(jobs.at(i)));
+  
+  foreach (QCPLayer *layer, mLayers)
+  {
+    if (serialGroups.at(qcpLayerGroup(groups, layer->index())))
+      layer->drawToPaintBuffer();
+  }
+  int pending = 0;
+  for (int i=0; i<jobs.size(); ++i)
+  {
+    if (jobs.at(i)->claim())
+      jobs.at(i)->draw();
+    else
+      ++pending;
+  }
+  done.acquire(pending);
+}
+
 /*!
   This method returns whether any of the paint buffers held by this QCustomPlot instance are
   invalidated.
@@ -15442,6 +16181,26 @@ void QCustomPlot::toPainter(QCPPainter *painter, int width, int height)
   } else
     qDebug() << Q_FUNC_INFO << "Passed painter is not active";
 }
+
+/*!
+  Returns the number of bytes taken up by the paint buffers of the plot (see \ref
+  QCPLayer::setMode), assuming four bytes per pixel. With OpenGL enabled (see \ref setOpenGl), the
+  buffers live in graphics memory.
+  
+  The buffers are as large as the viewport, scaled by the buffer device pixel ratio (see \ref
+  setBufferDevicePixelRatio), so this grows with the widget size and the number of layers in \ref
+  QCPLayer::lmBuffered mode.
+*/
+qint64 QCustomPlot::paintBufferMemoryUsage() const
+{
+  qint64 bytes = 0;
+  for (int i=0; i<mPaintBuffers.size(); ++i)
+  {
+    const QCPAbstractPaintBuffer *buffer = mPaintBuffers.at(i).data();
+    bytes += qint64(buffer->size().width()*buffer->devicePixelRatio())*qint64(buffer->size().height()*buffer->devicePixelRatio())*4;
+  }
+  return bytes;
+}
 /* end of 'src/core.cpp' */
 
 //amalgamation: add plottable1d.cpp
@@ -19640,6 +20399,30 @@ void QCPColorScaleAxisRectPrivate::axisSelectableChanged(QCPAxis::SelectablePart
   \ref QCPDataContainer with \ref QCPGraphData as the DataType template parameter. See the
   documentation there for an explanation regarding the data type's generic methods.
   
+  If \c QCUSTOMPLOT_COMPACT_GRAPH_DATA is defined when compiling QCustomPlot and the application,
+  \a value is stored as a single precision float, and the keys are stored more compactly:
+  
+  \li If \c QCUSTOMPLOT_USE_BLOCK_STORAGE is defined as well, \a key stays a double, but the
+  blocks of the \ref QCPGraphDataContainer hold the data points as 8 byte \ref QCPPackedGraphData
+  elements, with the keys as float offsets from a base per block of 4096 data points. A graph's
+  data then needs half the memory, and twice as many data points fit into a cache line when the
+  graph is drawn.
+  \li Otherwise, \a key is stored as a \ref QCPCompactKey, i.e. as integer ticks, and a data point
+  takes 12 instead of 16 bytes, a quarter less memory.
+  
+  The interface stays the same, all methods still take and return double, and \a key converts to
+  and from double implicitly.
+  
+  The price is the precision. With the packed blocks, a key stored in a container is rounded down
+  to a float offset from the base of its block, so its absolute error is at most about 2^-24 of
+  its distance from the base, i.e. it depends on the key span of the block, not on the magnitude
+  of the key (see \ref QCPPackedGraphData for the details). With \ref QCPCompactKey, keys are
+  rounded to the tick resolution, by default a nanosecond for keys in seconds, so unlike with a
+  float, the absolute error of a key doesn't grow with its magnitude either. Values are rounded to
+  the nearest float, so their relative error is at most 2^-24 (about 6e-8), and magnitudes beyond
+  about 3.4e38 become infinite. This is lossless if the values already come as single precision
+  floats.
+  
   \see QCPGraphDataContainer
 */
 
@@ -19715,147 +20498,525 @@ QCPGraphData::QCPGraphData(double key, double value) :
 }
 
 
+#ifdef QCUSTOMPLOT_COMPACT_GRAPH_DATA
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPGraph
+//////////////////// QCPCompactKey
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPGraph
-  \brief A plottable representing a graph in a plot.
-
-  \image html QCPGraph.png
-  
-  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
-  accessed via QCustomPlot::graph.
-
-  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
-  also access and modify the data via the \ref data method, which returns a pointer to the internal
-  \ref QCPGraphDataContainer.
+/*! \class QCPCompactKey
+  \brief Holds the key of a QCPGraphData as integer ticks
   
-  Graphs are used to display single-valued data. Single-valued means that there should only be one
-  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
-  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  If \c QCUSTOMPLOT_COMPACT_GRAPH_DATA is defined without \c QCUSTOMPLOT_USE_BLOCK_STORAGE, this
+  is the type of \ref QCPGraphData::key (with the block storage, see \ref QCPPackedGraphData). It
+  stores the key as a signed 64 bit number of ticks of a fixed resolution, and converts implicitly
+  to and from double, so code reading and writing the key as a double works unchanged.
   
-  Gaps in the graph line can be created by adding data points with NaN as value
-  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
-  separated.
+  The number of ticks per key unit is set with the define \c QCUSTOMPLOT_COMPACT_KEY_TICKS, which
+  defaults to 1e9. For keys in seconds, that's a resolution of a nanosecond. A key is rounded to
+  the nearest tick, so the absolute error is at most half a tick, plus the rounding of the
+  returned double itself, independent of the magnitude of the key. With the default, keys between
+  about -9.2e9 and 9.2e9 can be represented, which covers timestamps in seconds since epoch until
+  the year 2262. Keys beyond that are clamped to the limits. NaN is preserved.
   
-  \section qcpgraph-appearance Changing the appearance
+  The ticks are stored as two 32 bit halves, so the key only needs 4 byte alignment and a \ref
+  QCPGraphData with a float value takes 12 bytes.
+*/
+
+/* start documentation of inline functions */
+
+/*! \fn qint64 QCPCompactKey::ticks() const
   
-  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
-  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  Returns the key as the number of ticks since key zero.
+*/
+
+/*! \fn double QCPCompactKey::key() const
   
-  \subsection filling Filling under or between graphs
+  Returns the key, or NaN if it was set to NaN. The key converts to double implicitly with the
+  same result.
+*/
+
+/*! \fn void QCPCompactKey::setKey(double key)
   
-  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
-  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
-  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  Sets the key to \a key, rounded to the nearest tick. Keys beyond the representable range are
+  clamped to its limits, NaN is stored as is.
+*/
+
+/*! \fn static double QCPCompactKey::resolution()
   
-  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
-  between this graph and another one, call \ref setChannelFillGraph with the other graph as
-  parameter.
+  Returns the key difference of one tick, the inverse of \c QCUSTOMPLOT_COMPACT_KEY_TICKS.
+*/
 
-  \see QCustomPlot::addGraph, QCustomPlot::graph
+/* end documentation of inline functions */
+#endif
+
+
+#ifdef QCP_PACKED_GRAPH_DATA
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPPackedGraphData
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPPackedGraphData
+  \brief Holds one data point of a QCPGraphDataContainer in a block of QCPDataBlockStorage
+  
+  If both \c QCUSTOMPLOT_COMPACT_GRAPH_DATA and \c QCUSTOMPLOT_USE_BLOCK_STORAGE are defined, the
+  blocks of a \ref QCPGraphDataContainer don't hold \ref QCPGraphData, but this 8 byte element (see
+  \ref QCPDataBlockTraits). The \a value is the single precision value of the data point, and \a
+  key is a single precision offset from the \a base of the block, which is stored once in the \ref
+  Header in front of the elements of every block. The key of a data point is <tt>base+key</tt>,
+  calculated in double precision.
+  
+  A block takes the first key written to it as its base, and again the first key whenever its
+  first slot is written (see \ref writeRange). The base is rounded down slightly, see \ref setBase.
+  A key is rounded down to the next key that is representable relative to the base (see \ref
+  keyOffset), so the keys in a block keep their order, and the absolute error of a key is less
+  than 2^-23 times its distance from the base, i.e. it depends on the key span of the 4096 data
+  points of the block instead of the key itself. Timestamps in seconds since epoch with samples a
+  millisecond apart thus keep sub-microsecond precision. The error doesn't add up when data points
+  are moved between blocks by edits. Keys that lie on a binary grid of at most 2^24 steps from the
+  base are stored exactly. NaN and infinite keys are preserved, see \ref keyOffset for keys out of
+  the float range.
+  
+  The iterators of the storage (\ref QCPPackedGraphDataIterator) convert the elements to and from
+  \ref QCPGraphData on the fly. Reading returns a \ref QCPGraphData by value, writing goes through
+  a \ref QCPPackedGraphDataReference proxy, so whole data points can be written with <tt>*it =
+  QCPGraphData(key, value)</tt>, while <tt>it->value = value</tt> doesn't compile.
 */
 
-/* start of documentation of inline functions */
+/* start documentation of inline functions */
 
-/*! \fn QSharedPointer<QCPGraphDataContainer> QCPGraph::data() const
+/*! \fn static Header *QCPPackedGraphData::header(QCPPackedGraphData *block)
   
-  Returns a shared pointer to the internal data storage of type \ref QCPGraphDataContainer. You may
-  use it to directly manipulate the data, which may be more convenient and faster than using the
-  regular \ref setData or \ref addData methods.
+  Returns the header of \a block, which is stored right in front of its first element.
 */
 
-/* end of documentation of inline functions */
+/*! \fn static QCPGraphData QCPPackedGraphData::at(const QCPPackedGraphData *block, int slot)
+  
+  Returns the data point in \a slot of \a block.
+*/
 
-/*!
-  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
-  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
-  the same orientation. If either of these restrictions is violated, a corresponding message is
-  printed to the debug output (qDebug), the construction is not aborted, though.
+/*! \fn static QCPPackedGraphDataReference QCPPackedGraphData::at(QCPPackedGraphData *block, int slot)
+  \overload
   
-  The created QCPGraph is automatically registered with the QCustomPlot instance inferred from \a
-  keyAxis. This QCustomPlot instance takes ownership of the QCPGraph, so do not delete it manually
-  but use QCustomPlot::removePlottable() instead.
+  Returns a proxy that reads and writes the data point in \a slot of \a block.
+*/
+
+/*! \fn static void QCPPackedGraphData::write(QCPPackedGraphData *block, int slot, const QCPGraphData &data)
   
-  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+  Writes \a data to \a slot of \a block. If the block has no base yet, the key of \a data becomes
+  the base. Writing the first slot moves the base like \ref writeRange.
 */
-QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis)
-{
-  // special handling for QCPGraphs to maintain the simple graph interface:
-  mParentPlot->registerGraph(this);
 
-  setPen(QPen(Qt::blue, 0));
-  setBrush(Qt::NoBrush);
+/*! \struct QCPPackedGraphData::Header
   
-  setLineStyle(lsLine);
-  setScatterSkip(0);
-  setChannelFillGraph(0);
-  setAdaptiveSampling(true);
-}
+  The header in front of the elements of every block. \a base is the key that the key offsets of
+  the elements are relative to, and \a range the distance from the base that the keys of the block
+  stay below. The base is a multiple of \a range times 2^-24. A \a range of zero means that the
+  block has no base yet, because no finite key was written to it.
+*/
 
-QCPGraph::~QCPGraph()
-{
-}
+/* end documentation of inline functions */
 
-/*! \overload
+/*! \class QCPPackedGraphDataReference
+  \brief The reference type of the mutable iterators of packed graph data blocks
   
-  Replaces the current data container with the provided \a data container.
+  Converts to the \ref QCPGraphData in its slot, and assigning a \ref QCPGraphData encodes it into
+  the slot with \ref QCPPackedGraphData::write. Assigning another reference assigns its data point,
+  it doesn't rebind the reference, so standard algorithms can copy and swap through it.
+*/
+
+/*! \class QCPPackedGraphDataPointer
+  \brief The pointer type of the iterators of packed graph data blocks
   
-  Since a QSharedPointer is used, multiple QCPGraphs may share the same data container safely.
-  Modifying the data in the container will then affect all graphs that share the container. Sharing
-  can be achieved by simply exchanging the data containers wrapped in shared pointers:
-  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpgraph-datasharing-1
+  Holds a decoded copy of a data point, so \c it->key and \c it->value can be read. Data points
+  can't be modified through it, use <tt>*it = QCPGraphData(key, value)</tt> instead.
+*/
+
+/*! \class QCPPackedGraphDataIterator
+  \brief The iterators of the blocks of a QCPDataBlockStorage<QCPGraphData> with packed elements
   
-  If you do not wish to share containers, but create a copy from an existing container, rather use
-  the \ref QCPDataContainer<DataType>::set method on the graph's data container directly:
-  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpgraph-datasharing-2
+  Works like \ref QCPDataBlockIterator, but dereferencing decodes the \ref QCPPackedGraphData in
+  the slot. The const iterator returns the \ref QCPGraphData by value, the mutable iterator returns
+  a \ref QCPPackedGraphDataReference. \ref block and \ref slot give access to the packed elements,
+  e.g. for processing them in bulk.
+*/
+
+/*!
+  Writes the \a count data points in \a data to \a block, starting at \a slot.
   
-  \see addData
+  If the range starts at the first slot of the block, the base of the block is moved to the first
+  finite key of the range (see \ref Header), so data points written in key order are stored with
+  the best precision. The data points behind the range are then encoded again for the new base.
 */
-void QCPGraph::setData(QSharedPointer<QCPGraphDataContainer> data)
+void QCPPackedGraphData::writeRange(QCPPackedGraphData *block, int slot, const QCPGraphData *data, int count)
 {
-  mDataContainer = data;
+  if (slot == 0)
+  {
+    int firstFinite = 0;
+    while (firstFinite < count && !qIsFinite(data[firstFinite].key))
+      ++firstFinite;
+    if (firstFinite < count)
+      setBase(block, data[firstFinite].key, count);
+  }
+  for (int i=0; i<count; ++i)
+    store(block, slot+i, data[i]);
 }
 
-/*! \overload
-  
-  Replaces the current data with the provided points in \a keys and \a values. The provided
-  vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+/*! \internal
   
-  If you can guarantee that the passed data points are sorted by \a keys in ascending order, you
-  can set \a alreadySorted to true, to improve performance by saving a sorting run.
+  Sets the base of \a block to \a key, rounded down to a multiple of a power of two of about 2^-36
+  times the magnitude of \a key, and the range to 2^24 times that power of two. If the block
+  already had a different base, the elements from slot \a from to the end of the block are encoded
+  again, and the range is extended so they fit.
+  
+  The rounding costs far less precision than the float offsets of a block of keys lose anyway,
+  but it makes the base a multiple of the resolution of every offset in the range. So all keys of
+  a block lie on the same binary grids as the keys of any other block, and a key that is encoded
+  again for a different base is either kept or rounded down to a coarser grid. Its error doesn't
+  add up when data points are moved between blocks again and again.
+*/
+void QCPPackedGraphData::setBase(QCPPackedGraphData *block, double key, int from)
+{
+  const int blockSize = 1 << QCPDataBlockTraits<QCPGraphData>::blockShift;
+  Header *blockHeader = header(block);
+  const Header oldHeader = *blockHeader;
+  int exponent;
+  std::frexp(key, &exponent);
+  const double step = std::ldexp(1.0, exponent-36);
+  if (key == 0 || step == 0) // zero is a multiple of every power of two
+  {
+    blockHeader->base = 0;
+    blockHeader->range = std::numeric_limits<double>::infinity();
+  } else
+  {
+    blockHeader->base = std::floor(key/step)*step;
+    blockHeader->range = std::ldexp(step, 24);
+  }
+  if (oldHeader.range > 0 && (blockHeader->base != oldHeader.base || blockHeader->range != oldHeader.range))
+  {
+    double distance = 0;
+    for (int i=from; i<blockSize; ++i)
+    {
+      const double oldKey = oldHeader.base+block[i].key;
+      if (qIsFinite(oldKey) && qAbs(oldKey-blockHeader->base) > distance)
+        distance = qAbs(oldKey-blockHeader->base);
+    }
+    fitRange(blockHeader, distance);
+    encodeAgain(block, oldHeader, from);
+  }
+}
+
+/*! \internal
   
-  \see addData
+  Makes the finite \a key fit the range of \a block. If the block has no base yet, \a key becomes
+  the base, otherwise the range is extended and all elements of the block are encoded again.
 */
-void QCPGraph::setData(const QVector<double> &keys, const QVector<double> &values, bool alreadySorted)
+void QCPPackedGraphData::extendRange(QCPPackedGraphData *block, double key)
 {
-  mDataContainer->clear();
-  addData(keys, values, alreadySorted);
+  Header *blockHeader = header(block);
+  if (blockHeader->range == 0)
+  {
+    setBase(block, key, 0);
+    return;
+  }
+  const Header oldHeader = *blockHeader;
+  fitRange(blockHeader, qAbs(key-blockHeader->base));
+  if (blockHeader->range != oldHeader.range)
+    encodeAgain(block, oldHeader, 0);
 }
 
-/*!
-  Sets how the single data points are connected in the plot. For scatter-only plots, set \a ls to
-  \ref lsNone and \ref setScatterStyle to the desired scatter style.
+/*! \internal
   
-  \see setScatterStyle
+  Extends the range of \a blockHeader to at least 256 times \a distance, if \a distance isn't in it
+  already, and rounds the base down to the coarser power of two that comes with the larger range.
+  Keys further from the base than the largest float can't be encoded anyway and become infinite,
+  so they don't extend the range.
 */
-void QCPGraph::setLineStyle(LineStyle ls)
+void QCPPackedGraphData::fitRange(Header *blockHeader, double distance)
 {
-  mLineStyle = ls;
+  if (distance < blockHeader->range || distance > std::numeric_limits<float>::max())
+    return;
+  int exponent;
+  std::frexp(distance, &exponent);
+  const double step = std::ldexp(1.0, exponent+8-24);
+  blockHeader->base = std::floor(blockHeader->base/step)*step;
+  blockHeader->range = std::ldexp(step, 24);
 }
 
-/*!
-  Sets the visual appearance of single data points in the plot. If set to \ref QCPScatterStyle::ssNone, no scatter points
-  are drawn (e.g. for line-only-plots with appropriate line style).
+/*! \internal
   
-  \see QCPScatterStyle, setLineStyle
+  Encodes the elements of \a block from slot \a from to the end again for the current header of the
+  block. Their offsets were relative to \a oldHeader.
 */
-void QCPGraph::setScatterStyle(const QCPScatterStyle &style)
+void QCPPackedGraphData::encodeAgain(QCPPackedGraphData *block, const Header &oldHeader, int from)
 {
-  mScatterStyle = style;
+  const int blockSize = 1 << QCPDataBlockTraits<QCPGraphData>::blockShift;
+  const double base = header(block)->base;
+  for (int i=from; i<blockSize; ++i)
+    block[i].key = keyOffset(base, oldHeader.base+block[i].key);
+}
+
+/*!
+  Returns the largest offset from \a base that doesn't decode to a larger key than \a key, i.e.
+  \a key rounded down to the keys that are representable relative to \a base. Rounding down
+  instead of to the nearest makes the encoding monotonic and keeps a decoded key unchanged when it
+  is encoded again with the same base.
+  
+  Infinite keys stay infinite and NaN stays NaN. Keys too far from \a base for a float offset are
+  rounded down as well, to the largest offset above the base and to negative infinity below it.
+*/
+float QCPPackedGraphData::keyOffset(double base, double key)
+{
+  if (qIsNaN(key))
+    return std::numeric_limits<float>::quiet_NaN();
+  return fromOrdered(lastOffset(base, key, false));
+}
+
+/*!
+  Returns the smallest offset from \a base that doesn't decode to a smaller key than \a key. An
+  element of a block with that base has a smaller key than \a key exactly if its offset is smaller
+  than the returned one, so sampling can compare the offsets directly.
+*/
+float QCPPackedGraphData::keyOffsetBound(double base, double key)
+{
+  if (qIsNaN(key))
+    return std::numeric_limits<float>::quiet_NaN();
+  return fromOrdered(qMin(lastOffset(base, key, true)+1, qint64(toOrdered(std::numeric_limits<float>::infinity()))));
+}
+
+/*! \internal
+  
+  Returns the largest offset from \a base that decodes to a key smaller than \a key (if \a strict
+  is true) or not larger than \a key, as the integer returned by \ref toOrdered. If there is none,
+  returns the integer in front of negative infinity.
+  
+  The search starts at the offset closest to the difference of the keys, which is the result or
+  its neighbor in most cases, and widens its steps exponentially from there. Close to a large
+  base, many floats may decode to the same double, so stepping one by one isn't enough.
+*/
+qint64 QCPPackedGraphData::lastOffset(double base, double key, bool strict)
+{
+  const qint64 infinity = toOrdered(std::numeric_limits<float>::infinity());
+  const double difference = key-base;
+  qint64 start;
+  if (difference > std::numeric_limits<float>::max())
+    start = infinity;
+  else if (difference < -std::numeric_limits<float>::max())
+    start = -infinity;
+  else
+    start = toOrdered(float(difference));
+  
+  qint64 low = -infinity-1; // the result is in [low, high), low counts as matching
+  qint64 high = infinity+1;
+  if (offsetMatches(base, key, strict, start))
+  {
+    low = start;
+    for (qint64 step=1; low+step < high; step *= 2)
+    {
+      if (!offsetMatches(base, key, strict, low+step))
+      {
+        high = low+step;
+        break;
+      }
+      low += step;
+    }
+  } else
+  {
+    high = start;
+    for (qint64 step=1; high-step > low; step *= 2)
+    {
+      if (offsetMatches(base, key, strict, high-step))
+      {
+        low = high-step;
+        break;
+      }
+      high -= step;
+    }
+  }
+  while (high-low > 1)
+  {
+    const qint64 middle = low+(high-low)/2;
+    if (offsetMatches(base, key, strict, middle))
+      low = middle;
+    else
+      high = middle;
+  }
+  return low;
+}
+
+/*! \internal
+  
+  Maps \a offset to an integer with the same order, so neighboring floats map to neighboring
+  integers. Both zeros map to zero. \a offset must not be NaN.
+*/
+qint32 QCPPackedGraphData::toOrdered(float offset)
+{
+  qint32 bits;
+  std::memcpy(&bits, &offset, sizeof(bits));
+  return bits < 0 ? -(bits & 0x7fffffff) : bits;
+}
+
+/*! \internal
+  
+  The inverse of \ref toOrdered.
+*/
+float QCPPackedGraphData::fromOrdered(qint64 ordered)
+{
+  const quint32 bits = ordered < 0 ? (quint32(-ordered) | 0x80000000u) : quint32(ordered);
+  float offset;
+  std::memcpy(&offset, &bits, sizeof(offset));
+  return offset;
+}
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraph
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraph
+  \brief A plottable representing a graph in a plot.
+
+  \image html QCPGraph.png
+  
+  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
+  accessed via QCustomPlot::graph.
+
+  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
+  also access and modify the data via the \ref data method, which returns a pointer to the internal
+  \ref QCPGraphDataContainer.
+  
+  Graphs are used to display single-valued data. Single-valued means that there should only be one
+  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
+  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  
+  Gaps in the graph line can be created by adding data points with NaN as value
+  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
+  separated.
+  
+  \section qcpgraph-appearance Changing the appearance
+  
+  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
+  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  
+  \subsection filling Filling under or between graphs
+  
+  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
+  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
+  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  
+  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
+  between this graph and another one, call \ref setChannelFillGraph with the other graph as
+  parameter.
+
+  \see QCustomPlot::addGraph, QCustomPlot::graph
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QSharedPointer<QCPGraphDataContainer> QCPGraph::data() const
+  
+  Returns a shared pointer to the internal data storage of type \ref QCPGraphDataContainer. You may
+  use it to directly manipulate the data, which may be more convenient and faster than using the
+  regular \ref setData or \ref addData methods.
+*/
+
+/* end of documentation of inline functions */
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The created QCPGraph is automatically registered with the QCustomPlot instance inferred from \a
+  keyAxis. This QCustomPlot instance takes ownership of the QCPGraph, so do not delete it manually
+  but use QCustomPlot::removePlottable() instead.
+  
+  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+*/
+QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis)
+{
+  // special handling for QCPGraphs to maintain the simple graph interface:
+  mParentPlot->registerGraph(this);
+
+  setPen(QPen(Qt::blue, 0));
+  setBrush(Qt::NoBrush);
+  
+  setLineStyle(lsLine);
+  setScatterSkip(0);
+  setScatterDeduplication(false);
+  setScatterDeduplicationCellSize(1);
+  setChannelFillGraph(0);
+  setAdaptiveSampling(true);
+  setSamplingStrategy(ssAdaptive);
+  
+  mLineCache.valid = false;
+}
+
+QCPGraph::~QCPGraph()
+{
+  qDeleteAll(mSamplingChunks);
+}
+
+/*! \overload
+  
+  Replaces the current data container with the provided \a data container.
+  
+  Since a QSharedPointer is used, multiple QCPGraphs may share the same data container safely.
+  Modifying the data in the container will then affect all graphs that share the container. Sharing
+  can be achieved by simply exchanging the data containers wrapped in shared pointers:
+  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpgraph-datasharing-1
+  
+  If you do not wish to share containers, but create a copy from an existing container, rather use
+  the \ref QCPDataContainer<DataType>::set method on the graph's data container directly:
+  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpgraph-datasharing-2
+  
+  \see addData
+*/
+void QCPGraph::setData(QSharedPointer<QCPGraphDataContainer> data)
+{
+  mDataContainer = data;
+  mLineCache.valid = false;
+}
+
+/*! \overload
+  
+  Replaces the current data with the provided points in \a keys and \a values. The provided
+  vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+  
+  If you can guarantee that the passed data points are sorted by \a keys in ascending order, you
+  can set \a alreadySorted to true, to improve performance by saving a sorting run.
+  
+  \see addData
+*/
+void QCPGraph::setData(const QVector<double> &keys, const QVector<double> &values, bool alreadySorted)
+{
+  mDataContainer->clear();
+  addData(keys, values, alreadySorted);
+}
+
+/*!
+  Sets how the single data points are connected in the plot. For scatter-only plots, set \a ls to
+  \ref lsNone and \ref setScatterStyle to the desired scatter style.
+  
+  \see setScatterStyle
+*/
+void QCPGraph::setLineStyle(LineStyle ls)
+{
+  mLineStyle = ls;
+}
+
+/*!
+  Sets the visual appearance of single data points in the plot. If set to \ref QCPScatterStyle::ssNone, no scatter points
+  are drawn (e.g. for line-only-plots with appropriate line style).
+  
+  \see QCPScatterStyle, setLineStyle
+*/
+void QCPGraph::setScatterStyle(const QCPScatterStyle &style)
+{
+  mScatterStyle = style;
 }
 
 /*!
@@ -19874,6 +21035,45 @@ void QCPGraph::setScatterSkip(int skip)
   mScatterSkip = qMax(0, skip);
 }
 
+/*!
+  Sets whether scatters that land in the same cell as a previous scatter are left out.
+  
+  If enabled, every visible data point is transformed to pixel coordinates, and a scatter is only
+  drawn if no previous scatter of the graph was drawn in the same cell of a grid over the axis
+  rect. This replaces adaptive sampling for the scatters (see \ref setAdaptiveSampling). With the
+  default cell size of one pixel (see \ref setScatterDeduplicationCellSize), it never changes which
+  pixels contain a scatter: the scatters that are left out would be drawn less than a pixel away
+  from one that is drawn. Scatters whose shape can't reach into the axis rect are left out as well.
+  So the number of drawn scatters is limited by the number of cells in the axis rect, no matter
+  how many data points are visible.
+  
+  Note that with translucent scatters, stacked scatters look more opaque, which is lost where
+  scatters are left out.
+  
+  Deduplication is disabled by default.
+  
+  \see setScatterSkip
+*/
+void QCPGraph::setScatterDeduplication(bool enabled)
+{
+  mScatterDeduplication = enabled;
+}
+
+/*!
+  Sets the size in pixels of the cells that scatter deduplication works with (see \ref
+  setScatterDeduplication). At most one scatter is drawn per cell.
+  
+  The default of one pixel keeps the plot as it is. Larger cells, e.g. the size of the scatter
+  shape (see \ref QCPScatterStyle::setSize), bound the number of drawn scatters by the area of the
+  axis rect divided by the area of a cell, so very dense scatter plots draw faster. The scatters
+  that are left out are then drawn less than a cell away from one that is drawn, which mostly
+  hides them under its shape. Sizes below one pixel are set to one pixel.
+*/
+void QCPGraph::setScatterDeduplicationCellSize(double pixels)
+{
+  mScatterDeduplicationCellSize = qMax(1.0, pixels);
+}
+
 /*!
   Sets the target graph for filling the area between this graph and \a targetGraph with the current
   brush (\ref setBrush).
@@ -19916,7 +21116,9 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
   
   As can be seen, line plots experience no visual degradation from adaptive sampling. Outliers are
   reproduced reliably, as well as the overall shape of the data set. The replot time reduces
-  dramatically though. This allows QCustomPlot to display large amounts of data in realtime.
+  dramatically though. This allows QCustomPlot to display large amounts of data in realtime. For
+  line plots of millions of points, the sampling is spread over the threads of
+  QThreadPool::globalInstance, without changing the result.
   
   \image html adaptive-sampling-scatter.png "A scatter plot of 100,000 points without and with adaptive sampling"
   
@@ -19933,12 +21135,38 @@ void QCPGraph::setChannelFillGraph(QCPGraph *targetGraph)
   sampling off. For example, when saving the plot to disk. This can be achieved by setting \a
   enabled to false before issuing a command like \ref QCustomPlot::savePng, and setting \a enabled
   back to true afterwards.
+  
+  \see setSamplingStrategy
 */
 void QCPGraph::setAdaptiveSampling(bool enabled)
 {
   mAdaptiveSampling = enabled;
 }
 
+/*!
+  Sets how the data points of the graph's line are reduced, if adaptive sampling is enabled and
+  applies (see \ref setAdaptiveSampling). Scatters are always sampled with the default strategy.
+  
+  With \ref ssAdaptive (the default), every pixel interval with several data points is represented
+  by up to four points at fixed fractions of the pixel, carrying the interval's value extremes. This
+  is the fastest strategy, since it can use the container's pyramid index and several threads.
+  
+  With \ref ssM4, every pixel column is represented by its first, last, lowest and highest data
+  point, with their actual keys. Since the line within a pixel column covers the range between the
+  value extremes either way, and the lines between columns connect the same data points, the graph
+  is rasterized like the full data. Like \ref ssAdaptive, it only costs time proportional to the
+  new data points when data is appended.
+  
+  With \ref ssLttb, about one data point per pixel is picked with the largest-triangle-three-buckets
+  algorithm, which keeps the visual shape of the data with far fewer line segments, but drops
+  narrow extremes. This gives smooth lines e.g. for exported images with antialiasing, but is
+  slower and has to sample everything again whenever data is appended.
+*/
+void QCPGraph::setSamplingStrategy(SamplingStrategy strategy)
+{
+  mSamplingStrategy = strategy;
+}
+
 /*! \overload
   
   Adds the provided points in \a keys and \a values to the current data. The provided vectors
@@ -19956,18 +21184,27 @@ void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &value
   if (keys.size() != values.size())
     qDebug() << Q_FUNC_INFO << "keys and values have different sizes:" << keys.size() << values.size();
   const int n = qMin(keys.size(), values.size());
-  QVector<QCPGraphData> tempData(n);
-  QVector<QCPGraphData>::iterator it = tempData.begin();
-  const QVector<QCPGraphData>::iterator itEnd = tempData.end();
-  int i = 0;
-  while (it != itEnd)
-  {
-    it->key = keys[i];
-    it->value = values[i];
-    ++it;
-    ++i;
-  }
-  mDataContainer->add(tempData, alreadySorted); // don't modify tempData beyond this to prevent copy on write
+  addData(keys.constData(), values.constData(), n, alreadySorted);
+}
+
+/*! \overload
+  
+  Adds the \a count data points given by the arrays \a keys and \a values to the current data.
+  
+  The data points are copied directly from the arrays into the data container, without building
+  an intermediate QVector<QCPGraphData>. This is the most efficient way to add batches of data
+  points that are available as separate key and value arrays.
+  
+  If you can guarantee that the passed data points are sorted by \a keys in ascending order, you
+  can set \a alreadySorted to true, to improve performance by saving a sorting run.
+  
+  \see QCPDataContainer::add(InputIterator first, InputIterator last, bool alreadySorted)
+*/
+void QCPGraph::addData(const double *keys, const double *values, int count, bool alreadySorted)
+{
+  if (count <= 0)
+    return;
+  mDataContainer->add(QCPDataColumnIterator<QCPGraphData>(keys, values), QCPDataColumnIterator<QCPGraphData>(keys+count, values+count), alreadySorted);
 }
 
 /*! \overload
@@ -19982,6 +21219,44 @@ void QCPGraph::addData(double key, double value)
   mDataContainer->add(QCPGraphData(key, value));
 }
 
+/*!
+  Returns the value the graph's line has at \a key, e.g. for a cursor readout. Between two data
+  points, the value is interpolated linearly, or taken from the step for the step line styles (see
+  \ref setLineStyle).
+  
+  \a found is set to false if \a key is outside the key range of the data, or the line has a gap
+  there, because a neighbouring data point has a NaN value (see the QCPGraph class description).
+  
+  The lookup uses \ref QCPDataContainer::findBegin, which starts at the previous lookup's result.
+  So querying many graphs at a key that follows the mouse is cheap, even for large data.
+*/
+double QCPGraph::valueAtKey(double key, bool &found) const
+{
+  found = false;
+  QCPGraphDataContainer::const_iterator after = mDataContainer->findBegin(key, false);
+  if (after == mDataContainer->constEnd())
+    return 0;
+  if (after->key == key)
+  {
+    found = !qIsNaN(after->value);
+    return after->value;
+  }
+  if (after == mDataContainer->constBegin())
+    return 0;
+  QCPGraphDataContainer::const_iterator before = after-1;
+  
+  double value;
+  switch (mLineStyle)
+  {
+    case lsStepLeft: value = before->value; break;
+    case lsStepRight: value = after->value; break;
+    case lsStepCenter: value = key-before->key < after->key-key ? before->value : after->value; break;
+    default: value = before->value+(after->value-before->value)*(key-before->key)/(after->key-before->key); break;
+  }
+  found = !qIsNaN(before->value) && !qIsNaN(after->value);
+  return value;
+}
+
 /* inherits documentation from base class */
 double QCPGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
 {
@@ -20023,17 +21298,21 @@ void QCPGraph::draw(QCPPainter *painter)
   if (mKeyAxis.data()->range().size() <= 0 || mDataContainer->isEmpty()) return;
   if (mLineStyle == lsNone && mScatterStyle.isNone()) return;
   
-  QVector<QPointF> lines, scatters; // line and (if necessary) scatter pixel coordinates will be stored here while iterating over segments
+  // line and (if necessary) scatter pixel coordinates will be stored in mLines and mScatters while
+  // iterating over segments. Like the segment lists, they are kept between replots, so a replot
+  // that shows about as many points as the previous one doesn't allocate memory:
+  QVector<QPointF> &lines = mLines;
+  QVector<QPointF> &scatters = mScatters;
   
   // loop over and draw segments of unselected/selected data:
-  QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
-  getDataSegments(selectedSegments, unselectedSegments);
-  allSegments << unselectedSegments << selectedSegments;
-  for (int i=0; i<allSegments.size(); ++i)
+  getDataSegments(mSelectedSegments, mUnselectedSegments);
+  const int unselectedCount = mUnselectedSegments.size();
+  for (int i=0; i<unselectedCount+mSelectedSegments.size(); ++i)
   {
-    bool isSelectedSegment = i >= unselectedSegments.size();
+    bool isSelectedSegment = i >= unselectedCount;
+    const QCPDataRange segment = isSelectedSegment ? mSelectedSegments.at(i-unselectedCount) : mUnselectedSegments.at(i);
     // get line pixel points appropriate to line style:
-    QCPDataRange lineDataRange = isSelectedSegment ? allSegments.at(i) : allSegments.at(i).adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
+    QCPDataRange lineDataRange = isSelectedSegment ? segment : segment.adjusted(-1, 1); // unselected segments extend lines to bordering selected data point (safe to exceed total data bounds in first/last segment, getLines takes care)
     getLines(&lines, lineDataRange);
     
     // check data validity if flag set:
@@ -20074,7 +21353,7 @@ void QCPGraph::draw(QCPPainter *painter)
       finalScatterStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
     if (!finalScatterStyle.isNone())
     {
-      getScatters(&scatters, allSegments.at(i));
+      getScatters(&scatters, segment);
       drawScatterPlot(painter, scatters, finalScatterStyle);
     }
   }
@@ -20120,10 +21399,51 @@ void QCPGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
 }
 
 /*! \internal
+  
+  Returns the point where the line from \a inside to \a outside crosses the value coordinate \a
+  bound, which lies between the value coordinates of the two points. \a valueIsX tells whether the
+  value coordinate is the x coordinate of the points. If \a inside has a NaN value, or is the same
+  point as \a outside, \a outside is just moved onto \a bound.
+  
+  This is used by \ref QCPGraph::clipLinesToValueRange.
+*/
+static inline QPointF qcpPointOnValueBound(const QPointF &inside, const QPointF &outside, double bound, bool valueIsX)
+{
+  const double insideValue = valueIsX ? inside.x() : inside.y();
+  const double outsideValue = valueIsX ? outside.x() : outside.y();
+  const double insideKey = valueIsX ? inside.y() : inside.x();
+  const double outsideKey = valueIsX ? outside.y() : outside.x();
+  double key = outsideKey;
+  if (!qIsNaN(insideValue) && insideValue != outsideValue)
+    key = insideKey+(bound-insideValue)/(outsideValue-insideValue)*(outsideKey-insideKey);
+  return valueIsX ? QPointF(bound, key) : QPointF(key, bound);
+}
 
-  This method retrieves an optimized set of data points via \ref getOptimizedLineData, an branches
-  out to the line style specific functions such as \ref dataToLines, \ref dataToStepLeftLines, etc.
-  according to the line style of the graph.
+/*! \internal
+  
+  Makes sure \a vector has room for \a size elements. Unlike QVector::reserve, which allocates
+  exactly \a size elements, this leaves room for a quarter more. Buffers that are reused for every
+  replot, like the lines of a live graph, would otherwise reallocate whenever their size grows
+  by just a few elements.
+*/
+template <class T>
+static inline void qcpReserve(QVector<T> &vector, int size)
+{
+  if (vector.capacity() < size)
+    vector.reserve(size+size/4);
+}
+
+/*! \internal
+
+  This method retrieves an optimized set of data points via \ref getOptimizedLineData, and
+  transforms them to pixel coordinates according to the line style of the graph with \ref
+  dataToStyledLines. The points are written into \a lines in place, so a vector that is reused
+  across calls doesn't allocate memory once it has grown large enough.
+  
+  The result is kept in a cache (see \ref updateLineCache), so if neither the data nor the axes
+  changed since the last call, the points are just copied to \a lines. If data points were only
+  appended, just the new data points are sampled. While copying, the lines are clipped to the
+  visible value range with \ref clipLinesToValueRange.
 
   \a lines will be filled with points in pixel coordinates, that can be drawn with the according
   draw functions like \ref drawLinePlot and \ref drawImpulsePlot. The points returned in \a lines
@@ -20144,24 +21464,107 @@ void QCPGraph::getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange)
   if (!lines) return;
   QCPGraphDataContainer::const_iterator begin, end;
   getVisibleDataBounds(begin, end, dataRange);
-  if (begin == end)
+  if (begin == end || mLineStyle == lsNone)
   {
     lines->clear();
     return;
   }
   
-  QVector<QCPGraphData> lineData;
-  if (mLineStyle != lsNone)
-    getOptimizedLineData(&lineData, begin, end);
+  updateLineCache(begin, end);
+  clipLinesToValueRange(mLineCache.lines, lines);
+}
 
-  switch (mLineStyle)
+/*! \internal
+  
+  Writes the pixel coordinates in \a lines, as made by \ref dataToStyledLines, to \a clippedLines,
+  with the parts that are beyond the visible value range replaced by as few points as possible.
+  
+  The clip bounds are the edges of the axis rect in value direction, plus a margin that covers the
+  stroke width of the pens and the selection tolerance, so nothing changes inside the axis rect,
+  and clicks at its edge don't hit the replaced parts (see \ref pointDistance). A run of points
+  that are all beyond the same bound is replaced by the points where the line crosses the bound
+  on the way there and back, connected along the bound. At the start or end of the line, the point
+  is moved onto the bound instead. A single point that is beyond a bound by at most the size of the
+  axis rect is kept as it is, which is one point instead of two. For \ref lsImpulse, the impulses
+  are cut off at the bounds. Points with NaN values are kept as they are.
+  
+  Without this, a value axis that is zoomed in deeply makes the painter stroke lines with huge
+  coordinates far outside the axis rect, which is slow and may overflow in the raster engine. This
+  way, the number of points is bounded by the points on screen, and all coordinates are within one
+  axis rect size of the axis rect. The clipping only concerns the value direction, in key direction the
+  lines are already limited by \ref getVisibleDataBounds.
+*/
+void QCPGraph::clipLinesToValueRange(const QVector<QPointF> &lines, QVector<QPointF> *clippedLines) const
+{
+  QCPAxis *valueAxis = mValueAxis.data();
+  const int n = lines.size();
+  qcpReserve(*clippedLines, 2*n+2); // a point far beyond a bound becomes two if the line crosses the axis rect on both sides of it; added 2 to reserve memory for lower/upper fill base points that might be needed for fill
+  if (!valueAxis || n == 0)
   {
-    case lsNone: lines->clear(); break;
-    case lsLine: *lines = dataToLines(lineData); break;
-    case lsStepLeft: *lines = dataToStepLeftLines(lineData); break;
-    case lsStepRight: *lines = dataToStepRightLines(lineData); break;
-    case lsStepCenter: *lines = dataToStepCenterLines(lineData); break;
-    case lsImpulse: *lines = dataToImpulseLines(lineData); break;
+    clippedLines->resize(n);
+    std::copy(lines.constBegin(), lines.constEnd(), clippedLines->begin());
+    return;
+  }
+  
+  double penWidth = mPen.widthF();
+  if (mSelectionDecorator)
+    penWidth = qMax(penWidth, mSelectionDecorator->pen().widthF());
+  const double margin = qMax(qMax(qreal(1.0), qreal(penWidth*0.75)), qreal(mParentPlot->selectionTolerance()*1.2)); // stroke radius + 50% safety, or more than the distance that counts as a click on the line
+  const bool valueIsX = valueAxis->orientation() == Qt::Horizontal;
+  const QRect axisRect = valueAxis->axisRect()->rect();
+  const double lower = (valueIsX ? axisRect.left() : axisRect.top())-margin;
+  const double upper = (valueIsX ? axisRect.right() : axisRect.bottom())+margin;
+  const double keepDistance = valueIsX ? axisRect.width() : axisRect.height(); // single points up to this far beyond a bound are kept
+  const QPointF *source = lines.constData();
+  
+  if (mLineStyle == lsImpulse) // impulses are parallel to the value axis, so their ends can just be moved
+  {
+    clippedLines->resize(n);
+    QPointF *result = clippedLines->data();
+    for (int i=0; i<n; ++i)
+    {
+      double value = valueIsX ? source[i].x() : source[i].y();
+      if (value < lower)
+        value = lower;
+      else if (value > upper)
+        value = upper;
+      result[i] = valueIsX ? QPointF(value, source[i].y()) : QPointF(source[i].x(), value);
+    }
+    return;
+  }
+  
+  clippedLines->resize(0); // keeps the capacity, so appending doesn't allocate once it has grown large enough
+  int i = 0;
+  while (i < n)
+  {
+    const double value = valueIsX ? source[i].x() : source[i].y();
+    if (!(value < lower || value > upper)) // visible, or NaN
+    {
+      clippedLines->append(source[i]);
+      ++i;
+      continue;
+    }
+    // find the run of points beyond the same bound:
+    const bool below = value < lower;
+    const double bound = below ? lower : upper;
+    int runEnd = i+1;
+    while (runEnd < n)
+    {
+      const double runValue = valueIsX ? source[runEnd].x() : source[runEnd].y();
+      if (below ? !(runValue < lower) : !(runValue > upper))
+        break;
+      ++runEnd;
+    }
+    if (runEnd == i+1 && qAbs(value-bound) <= keepDistance) // a single point is exact as it is, while replacing it takes two points
+    {
+      clippedLines->append(source[i]);
+      ++i;
+      continue;
+    }
+    // where the line crosses the bound towards the run and back (or the first/last point moved onto the bound):
+    clippedLines->append(qcpPointOnValueBound(i > 0 ? source[i-1] : source[i], source[i], bound, valueIsX));
+    clippedLines->append(qcpPointOnValueBound(runEnd < n ? source[runEnd] : source[runEnd-1], source[runEnd-1], bound, valueIsX));
+    i = runEnd;
   }
 }
 
@@ -20192,68 +21595,296 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     return;
   }
   
-  QVector<QCPGraphData> data;
+  if (mScatterDeduplication)
+  {
+    getDeduplicatedScatters(scatters, begin, end);
+    return;
+  }
+  
+  QVector<QCPGraphData> &data = mWorkingData;
+  data.resize(0); // keeps the capacity
   getOptimizedScatterData(&data, begin, end);
   scatters->resize(data.size());
-  if (keyAxis->orientation() == Qt::Vertical)
+  QPointF *result = scatters->data();
+  dataToPixels(data.constBegin(), data.constEnd(), result);
+  // data points with NaN values have no scatter:
+  int resultCount = 0;
+  for (int i=0; i<data.size(); ++i)
+  {
+    if (!qIsNaN(data.at(i).value))
+      result[resultCount++] = result[i];
+  }
+  scatters->resize(resultCount);
+  trimWorkingData();
+}
+
+/*! \internal
+  
+  Returns via \a scatters the pixel coordinates of the scatters for the data points from \a begin
+  to \a end, leaving out those that land in the same cell as a previous one, see \ref
+  setScatterDeduplication and \ref setScatterDeduplicationCellSize. This is used by \ref
+  getScatters instead of \ref getOptimizedScatterData.
+  
+  The cells are tracked in an occupancy bitmap that covers the clip rect, extended by how far a
+  scatter shape can reach into it. The bitmap's buffer is kept between replots.
+*/
+void QCPGraph::getDeduplicatedScatters(QVector<QPointF> *scatters, QCPGraphDataContainer::const_iterator begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  // how far a scatter can reach, for unselected and selected data points:
+  double scatterSize = qMax(mScatterStyle.size(), (double)qMax(mScatterStyle.pixmap().width(), mScatterStyle.pixmap().height()));
+  double penWidth = mScatterStyle.isPenDefined() ? mScatterStyle.pen().widthF() : mPen.widthF();
+  if (mSelectionDecorator)
+  {
+    const QCPScatterStyle selectedStyle = mSelectionDecorator->getFinalScatterStyle(mScatterStyle);
+    scatterSize = qMax(scatterSize, qMax(selectedStyle.size(), (double)qMax(selectedStyle.pixmap().width(), selectedStyle.pixmap().height())));
+    penWidth = qMax(penWidth, selectedStyle.isPenDefined() ? selectedStyle.pen().widthF() : mSelectionDecorator->pen().widthF());
+  }
+  const int margin = qCeil(scatterSize*0.5+penWidth)+1;
+  const QRect area = clipRect().adjusted(-margin, -margin, margin, margin);
+  const double cellSize = mScatterDeduplicationCellSize;
+  const int columns = qCeil(area.width()/cellSize);
+  const int rows = qCeil(area.height()/cellSize);
+  const int rowWords = (columns+63)/64;
+  mScatterOccupancy.fill(0, rowWords*rows);
+  quint64 *occupancy = mScatterOccupancy.data();
+  
+  // advance begin iterator to first non-skipped scatter, like getOptimizedScatterData:
+  const int scatterModulo = mScatterSkip+1;
+  int index = begin-mDataContainer->constBegin();
+  while (mScatterSkip > 0 && begin != end && index % scatterModulo != 0)
+  {
+    ++index;
+    ++begin;
+  }
+  
+  scatters->resize(0);
+  const int blockSize = 256;
+  QCPGraphData blockData[blockSize];
+  QPointF blockPixels[blockSize];
+  QCPGraphDataContainer::const_iterator it = begin;
+  while (it != end)
   {
-    for (int i=0; i<data.size(); ++i)
+    int count = 0;
+    while (it != end && count < blockSize)
     {
-      if (!qIsNaN(data.at(i).value))
-      {
-        (*scatters)[i].setX(valueAxis->coordToPixel(data.at(i).value));
-        (*scatters)[i].setY(keyAxis->coordToPixel(data.at(i).key));
-      }
+      blockData[count++] = *it;
+      if (end-it > scatterModulo)
+        it += scatterModulo;
+      else
+        it = end;
     }
-  } else
-  {
-    for (int i=0; i<data.size(); ++i)
+    dataToPixels(blockData, blockData+count, blockPixels);
+    for (int i=0; i<count; ++i)
     {
-      if (!qIsNaN(data.at(i).value))
+      // the comparisons also leave out NaN coordinates, which have no scatter:
+      const double x = blockPixels[i].x()-area.left();
+      const double y = blockPixels[i].y()-area.top();
+      if (!(x >= 0 && x < area.width() && y >= 0 && y < area.height()))
+        continue;
+      const int column = int(x/cellSize);
+      quint64 &word = occupancy[int(y/cellSize)*rowWords+(column >> 6)];
+      const quint64 bit = quint64(1) << (column & 63);
+      if (!(word & bit))
       {
-        (*scatters)[i].setX(keyAxis->coordToPixel(data.at(i).key));
-        (*scatters)[i].setY(valueAxis->coordToPixel(data.at(i).value));
+        word |= bit;
+        scatters->append(blockPixels[i]);
       }
     }
   }
+  trimWorkingData();
 }
 
 /*! \internal
-
-  Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
-  coordinate points which are suitable for drawing the line style \ref lsLine.
   
-  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \a
-  getLines if the line style is set accordingly.
+  \ref getScatters keeps the data points it works on (and \ref dataToStyledLines their pixel
+  coordinates, \ref getLttbLineData the pixel coordinates of all visible data points, \ref
+  getDeduplicatedScatters its occupancy bitmap, \ref getLines its line cache, \ref draw the lines
+  and scatters of the current segment, \ref getChannelFillPolygon the other graph's lines, the
+  envelopes and the polygon) in buffers that persist between replots, so drawing large amounts of
+  data doesn't allocate (and page-fault) a new buffer every time. This releases the buffers' memory
+  if they have become much larger than the data points they were last used for, e.g. after zooming
+  in.
+*/
+void QCPGraph::trimWorkingData() const
+{
+  if (mWorkingData.capacity() > 4*mWorkingData.size()+65536)
+    mWorkingData.squeeze();
+  if (mWorkingPixels.capacity() > 4*mWorkingPixels.size()+65536)
+    mWorkingPixels.squeeze();
+  if (mScatterOccupancy.capacity() > 4*mScatterOccupancy.size()+65536)
+    mScatterOccupancy.squeeze();
+  if (mSamplingPixels.capacity() > 4*mSamplingPixels.size()+65536)
+    mSamplingPixels.squeeze();
+  if (mWorkingIntervals.capacity() > 4*mWorkingIntervals.size()+65536)
+    mWorkingIntervals.squeeze();
+  if (mLines.capacity() > 4*mLines.size()+65536)
+    mLines.squeeze();
+  if (mScatters.capacity() > 4*mScatters.size()+65536)
+    mScatters.squeeze();
+  if (mChannelFillLines.capacity() > 4*mChannelFillLines.size()+65536)
+    mChannelFillLines.squeeze();
+  if (mChannelFillEnvelope.capacity() > 4*mChannelFillEnvelope.size()+65536)
+    mChannelFillEnvelope.squeeze();
+  if (mChannelFillPolygon.capacity() > 4*mChannelFillPolygon.size()+65536)
+    mChannelFillPolygon.squeeze();
+  if (mLineCache.data.capacity() > 4*mLineCache.data.size()+65536)
+    mLineCache.data.squeeze();
+  if (mLineCache.lines.capacity() > 4*mLineCache.lines.size()+65536)
+    mLineCache.lines.squeeze();
+}
 
-  \see dataToStepLeftLines, dataToStepRightLines, dataToStepCenterLines, dataToImpulseLines, getLines, drawLinePlot
+/*! \internal
+  
+  Makes sure the line cache holds the lines for the data points from \a begin to \a end, for the
+  current line style and axes. This is used by \ref getLines.
+  
+  The cache remembers which data points the lines were made from, and the ranges, scale types and
+  pixel geometry of both axes. If all of that is unchanged, the lines are reused as they are. If
+  only data points were appended to the container (see \ref QCPDataContainer::editCount), the
+  cached line data is extended by the new data points with \ref extendLineCache, and the lines are
+  made from it again. That way, a live graph whose axes don't move costs time proportional to the
+  new data points per replot, plus the number of sampled data points on screen, instead of the
+  number of visible data points. Otherwise, the line data is sampled again with \ref
+  getOptimizedLineData.
 */
-QVector<QPointF> QCPGraph::dataToLines(const QVector<QCPGraphData> &data) const
+void QCPGraph::updateLineCache(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
 {
-  QVector<QPointF> result;
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
+  LineCache &cache = mLineCache;
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; cache.valid = false; cache.lines.clear(); return; }
+  
+  const qint64 removedFrontCount = mDataContainer->removedFrontCount();
+  const qint64 cacheBegin = removedFrontCount+(begin-mDataContainer->constBegin());
+  const qint64 cacheEnd = removedFrontCount+(end-mDataContainer->constBegin());
+  const bool sameSource = cache.valid && cache.container == mDataContainer.data() && cache.editCount == mDataContainer->editCount() && cache.begin == cacheBegin &&
+      cache.keyAxis == keyAxis && cache.valueAxis == valueAxis && cache.keyRange == keyAxis->range() && cache.valueRange == valueAxis->range() &&
+      cache.keyAxisRect == keyAxis->axisRect()->rect() && cache.valueAxisRect == valueAxis->axisRect()->rect() &&
+      cache.keyScaleType == keyAxis->scaleType() && cache.valueScaleType == valueAxis->scaleType() &&
+      cache.keyRangeReversed == keyAxis->rangeReversed() && cache.valueRangeReversed == valueAxis->rangeReversed() &&
+      cache.lineStyle == mLineStyle && cache.adaptiveSampling == mAdaptiveSampling && cache.samplingStrategy == mSamplingStrategy;
+  if (sameSource && cache.end == cacheEnd)
+    return;
+  
+  if (!sameSource || cache.end > cacheEnd || !extendLineCache(begin, end, removedFrontCount))
+  {
+    cache.container = mDataContainer.data();
+    cache.editCount = mDataContainer->editCount();
+    cache.begin = cacheBegin;
+    cache.keyAxis = keyAxis;
+    cache.valueAxis = valueAxis;
+    cache.keyRange = keyAxis->range();
+    cache.valueRange = valueAxis->range();
+    cache.keyAxisRect = keyAxis->axisRect()->rect();
+    cache.valueAxisRect = valueAxis->axisRect()->rect();
+    cache.keyScaleType = keyAxis->scaleType();
+    cache.valueScaleType = valueAxis->scaleType();
+    cache.keyRangeReversed = keyAxis->rangeReversed();
+    cache.valueRangeReversed = valueAxis->rangeReversed();
+    cache.lineStyle = mLineStyle;
+    cache.adaptiveSampling = mAdaptiveSampling;
+    cache.samplingStrategy = mSamplingStrategy;
+    cache.sampled = isLineDataSampled(begin, end);
+    cache.resume = -1; // set by getOptimizedLineData, unless it is reimplemented
+    cache.data.resize(0); // keeps the capacity
+    getOptimizedLineData(&cache.data, begin, end);
+  }
+  cache.end = cacheEnd;
+  cache.valid = true;
+  dataToStyledLines(cache.data, mLineStyle, &cache.lines);
+  trimWorkingData();
+}
 
-  result.reserve(data.size()+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
-  result.resize(data.size());
+/*! \internal
+  
+  Extends the line data in the line cache, which was sampled from \a begin up to some earlier end,
+  to \a end. \a removedFrontCount is the container's current \ref
+  QCPDataContainer::removedFrontCount.
+  
+  Sampling is resumed with the last interval of the cached line data, whose output may change due
+  to the new data points, via \ref getOptimizedLineDataChunk (or with the last pixel column via
+  \ref getM4LineData). So the result is identical to sampling all data points again.
   
-  // transform data points to pixels:
-  if (keyAxis->orientation() == Qt::Vertical)
+  Returns false if the line data can't be extended, e.g. because the new data points change whether
+  adaptive sampling is used, or there are so many of them that sampling everything again with \ref
+  getOptimizedLineData is cheaper. The cache is unchanged then.
+*/
+bool QCPGraph::extendLineCache(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, qint64 removedFrontCount) const
+{
+  LineCache &cache = mLineCache;
+  if (cache.resume < 0 || isLineDataSampled(begin, end) != cache.sampled)
+    return false;
+  QCPGraphDataContainer::const_iterator it = mDataContainer->constBegin()+int(cache.resume-removedFrontCount);
+  if (2*(end-it) > end-begin) // getOptimizedLineData can use the pyramid index and threads
+    return false;
+  
+  cache.data.resize(cache.resumeSize);
+  if (!cache.sampled)
   {
-    for (int i=0; i<data.size(); ++i)
+    while (it != end)
     {
-      result[i].setX(valueAxis->coordToPixel(data.at(i).value));
-      result[i].setY(keyAxis->coordToPixel(data.at(i).key));
+      cache.data.append(*it);
+      ++it;
     }
-  } else // key axis is horizontal
+    cache.resume = removedFrontCount+(end-1-mDataContainer->constBegin());
+    cache.resumeSize = cache.data.size()-1;
+  } else if (mSamplingStrategy == ssM4)
   {
-    for (int i=0; i<data.size(); ++i)
-    {
-      result[i].setX(keyAxis->coordToPixel(data.at(i).key));
-      result[i].setY(valueAxis->coordToPixel(data.at(i).value));
-    }
+    QVector<QPair<int, int> > &columns = mWorkingIntervals;
+    columns.resize(0);
+    getM4LineData(&cache.data, &columns, it, end);
+    cache.resume = removedFrontCount+columns.last().first;
+    cache.resumeSize = columns.last().second;
+  } else
+  {
+    // same start key and pixel width as getOptimizedLineData, which takes them from the first visible data point:
+    QCPAxis *keyAxis = mKeyAxis.data();
+    int reversedFactor = keyAxis->pixelOrientation();
+    int reversedRound = reversedFactor==-1 ? 1 : 0;
+    double firstIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(begin->key)+reversedRound));
+    double keyEpsilon = qAbs(firstIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(firstIntervalStartKey)+1.0*reversedFactor));
+    double lastIntervalEndKey = it == begin ? firstIntervalStartKey : (it-1)->key;
+    QVector<QPair<int, int> > &intervals = mWorkingIntervals;
+    intervals.resize(0);
+    getOptimizedLineDataChunk(&cache.data, &intervals, it, end, end, lastIntervalEndKey, keyEpsilon);
+    cache.resume = removedFrontCount+intervals.last().first;
+    cache.resumeSize = intervals.last().second;
   }
+  return true;
+}
+
+/*! \internal
+  
+  Returns whether \ref getOptimizedLineData applies adaptive sampling to the data points from \a
+  begin to \a end, which is the case if it is enabled (\ref setAdaptiveSampling) and there are at
+  least two data points per pixel on average.
+*/
+bool QCPGraph::isLineDataSampled(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  if (!mAdaptiveSampling || begin == end)
+    return false;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  int maxCount = std::numeric_limits<int>::max();
+  double keyPixelSpan = qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key));
+  if (2*keyPixelSpan+2 < (double)std::numeric_limits<int>::max())
+    maxCount = 2*keyPixelSpan+2;
+  return end-begin >= maxCount;
+}
+
+/*! \internal
+
+  Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
+  coordinate points which are suitable for drawing the line style \ref lsLine.
+  
+  This is a shorthand for \ref dataToStyledLines, which \ref getLines uses to write the points into
+  a reused vector.
+
+  \see dataToStepLeftLines, dataToStepRightLines, dataToStepCenterLines, dataToImpulseLines, getLines, drawLinePlot
+*/
+QVector<QPointF> QCPGraph::dataToLines(const QVector<QCPGraphData> &data) const
+{
+  QVector<QPointF> result;
+  dataToStyledLines(data, lsLine, &result);
   return result;
 }
 
@@ -20262,47 +21893,15 @@ QVector<QPointF> QCPGraph::dataToLines(const QVector<QCPGraphData> &data) const
   Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
   coordinate points which are suitable for drawing the line style \ref lsStepLeft.
   
-  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \a
-  getLines if the line style is set accordingly.
+  This is a shorthand for \ref dataToStyledLines, which \ref getLines uses to write the points into
+  a reused vector.
 
   \see dataToLines, dataToStepRightLines, dataToStepCenterLines, dataToImpulseLines, getLines, drawLinePlot
 */
 QVector<QPointF> QCPGraph::dataToStepLeftLines(const QVector<QCPGraphData> &data) const
 {
   QVector<QPointF> result;
-  QCPAxis *keyAxis = mKeyAxis.data();
-  QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
-  
-  result.reserve(data.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
-  result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
-    {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(lastValue);
-      result[i*2+0].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      result[i*2+1].setX(lastValue);
-      result[i*2+1].setY(key);
-    }
-  } else // key axis is horizontal
-  {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i=0; i<data.size(); ++i)
-    {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(key);
-      result[i*2+0].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      result[i*2+1].setX(key);
-      result[i*2+1].setY(lastValue);
-    }
-  }
+  dataToStyledLines(data, lsStepLeft, &result);
   return result;
 }
 
@@ -20311,47 +21910,15 @@ QVector<QPointF> QCPGraph::dataToStepLeftLines(const QVector<QCPGraphData> &data
   Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
   coordinate points which are suitable for drawing the line style \ref lsStepRight.
   
-  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \a
-  getLines if the line style is set accordingly.
+  This is a shorthand for \ref dataToStyledLines, which \ref getLines uses to write the points into
+  a reused vector.
 
   \see dataToLines, dataToStepLeftLines, dataToStepCenterLines, dataToImpulseLines, getLines, drawLinePlot
 */
 QVector<QPointF> QCPGraph::dataToStepRightLines(const QVector<QCPGraphData> &data) const
 {
   QVector<QPointF> result;
-  QCPAxis *keyAxis = mKeyAxis.data();
-  QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
-  
-  result.reserve(data.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
-  result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
-    {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
-      result[i*2+0].setX(value);
-      result[i*2+0].setY(lastKey);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+1].setX(value);
-      result[i*2+1].setY(lastKey);
-    }
-  } else // key axis is horizontal
-  {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i=0; i<data.size(); ++i)
-    {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
-      result[i*2+0].setX(lastKey);
-      result[i*2+0].setY(value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+1].setX(lastKey);
-      result[i*2+1].setY(value);
-    }
-  }
+  dataToStyledLines(data, lsStepRight, &result);
   return result;
 }
 
@@ -20360,59 +21927,15 @@ QVector<QPointF> QCPGraph::dataToStepRightLines(const QVector<QCPGraphData> &dat
   Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
   coordinate points which are suitable for drawing the line style \ref lsStepCenter.
   
-  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \a
-  getLines if the line style is set accordingly.
+  This is a shorthand for \ref dataToStyledLines, which \ref getLines uses to write the points into
+  a reused vector.
 
   \see dataToLines, dataToStepLeftLines, dataToStepRightLines, dataToImpulseLines, getLines, drawLinePlot
 */
 QVector<QPointF> QCPGraph::dataToStepCenterLines(const QVector<QCPGraphData> &data) const
 {
   QVector<QPointF> result;
-  QCPAxis *keyAxis = mKeyAxis.data();
-  QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
-  
-  result.reserve(data.size()*2+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
-  result.resize(data.size()*2);
-  
-  // calculate steps from data and transform to pixel coordinates:
-  if (keyAxis->orientation() == Qt::Vertical)
-  {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    result[0].setX(lastValue);
-    result[0].setY(lastKey);
-    for (int i=1; i<data.size(); ++i)
-    {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
-      result[i*2-1].setX(lastValue);
-      result[i*2-1].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(lastValue);
-      result[i*2+0].setY(key);
-    }
-    result[data.size()*2-1].setX(lastValue);
-    result[data.size()*2-1].setY(lastKey);
-  } else // key axis is horizontal
-  {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    result[0].setX(lastKey);
-    result[0].setY(lastValue);
-    for (int i=1; i<data.size(); ++i)
-    {
-      const double key = (keyAxis->coordToPixel(data.at(i).key)+lastKey)*0.5;
-      result[i*2-1].setX(key);
-      result[i*2-1].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(key);
-      result[i*2+0].setY(lastValue);
-    }
-    result[data.size()*2-1].setX(lastKey);
-    result[data.size()*2-1].setY(lastValue);
-  }
+  dataToStyledLines(data, lsStepCenter, &result);
   return result;
 }
 
@@ -20420,44 +21943,163 @@ QVector<QPointF> QCPGraph::dataToStepCenterLines(const QVector<QCPGraphData> &da
 
   Takes raw data points in plot coordinates as \a data, and returns a vector containing pixel
   coordinate points which are suitable for drawing the line style \ref lsImpulse.
+  Impulses in the same pixel column are merged, see \ref dataToStyledLines.
   
-  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \a
-  getLines if the line style is set accordingly.
+  This is a shorthand for \ref dataToStyledLines, which \ref getLines uses to write the points into
+  a reused vector.
 
   \see dataToLines, dataToStepLeftLines, dataToStepRightLines, dataToStepCenterLines, getLines, drawImpulsePlot
 */
 QVector<QPointF> QCPGraph::dataToImpulseLines(const QVector<QCPGraphData> &data) const
 {
   QVector<QPointF> result;
+  dataToStyledLines(data, lsImpulse, &result);
+  return result;
+}
+
+/*! \internal
+  
+  Returns the point at \a keyPixel and \a valuePixel, with the key axis being vertical if \a
+  keyIsVertical is true.
+*/
+static inline QPointF qcpLinePoint(bool keyIsVertical, double keyPixel, double valuePixel)
+{
+  return keyIsVertical ? QPointF(valuePixel, keyPixel) : QPointF(keyPixel, valuePixel);
+}
+
+/*! \internal
+
+  Takes raw data points in plot coordinates as \a data, and writes pixel coordinate points which
+  are suitable for drawing the line style \a style into \a lines. \a lines is resized, but keeps its
+  capacity, so reusing it saves the allocation. Its capacity is grown by two points more than
+  needed, for the lower/upper fill base points that might be added by \ref addFillBasePoints.
+  
+  The data points are transformed with \ref dataToPixels and then, for step line styles, expanded
+  to steps in a single pass.
+  For \ref lsImpulse, all data points whose key falls into the same pixel column are drawn as one
+  impulse, which reaches from the lowest to the highest of their values and the zero-value-line.
+  A pixel column with a single data point gets the usual impulse from the zero-value-line to the
+  value. If \a style is \ref lsNone, \a lines is emptied.
+  
+  The source of \a data is usually \ref getOptimizedLineData, and this method is called in \ref
+  getLines.
+  
+  \see drawLinePlot, drawImpulsePlot
+*/
+void QCPGraph::dataToStyledLines(const QVector<QCPGraphData> &data, LineStyle style, QVector<QPointF> *lines) const
+{
   QCPAxis *keyAxis = mKeyAxis.data();
   QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return result; }
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; lines->resize(0); return; }
+  if (style == lsNone || data.isEmpty()) { lines->resize(0); return; }
   
-  result.resize(data.size()*2); // no need to reserve 2 extra points because impulse plot has no fill
+  const bool keyIsVertical = keyAxis->orientation() == Qt::Vertical;
+  const int pointsPerData = style == lsLine ? 1 : 2;
+  qcpReserve(*lines, data.size()*pointsPerData+2); // added 2 to reserve memory for lower/upper fill base points that might be needed for fill
+  lines->resize(data.size()*pointsPerData);
+  QPointF *result = lines->data();
   
-  // transform data points to pixels:
-  if (keyAxis->orientation() == Qt::Vertical)
+  // transform all data points at once, keys to the first half of the pixel buffer and values to the second:
+  mWorkingPixels.resize(data.size()*2);
+  double *keyPixels = mWorkingPixels.data();
+  double *valuePixels = keyPixels+data.size();
+  dataToPixels(data.constBegin(), data.constEnd(), keyPixels, valuePixels);
+  
+  switch (style)
   {
-    for (int i=0; i<data.size(); ++i)
+    case lsNone: break;
+    case lsLine:
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(valueAxis->coordToPixel(0));
-      result[i*2+0].setY(key);
-      result[i*2+1].setX(valueAxis->coordToPixel(data.at(i).value));
-      result[i*2+1].setY(key);
+      for (int i=0; i<data.size(); ++i)
+        result[i] = qcpLinePoint(keyIsVertical, keyPixels[i], valuePixels[i]);
+      break;
     }
-  } else // key axis is horizontal
-  {
-    for (int i=0; i<data.size(); ++i)
+    case lsStepLeft:
+    {
+      double lastValue = valuePixels[0];
+      for (int i=0; i<data.size(); ++i)
+      {
+        const double key = keyPixels[i];
+        result[i*2+0] = qcpLinePoint(keyIsVertical, key, lastValue);
+        lastValue = valuePixels[i];
+        result[i*2+1] = qcpLinePoint(keyIsVertical, key, lastValue);
+      }
+      break;
+    }
+    case lsStepRight:
+    {
+      double lastKey = keyPixels[0];
+      for (int i=0; i<data.size(); ++i)
+      {
+        const double value = valuePixels[i];
+        result[i*2+0] = qcpLinePoint(keyIsVertical, lastKey, value);
+        lastKey = keyPixels[i];
+        result[i*2+1] = qcpLinePoint(keyIsVertical, lastKey, value);
+      }
+      break;
+    }
+    case lsStepCenter:
+    {
+      double lastKey = keyPixels[0];
+      double lastValue = valuePixels[0];
+      result[0] = qcpLinePoint(keyIsVertical, lastKey, lastValue);
+      for (int i=1; i<data.size(); ++i)
+      {
+        const double currentKey = keyPixels[i];
+        const double key = (currentKey+lastKey)*0.5;
+        result[i*2-1] = qcpLinePoint(keyIsVertical, key, lastValue);
+        lastValue = valuePixels[i];
+        lastKey = currentKey;
+        result[i*2+0] = qcpLinePoint(keyIsVertical, key, lastValue);
+      }
+      result[data.size()*2-1] = qcpLinePoint(keyIsVertical, lastKey, lastValue);
+      break;
+    }
+    case lsImpulse:
     {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i*2+0].setX(key);
-      result[i*2+0].setY(valueAxis->coordToPixel(0));
-      result[i*2+1].setX(key);
-      result[i*2+1].setY(valueAxis->coordToPixel(data.at(i).value));
+      const double basePixel = valueAxis->coordToPixel(0);
+      int resultCount = 0;
+      int i = 0;
+      double key = keyPixels[0];
+      while (i < data.size())
+      {
+        const double column = std::floor(key);
+        const double columnKey = key;
+        const double value = valuePixels[i];
+        double lower = basePixel;
+        double upper = basePixel;
+        if (value < lower)
+          lower = value;
+        if (value > upper)
+          upper = value;
+        int columnDataCount = 1;
+        // merge the following data points of the same pixel column (NaN values don't expand the impulse):
+        while (++i < data.size())
+        {
+          key = keyPixels[i];
+          if (std::floor(key) != column)
+            break;
+          const double columnValue = valuePixels[i];
+          if (columnValue < lower)
+            lower = columnValue;
+          if (columnValue > upper)
+            upper = columnValue;
+          ++columnDataCount;
+        }
+        if (columnDataCount == 1 || lower == upper)
+        {
+          result[resultCount++] = qcpLinePoint(keyIsVertical, columnKey, basePixel);
+          result[resultCount++] = qcpLinePoint(keyIsVertical, columnKey, value);
+        } else
+        {
+          result[resultCount++] = qcpLinePoint(keyIsVertical, columnKey, lower);
+          result[resultCount++] = qcpLinePoint(keyIsVertical, columnKey, upper);
+        }
+      }
+      lines->resize(resultCount);
+      break;
     }
   }
-  return result;
 }
 
 /*! \internal
@@ -20537,110 +22179,715 @@ void QCPGraph::drawImpulsePlot(QCPPainter *painter, const QVector<QPointF> &line
 {
   if (painter->pen().style() != Qt::NoPen && painter->pen().color().alpha() != 0)
   {
-    applyDefaultAntialiasingHint(painter);
-    QPen oldPen = painter->pen();
-    QPen newPen = painter->pen();
-    newPen.setCapStyle(Qt::FlatCap); // so impulse line doesn't reach beyond zero-line
-    painter->setPen(newPen);
-    painter->drawLines(lines);
-    painter->setPen(oldPen);
+    applyDefaultAntialiasingHint(painter);
+    QPen oldPen = painter->pen();
+    QPen newPen = painter->pen();
+    newPen.setCapStyle(Qt::FlatCap); // so impulse line doesn't reach beyond zero-line
+    painter->setPen(newPen);
+    painter->drawLines(lines);
+    painter->setPen(oldPen);
+  }
+}
+
+#ifdef QCP_PACKED_GRAPH_DATA
+typedef QCPPackedGraphData QCPSampledGraphData;
+typedef float QCPSampledKey;
+#else
+typedef QCPGraphData QCPSampledGraphData;
+typedef double QCPSampledKey;
+#endif
+
+/*! \internal
+  
+  Advances over the first data points of the \a count contiguous ones at \a data whose key is below
+  \a keyBound, i.e. that are in the current pixel interval of the adaptive sampling, and expands
+  \a minValue and \a maxValue by their values. Like the point-wise sampling, NaN values are skipped,
+  and if the interval started with NaN, \a minValue and \a maxValue stay NaN. Returns the number of
+  data points advanced over.
+  
+  This is the portable implementation, see \ref qcpSamplePixelInterval.
+  
+  With \ref QCPPackedGraphData, the data points of a block are processed directly, and \a keyBound
+  is the key offset bound relative to the base of the block (see \ref
+  QCPPackedGraphData::keyOffsetBound).
+*/
+static int qcpSamplePixelIntervalGeneric(const QCPSampledGraphData *data, int count, QCPSampledKey keyBound, double &minValue, double &maxValue)
+{
+  int i = 0;
+  while (i < count && data[i].key < keyBound)
+  {
+    if (data[i].value < minValue)
+      minValue = data[i].value;
+    else if (data[i].value > maxValue)
+      maxValue = data[i].value;
+    ++i;
+  }
+  return i;
+}
+
+#ifdef QCP_AVX2_DISPATCH
+/*! \internal
+  
+  The AVX2 implementation of \ref qcpSamplePixelIntervalGeneric. It loads the interleaved keys and
+  values of several data points at once, stops at the first vector that contains a key at or after
+  \a keyBound, and otherwise folds the values into running minima and maxima, with the key lanes
+  replaced by the running values so they don't take part. With \c QCUSTOMPLOT_COMPACT_GRAPH_DATA
+  alone, the values of eight data points are gathered into one vector instead. Since the keys are
+  sorted, only the last key of the eight is compared with \a keyBound, and the others are only
+  checked for NaN. With \ref QCPPackedGraphData, eight data points of 8 bytes are split into a
+  vector of key offsets and one of values by two shuffles, and all eight key offsets are compared
+  with \a keyBound, which also catches NaN keys.
+  
+  Vector minima and maxima return the running value for NaN and ties, like the point-wise
+  comparisons. Only zeros may be picked with a different sign than point by point, so if a result
+  is zero, the data points are reduced again point by point.
+*/
+__attribute__((target("avx2"))) static int qcpSamplePixelIntervalAvx2(const QCPSampledGraphData *data, int count, QCPSampledKey keyBound, double &minValue, double &maxValue)
+{
+  int i = 0;
+#if defined(QCP_PACKED_GRAPH_DATA)
+  // the shuffles take the keys and the values of four data points from every 128 bit lane, so the
+  // lanes hold the data points in a different order, which doesn't matter for minima and maxima:
+  const __m256 bound = _mm256_set1_ps(keyBound);
+  __m256 minimum = _mm256_set1_ps(minValue);
+  __m256 maximum = _mm256_set1_ps(maxValue);
+  for (; i+8 <= count; i += 8)
+  {
+    const __m256 a = _mm256_loadu_ps(&data[i].key);
+    const __m256 b = _mm256_loadu_ps(&data[i+4].key);
+    if (_mm256_movemask_ps(_mm256_cmp_ps(_mm256_shuffle_ps(a, b, 0x88), bound, _CMP_NLT_UQ)))
+      break;
+    const __m256 values = _mm256_shuffle_ps(a, b, 0xDD);
+    minimum = _mm256_min_ps(values, minimum);
+    maximum = _mm256_max_ps(values, maximum);
+  }
+  float minima[8], maxima[8];
+  _mm256_storeu_ps(minima, minimum);
+  _mm256_storeu_ps(maxima, maximum);
+  const int firstLane = 0, laneStep = 1, laneCount = 8;
+#elif defined(QCUSTOMPLOT_COMPACT_GRAPH_DATA)
+  // eight data points of 12 bytes are three vectors of the low tick halves, high tick halves and
+  // values, interleaved. The values and high halves are gathered by permuting and blending them:
+  const __m256i valueA = _mm256_setr_epi32(2, 5, 0, 0, 0, 0, 0, 0);
+  const __m256i valueB = _mm256_setr_epi32(0, 0, 0, 3, 6, 0, 0, 0);
+  const __m256i valueC = _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 4, 7);
+  const __m256i highA = _mm256_setr_epi32(1, 4, 7, 0, 0, 0, 0, 0);
+  const __m256i highB = _mm256_setr_epi32(0, 0, 0, 2, 5, 0, 0, 0);
+  const __m256i highC = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 3, 6);
+  const __m256i nanHigh = _mm256_set1_epi32(QCPCompactKey::nanHigh);
+  __m256 minimum = _mm256_set1_ps(minValue);
+  __m256 maximum = _mm256_set1_ps(maxValue);
+  for (; i+8 <= count; i += 8)
+  {
+    if (!(data[i+7].key < keyBound)) // keys are sorted, so all are below the bound if the last one is, unless one is NaN
+      break;
+    const float *points = reinterpret_cast<const float*>(data+i);
+    const __m256 a = _mm256_loadu_ps(points);
+    const __m256 b = _mm256_loadu_ps(points+8);
+    const __m256 c = _mm256_loadu_ps(points+16);
+    const __m256 highs = _mm256_blend_ps(_mm256_blend_ps(_mm256_permutevar8x32_ps(a, highA), _mm256_permutevar8x32_ps(b, highB), 0x18), _mm256_permutevar8x32_ps(c, highC), 0xE0);
+    if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_castps_si256(highs), nanHigh)))) // NaN key, ends the interval like in the point-wise loop
+      break;
+    const __m256 values = _mm256_blend_ps(_mm256_blend_ps(_mm256_permutevar8x32_ps(a, valueA), _mm256_permutevar8x32_ps(b, valueB), 0x1C), _mm256_permutevar8x32_ps(c, valueC), 0xE0);
+    minimum = _mm256_min_ps(values, minimum);
+    maximum = _mm256_max_ps(values, maximum);
+  }
+  float minima[8], maxima[8];
+  _mm256_storeu_ps(minima, minimum);
+  _mm256_storeu_ps(maxima, maximum);
+  const int firstLane = 0, laneStep = 1, laneCount = 8;
+#else
+  const __m256d bound = _mm256_set1_pd(keyBound);
+  __m256d minimumA = _mm256_set1_pd(minValue), minimumB = minimumA;
+  __m256d maximumA = _mm256_set1_pd(maxValue), maximumB = maximumA;
+  for (; i+4 <= count; i += 4) // key, value, key, value,... with the keys in the even lanes
+  {
+    const __m256d a = _mm256_loadu_pd(&data[i].key);
+    const __m256d b = _mm256_loadu_pd(&data[i+2].key);
+    if ((_mm256_movemask_pd(_mm256_cmp_pd(a, bound, _CMP_NLT_UQ)) | _mm256_movemask_pd(_mm256_cmp_pd(b, bound, _CMP_NLT_UQ))) & 0x5)
+      break;
+    minimumA = _mm256_min_pd(_mm256_blend_pd(a, minimumA, 0x5), minimumA);
+    minimumB = _mm256_min_pd(_mm256_blend_pd(b, minimumB, 0x5), minimumB);
+    maximumA = _mm256_max_pd(_mm256_blend_pd(a, maximumA, 0x5), maximumA);
+    maximumB = _mm256_max_pd(_mm256_blend_pd(b, maximumB, 0x5), maximumB);
+  }
+  double minima[4], maxima[4];
+  _mm256_storeu_pd(minima, _mm256_min_pd(minimumB, minimumA));
+  _mm256_storeu_pd(maxima, _mm256_max_pd(maximumB, maximumA));
+  const int firstLane = 1, laneStep = 2, laneCount = 4;
+#endif
+  if (i > 0)
+  {
+    double vectorMin = minValue;
+    double vectorMax = maxValue;
+    for (int lane=firstLane; lane<laneCount; lane += laneStep)
+    {
+      if (minima[lane] < vectorMin)
+        vectorMin = minima[lane];
+      if (maxima[lane] > vectorMax)
+        vectorMax = maxima[lane];
+    }
+    if (vectorMin == 0 || vectorMax == 0) // the sign of zero depends on the order of the data points
+      qcpSamplePixelIntervalGeneric(data, i, keyBound, minValue, maxValue);
+    else
+    {
+      minValue = vectorMin;
+      maxValue = vectorMax;
+    }
+  }
+  return i+qcpSamplePixelIntervalGeneric(data+i, count-i, keyBound, minValue, maxValue);
+}
+#endif
+
+typedef int (*QCPSamplePixelIntervalFunction)(const QCPSampledGraphData *data, int count, QCPSampledKey keyBound, double &minValue, double &maxValue);
+
+/*! \internal
+  
+  Returns the fastest implementation of \ref qcpSamplePixelIntervalGeneric the CPU supports.
+*/
+static QCPSamplePixelIntervalFunction qcpSamplePixelIntervalImplementation()
+{
+#ifdef QCP_AVX2_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return qcpSamplePixelIntervalAvx2;
+#endif
+  return qcpSamplePixelIntervalGeneric;
+}
+
+/*! \internal
+  
+  The implementation of \ref qcpSamplePixelIntervalGeneric that is used by \ref
+  QCPGraph::getOptimizedLineDataChunk, chosen once at runtime.
+*/
+static const QCPSamplePixelIntervalFunction qcpSamplePixelInterval = qcpSamplePixelIntervalImplementation();
+
+/*! \internal
+  
+  One chunk of \ref QCPGraph::getOptimizedLineDataParallel. It is started on the thread pool, and
+  either a pool thread or the calling thread samples it, whichever claims it first. Every run on a
+  pool thread releases the done semaphore, whether it sampled the chunk or not.
+  
+  The chunks belong to the graph and are reused by every replot, so once their buffers have grown
+  to the size the data needs, sampling doesn't allocate memory anymore. This requires that no run
+  is pending when the sampling returns, see \ref QCPGraph::getOptimizedLineDataParallel.
+*/
+class QCPGraphSamplingChunk : public QRunnable
+{
+public:
+  explicit QCPGraphSamplingChunk(const QCPGraph *graph) : done(0), graph(graph) { setAutoDelete(false); }
+  
+  bool claim() { return claimed.testAndSetOrdered(0, 1); }
+  void sample()
+  {
+    next = begin;
+    lineData.resize(0);
+    intervals.resize(0);
+    graph->getOptimizedLineDataChunk(&lineData, &intervals, next, chunkEnd, end, lastIntervalEndKey, keyEpsilon);
+  }
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    if (claim())
+      sample();
+    done->release();
+  }
+  
+  QAtomicInt claimed;
+  QSemaphore *done;
+  const QCPGraph *graph;
+  QCPGraphDataContainer::const_iterator begin, chunkEnd, end, next;
+  double lastIntervalEndKey, keyEpsilon;
+  QVector<QCPGraphData> lineData;
+  QVector<QPair<int, int> > intervals;
+};
+
+/*! \internal
+
+  Returns via \a lineData the data points that need to be visualized for this graph when plotting
+  graph lines, taking into consideration the currently visible axis ranges and, if \ref
+  setAdaptiveSampling is enabled, local point densities. The considered data can be restricted
+  further by \a begin and \a end, e.g. to only plot a certain segment of the data (see \ref
+  getDataSegments).
+  
+  This describes the default sampling strategy \ref ssAdaptive. The other strategies are
+  implemented by \ref getM4LineData and \ref getLttbLineData (see \ref setSamplingStrategy).
+
+  If the data container has its pyramid index enabled (\ref QCPDataContainer::setPyramidIndex) and
+  the data is much denser than the pixel grid, adaptive sampling finds the end of each pixel
+  interval by binary search and takes the interval's value extremes from the index, so the cost
+  is proportional to the number of pixels rather than the number of data points. The result is
+  identical to sampling point by point.
+  
+  Otherwise, if there are enough data points, sampling point by point is split into chunks that
+  are processed on QThreadPool::globalInstance (see \ref getOptimizedLineDataParallel).
+  
+  This method is used by \ref getLines to retrieve the basic working set of data. When it samples
+  into the line cache, it also records where sampling can be resumed once data points are
+  appended, see \ref updateLineCache.
+
+  \see getOptimizedScatterData
+*/
+void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  if (!lineData) return;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  if (begin == end) return;
+  
+  int dataCount = end-begin;
+  bool sampled = isLineDataSampled(begin, end);
+  bool usePyramid = false;
+  if (sampled)
+  {
+    double keyPixelSpan = qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key));
+    // with the pyramid index, pixel intervals are summarized in O(log n), which pays off once they contain more than a few base blocks:
+    usePyramid = mDataContainer->pyramidIndex() && dataCount > (keyPixelSpan+1)*(2 << QCPDataPyramid<QCPGraphData>::baseShift);
+  }
+  // the line cache needs the first data point of the last interval and the size of lineData at that point:
+  QPair<int, int> lastInterval(-1, 0);
+  QPair<int, int> *resumeInterval = lineData == &mLineCache.data ? &lastInterval : 0;
+  
+  if (sampled && mSamplingStrategy == ssM4)
+  {
+    QVector<QPair<int, int> > &columns = mWorkingIntervals;
+    columns.resize(0);
+    getM4LineData(lineData, resumeInterval ? &columns : 0, begin, end);
+    if (resumeInterval)
+      *resumeInterval = columns.last();
+  } else if (sampled && mSamplingStrategy == ssLttb) // picks data points depending on all of them, so it can't be resumed
+  {
+    getLttbLineData(lineData, begin, end);
+  } else if (sampled && usePyramid) // adaptive sampling that jumps over whole pixel intervals, with the same result as the point-wise algorithm below
+  {
+    QCPGraphDataContainer::const_iterator it = begin;
+    int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+    int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+    double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(begin->key)+reversedRound));
+    double lastIntervalEndKey = currentIntervalStartKey;
+    double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+    bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+    while (it != end)
+    {
+      if (resumeInterval)
+        *resumeInterval = qMakePair(int(it-mDataContainer->constBegin()), lineData->size());
+      // the interval consists of the first point and all following points with keys below the next pixel boundary:
+      QCPGraphDataContainer::const_iterator intervalEnd = std::lower_bound(it+1, end, currentIntervalStartKey+keyEpsilon, qcpSortKeyLessThan<QCPGraphData>);
+      if (intervalEnd-it >= 2) // pixel has multiple data points, consolidate them to a cluster
+      {
+        double minValue = it->value;
+        double maxValue = it->value;
+        if (!qIsNaN(it->value)) // the point-wise algorithm starts with the first value and never replaces NaN
+        {
+          const QCPDataSummary intervalSummary = mDataContainer->summary(it, intervalEnd);
+          minValue = intervalSummary.minimum;
+          maxValue = intervalSummary.maximum;
+        }
+        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, it->value));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+        if (intervalEnd != end && intervalEnd->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (intervalEnd-1)->value));
+      } else
+        lineData->append(QCPGraphData(it->key, it->value));
+      lastIntervalEndKey = (intervalEnd-1)->key;
+      it = intervalEnd;
+      if (it != end)
+      {
+        currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it->key)+reversedRound));
+        if (keyEpsilonVariable)
+          keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+      }
+    }
+  } else if (sampled) // point-wise adaptive sampling
+  {
+    int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+    int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+    double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(begin->key)+reversedRound));
+    double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
+    int chunkCount = qMin(QThreadPool::globalInstance()->maxThreadCount(), dataCount/parallelSamplingChunkSize);
+    if (chunkCount >= 2)
+      getOptimizedLineDataParallel(lineData, begin, end, chunkCount, keyEpsilon, resumeInterval);
+    else
+    {
+      QCPGraphDataContainer::const_iterator it = begin;
+      QVector<QPair<int, int> > &intervals = mWorkingIntervals;
+      intervals.resize(0);
+      getOptimizedLineDataChunk(lineData, resumeInterval ? &intervals : 0, it, end, end, currentIntervalStartKey, keyEpsilon);
+      if (resumeInterval)
+        *resumeInterval = intervals.last();
+    }
+  } else // don't use adaptive sampling algorithm, transfer points one-to-one from the data container into the output
+  {
+    QCPGraphDataContainer::const_iterator it = begin;
+    qcpReserve(*lineData, dataCount+2); // +2 for possible fill end points
+    while (it != end)
+    {
+      lineData->append(*it);
+      ++it;
+    }
+    if (resumeInterval) // every data point is an interval of its own
+      *resumeInterval = qMakePair(int(end-1-mDataContainer->constBegin()), lineData->size()-1);
+  }
+  
+  if (resumeInterval && lastInterval.first >= 0)
+  {
+    mLineCache.resume = mDataContainer->removedFrontCount()+lastInterval.first;
+    mLineCache.resumeSize = lastInterval.second;
+  }
+}
+
+/*! \internal
+  
+  Samples the data points of one chunk point by point, starting with the interval whose first data
+  point is \a it. Intervals are processed until the next one would start at or after \a chunkEnd,
+  which is then returned via \a it. If the data ends before that, the last interval is handled and
+  \a it is set to \a end.
+  
+  \a lastIntervalEndKey is the key of the data point before \a it (or the start key of the first
+  interval, if \a it is the first visible data point), and \a keyEpsilon the width of a pixel in
+  key coordinates at the first visible data point. Thus, a chunk that starts where the serial
+  algorithm starts an interval gives the same result as the serial algorithm.
+  
+  If \a intervals is non-zero, the index of the first data point of every interval in the data
+  container, and the size of \a lineData at that point, are appended to it.
+  
+  \see getOptimizedLineDataParallel
+*/
+void QCPGraph::getOptimizedLineDataChunk(QVector<QCPGraphData> *lineData, QVector<QPair<int, int> > *intervals, QCPGraphDataContainer::const_iterator &it, const QCPGraphDataContainer::const_iterator &chunkEnd, const QCPGraphDataContainer::const_iterator &end, double lastIntervalEndKey, double keyEpsilon) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  double minValue = it->value;
+  double maxValue = it->value;
+  QCPGraphDataContainer::const_iterator currentIntervalFirstPoint = it;
+  int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
+  int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
+  double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it->key)+reversedRound));
+  bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
+  if (keyEpsilonVariable)
+    keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+  int intervalDataCount = 1;
+  if (intervals)
+    intervals->append(qMakePair(int(it-mDataContainer->constBegin()), lineData->size()));
+  ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
+  while (it != end)
+  {
+    // skip the data points that are still within the same pixel and expand the value span of this cluster if necessary:
+    int contiguousCount = qcpContiguousCount(it, end);
+#ifdef QCP_PACKED_GRAPH_DATA
+    const float keyOffsetBound = QCPPackedGraphData::keyOffsetBound(QCPPackedGraphData::header(it.block())->base, currentIntervalStartKey+keyEpsilon);
+    int pixelCount = qcpSamplePixelInterval(it.block()+it.slot(), contiguousCount, keyOffsetBound, minValue, maxValue);
+#else
+    int pixelCount = qcpSamplePixelInterval(&*it, contiguousCount, currentIntervalStartKey+keyEpsilon, minValue, maxValue);
+#endif
+    it += pixelCount;
+    intervalDataCount += pixelCount;
+    if (pixelCount == contiguousCount) // the pixel may continue in the next contiguous data points
+      continue;
+    // new pixel interval started:
+    if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+    {
+      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+      if (it->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
+        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (it-1)->value));
+    } else
+      lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
+    if (it >= chunkEnd) // the new interval belongs to the next chunk
+      return;
+    lastIntervalEndKey = (it-1)->key;
+    minValue = it->value;
+    maxValue = it->value;
+    currentIntervalFirstPoint = it;
+    currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it->key)+reversedRound));
+    if (keyEpsilonVariable)
+      keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
+    intervalDataCount = 1;
+    if (intervals)
+      intervals->append(qMakePair(int(it-mDataContainer->constBegin()), lineData->size()));
+    ++it;
+  }
+  // handle last interval:
+  if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  {
+    if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
+      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
+    lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+  } else
+    lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
+}
+
+/*! \internal
+  
+  Samples the data points from \a begin to \a end point by point like \ref getOptimizedLineData,
+  but split into \a chunkCount chunks of roughly equal size. The chunks start at the first data
+  point of a pixel, and all but the first are sampled on QThreadPool::globalInstance while the
+  calling thread samples the first. Chunks that no pool thread has started yet are sampled by the
+  calling thread too, so this never waits for pool threads that are busy with other work.
+  
+  Each chunk starts with an interval of its own, whereas the interval of the serial algorithm may
+  start a few data points earlier or later due to rounding, or span several chunks. So when the
+  results are stitched together, the output of a chunk is only used from the interval where the
+  serial algorithm continues on. If the chunk never started an interval there, that part is
+  sampled again. This way, the result is identical to the serial algorithm.
+  
+  The chunks and the other buffers are kept by the graph, so replots don't allocate memory once
+  they have grown. Before returning, the chunks that the calling thread sampled are taken back
+  from the pool queue, and the runs that pool threads have already started are waited for (they
+  return right away if the chunk was claimed). Before Qt 5.9, which can't take tasks back, all
+  runs are waited for.
+  
+  If \a lastInterval is non-zero, the index of the first data point of the last interval, and the
+  size of \a lineData at that point, are returned via it.
+*/
+void QCPGraph::getOptimizedLineDataParallel(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, int chunkCount, double keyEpsilon, QPair<int, int> *lastInterval) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  int reversedRound = keyAxis->pixelOrientation()==-1 ? 1 : 0;
+  double firstIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(begin->key)+reversedRound));
+  int dataCount = end-begin;
+  
+  // split at the first data point of a pixel, which is where the serial algorithm usually starts an interval:
+  QVector<QCPGraphDataContainer::const_iterator> &bounds = mSamplingBounds;
+  bounds.resize(0);
+  bounds.append(begin);
+  for (int i=1; i<chunkCount; ++i)
+  {
+    QCPGraphDataContainer::const_iterator guess = begin+int((qint64)dataCount*i/chunkCount);
+    double pixelStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(guess->key)+reversedRound));
+    QCPGraphDataContainer::const_iterator bound = std::lower_bound(bounds.last()+1, end, pixelStartKey, qcpSortKeyLessThan<QCPGraphData>);
+    if (bound != end)
+      bounds.append(bound);
+  }
+  bounds.append(end);
+  chunkCount = bounds.size()-1;
+  
+  const QVector<QCPGraphSamplingChunk*> &chunks = mSamplingChunks; // the first chunk is sampled by this thread and unused
+  while (mSamplingChunks.size() < chunkCount)
+    mSamplingChunks.append(new QCPGraphSamplingChunk(this));
+  for (int i=1; i<chunkCount; ++i)
+  {
+    QCPGraphSamplingChunk *chunk = chunks.at(i);
+    chunk->claimed.storeRelease(0);
+    chunk->done = &mSamplingDone;
+    chunk->begin = bounds.at(i);
+    chunk->chunkEnd = bounds.at(i+1);
+    chunk->end = end;
+    chunk->lastIntervalEndKey = (bounds.at(i)-1)->key;
+    chunk->keyEpsilon = keyEpsilon;
+    QThreadPool::globalInstance()->start(chunk);
+  }
+  
+  QCPGraphDataContainer::const_iterator next = begin;
+  QVector<QPair<int, int> > &serialIntervals = mSamplingIntervals; // intervals of the parts sampled by this thread, only needed for lastInterval
+  serialIntervals.resize(0);
+  getOptimizedLineDataChunk(lineData, lastInterval ? &serialIntervals : 0, next, bounds.at(1), end, firstIntervalStartKey, keyEpsilon);
+  if (lastInterval)
+    *lastInterval = serialIntervals.last();
+  for (int i=1; i<chunkCount; ++i)
+  {
+    if (chunks.at(i)->claim())
+      chunks.at(i)->sample();
+  }
+  // wait for the runs that have started, which also makes sure none is pending when the chunks are reused:
+  int pending = 0;
+  for (int i=1; i<chunkCount; ++i)
+  {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+    if (!QThreadPool::globalInstance()->tryTake(chunks.at(i)))
+      ++pending;
+#else
+    ++pending;
+#endif
+  }
+  mSamplingDone.acquire(pending);
+  
+  // stitch the chunks together where the serial algorithm continues on:
+  for (int i=1; i<chunkCount && next != end; ++i)
+  {
+    if (next >= bounds.at(i+1)) // an interval of the previous chunk spans this chunk
+      continue;
+    const QCPGraphSamplingChunk *chunk = chunks.at(i);
+    QPair<int, int> nextInterval(next-mDataContainer->constBegin(), 0);
+    QVector<QPair<int, int> >::const_iterator interval = std::lower_bound(chunk->intervals.constBegin(), chunk->intervals.constEnd(), nextInterval);
+    if (interval != chunk->intervals.constEnd() && interval->first == nextInterval.first)
+    {
+      int oldSize = lineData->size();
+      lineData->resize(oldSize+chunk->lineData.size()-interval->second);
+      std::copy(chunk->lineData.constBegin()+interval->second, chunk->lineData.constEnd(), lineData->begin()+oldSize);
+      next = chunk->next;
+      if (lastInterval)
+        *lastInterval = qMakePair(chunk->intervals.last().first, oldSize-interval->second+chunk->intervals.last().second);
+    } else // the chunk is out of step with the serial algorithm
+    {
+      getOptimizedLineDataChunk(lineData, lastInterval ? &serialIntervals : 0, next, bounds.at(i+1), end, (next-1)->key, keyEpsilon);
+      if (lastInterval)
+        *lastInterval = serialIntervals.last();
+    }
   }
 }
 
 /*! \internal
-
-  Returns via \a lineData the data points that need to be visualized for this graph when plotting
-  graph lines, taking into consideration the currently visible axis ranges and, if \ref
-  setAdaptiveSampling is enabled, local point densities. The considered data can be restricted
-  further by \a begin and \a end, e.g. to only plot a certain segment of the data (see \ref
-  getDataSegments).
-
-  This method is used by \ref getLines to retrieve the basic working set of data.
-
-  \see getOptimizedScatterData
+  
+  Appends the data points that represent a pixel column for the sampling strategy \ref
+  QCPGraph::ssM4 to \a lineData: \a first, \a lowest, \a highest and \a last, in key order and
+  without duplicates.
 */
-void QCPGraph::getOptimizedLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+static void qcpAppendM4Column(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &first, const QCPGraphDataContainer::const_iterator &lowest, const QCPGraphDataContainer::const_iterator &highest, const QCPGraphDataContainer::const_iterator &last)
 {
-  if (!lineData) return;
-  QCPAxis *keyAxis = mKeyAxis.data();
-  QCPAxis *valueAxis = mValueAxis.data();
-  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
-  if (begin == end) return;
+  const QCPGraphDataContainer::const_iterator &lower = lowest < highest ? lowest : highest;
+  const QCPGraphDataContainer::const_iterator &upper = lowest < highest ? highest : lowest;
+  lineData->append(*first);
+  if (lower != first)
+    lineData->append(*lower);
+  if (upper != lower)
+    lineData->append(*upper);
+  if (last != upper)
+    lineData->append(*last);
+}
+
+/*! \internal
   
-  int dataCount = end-begin;
-  int maxCount = std::numeric_limits<int>::max();
-  if (mAdaptiveSampling)
-  {
-    double keyPixelSpan = qAbs(keyAxis->coordToPixel(begin->key)-keyAxis->coordToPixel((end-1)->key));
-    if (2*keyPixelSpan+2 < (double)std::numeric_limits<int>::max())
-      maxCount = 2*keyPixelSpan+2;
-  }
+  Samples the data points from \a it to \a end with the sampling strategy \ref ssM4: the data
+  points are grouped into pixel columns by their key pixel, and every column is represented by its
+  first, lowest, highest and last data point, in key order. Data points with NaN values are kept as
+  they are, so gaps in the line stay where they are.
   
-  if (mAdaptiveSampling && dataCount >= maxCount) // use adaptive sampling only if there are at least two points per pixel on average
-  {
-    QCPGraphDataContainer::const_iterator it = begin;
-    double minValue = it->value;
-    double maxValue = it->value;
-    QCPGraphDataContainer::const_iterator currentIntervalFirstPoint = it;
-    int reversedFactor = keyAxis->pixelOrientation(); // is used to calculate keyEpsilon pixel into the correct direction
-    int reversedRound = reversedFactor==-1 ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
-    double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(begin->key)+reversedRound));
-    double lastIntervalEndKey = currentIntervalStartKey;
-    double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
-    bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
-    int intervalDataCount = 1;
-    ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
-    while (it != end)
+  If \a intervals is non-zero, the index of the first data point of every column in the data
+  container, and the size of \a lineData at that point, are appended to it. Since columns only
+  depend on their own data points, sampling can be resumed with any column, see \ref
+  extendLineCache.
+*/
+void QCPGraph::getM4LineData(QVector<QCPGraphData> *lineData, QVector<QPair<int, int> > *intervals, QCPGraphDataContainer::const_iterator it, const QCPGraphDataContainer::const_iterator &end) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  const int blockSize = 256;
+  double keyPixels[blockSize];
+  bool inColumn = false;
+  double column = 0;
+  QCPGraphDataContainer::const_iterator first, lowest, highest, last;
+  while (it != end)
+  {
+    // transform the keys of a block of data points at once, with the same result as when drawing them:
+    const int count = qMin(blockSize, int(end-it));
+    QCPGraphDataContainer::const_iterator blockIt = it;
+    for (int i=0; i<count; ++i, ++blockIt)
+      keyPixels[i] = blockIt->key;
+    keyAxis->coordsToPixels(keyPixels, keyPixels, count);
+    
+    for (int i=0; i<count; ++i, ++it)
     {
-      if (it->key < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
+      const bool isNaN = qIsNaN(it->value);
+      if (inColumn && !isNaN && std::floor(keyPixels[i]) == column)
       {
-        if (it->value < minValue)
-          minValue = it->value;
-        else if (it->value > maxValue)
-          maxValue = it->value;
-        ++intervalDataCount;
-      } else // new pixel interval started
+        if (it->value < lowest->value)
+          lowest = it;
+        if (it->value > highest->value)
+          highest = it;
+        last = it;
+        continue;
+      }
+      if (inColumn) // the column ends
+        qcpAppendM4Column(lineData, first, lowest, highest, last);
+      if (intervals)
+        intervals->append(qMakePair(int(it-mDataContainer->constBegin()), lineData->size()));
+      if (isNaN)
       {
-        if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-        {
-          if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
-            lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
-          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-          lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-          if (it->key > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
-            lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.8, (it-1)->value));
-        } else
-          lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
-        lastIntervalEndKey = (it-1)->key;
-        minValue = it->value;
-        maxValue = it->value;
-        currentIntervalFirstPoint = it;
-        currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it->key)+reversedRound));
-        if (keyEpsilonVariable)
-          keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
-        intervalDataCount = 1;
+        lineData->append(*it);
+        inColumn = false;
+      } else
+      {
+        column = std::floor(keyPixels[i]);
+        first = lowest = highest = last = it;
+        inColumn = true;
       }
-      ++it;
     }
-    // handle last interval:
-    if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
+  }
+  if (inColumn)
+    qcpAppendM4Column(lineData, first, lowest, highest, last);
+}
+
+/*! \internal
+  
+  Samples the data points from \a begin to \a end with the sampling strategy \ref ssLttb. The
+  largest-triangle-three-buckets algorithm splits the data points into buckets, one per pixel of
+  the key span, and picks one data point per bucket: the one that forms the largest triangle with
+  the data point picked for the previous bucket and the average of the next bucket. The first and
+  last data point are always kept.
+  
+  The triangles are measured in pixel coordinates, so the result doesn't depend on the axis scale
+  types. Data points with NaN values split the data into runs that are sampled separately, and are
+  kept to leave gaps in the line.
+*/
+void QCPGraph::getLttbLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const
+{
+  const int dataCount = end-begin;
+  mSamplingPixels.resize(dataCount*2); // not mWorkingPixels, which is much smaller for the lines, so it would be trimmed every time
+  double *keyPixels = mSamplingPixels.data();
+  double *valuePixels = keyPixels+dataCount;
+  dataToPixels(begin, end, keyPixels, valuePixels);
+  
+  int runBegin = 0;
+  while (runBegin < dataCount)
+  {
+    int runEnd = runBegin;
+    while (runEnd < dataCount && !qIsNaN(valuePixels[runEnd]))
+      ++runEnd;
+    const int runCount = runEnd-runBegin;
+    const int bucketCount = runCount > 0 ? int(qAbs(keyPixels[runEnd-1]-keyPixels[runBegin]))+1 : 0;
+    if (runCount <= bucketCount+2) // no more data points than buckets, keep all of them
     {
-      if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
-        lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint->value));
-      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-      lineData->append(QCPGraphData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
+      for (int i=runBegin; i<runEnd; ++i)
+        lineData->append(*(begin+i));
     } else
-      lineData->append(QCPGraphData(currentIntervalFirstPoint->key, currentIntervalFirstPoint->value));
-    
-  } else // don't use adaptive sampling algorithm, transfer points one-to-one from the data container into the output
-  {
-    QCPGraphDataContainer::const_iterator it = begin;
-    lineData->reserve(dataCount+2); // +2 for possible fill end points
-    while (it != end)
     {
-      lineData->append(*it);
-      ++it;
+      // the inner data points are split into buckets of equal count, the last data point is a bucket of its own:
+      const qint64 innerCount = runCount-2;
+      int bucketBegin = runBegin+1;
+      int bucketEnd = runBegin+1+int(innerCount/bucketCount);
+      int picked = runBegin;
+      lineData->append(*(begin+picked));
+      for (int bucket=0; bucket<bucketCount; ++bucket)
+      {
+        const int nextEnd = bucket+1 < bucketCount ? runBegin+1+int(innerCount*(bucket+2)/bucketCount) : runEnd;
+        double nextKey = 0;
+        double nextValue = 0;
+        for (int i=bucketEnd; i<nextEnd; ++i)
+        {
+          nextKey += keyPixels[i];
+          nextValue += valuePixels[i];
+        }
+        nextKey /= nextEnd-bucketEnd;
+        nextValue /= nextEnd-bucketEnd;
+        
+        const double pickedKey = keyPixels[picked];
+        const double pickedValue = valuePixels[picked];
+        double largestArea = -1;
+        int largest = bucketBegin;
+        for (int i=bucketBegin; i<bucketEnd; ++i)
+        {
+          const double area = qAbs((pickedKey-nextKey)*(valuePixels[i]-pickedValue)-(pickedKey-keyPixels[i])*(nextValue-pickedValue));
+          if (area > largestArea)
+          {
+            largestArea = area;
+            largest = i;
+          }
+        }
+        picked = largest;
+        lineData->append(*(begin+picked));
+        bucketBegin = bucketEnd;
+        bucketEnd = nextEnd;
+      }
+      lineData->append(*(begin+(runEnd-1)));
     }
+    if (runEnd < dataCount) // NaN value, keep it for the gap
+      lineData->append(*(begin+runEnd));
+    runBegin = runEnd+1;
   }
 }
 
@@ -20806,7 +23053,7 @@ void QCPGraph::getOptimizedScatterData(QVector<QCPGraphData> *scatterData, QCPGr
   {
     QCPGraphDataContainer::const_iterator it = begin;
     int itIndex = beginIndex;
-    scatterData->reserve(dataCount);
+    qcpReserve(*scatterData, dataCount);
     while (it != end)
     {
       scatterData->append(*it);
@@ -21044,6 +23291,9 @@ QPointF QCPGraph::upperFillBasePoint(double upperKey) const
   they don't have the same orientation (e.g. one key axis vertical, the other horizontal). For
   increased performance (due to implicit sharing), it is recommended to keep the returned QPolygonF
   const.
+  
+  If the lines have more points than the axis rect has pixels in key direction, the polygon is
+  generated from the lines' envelopes per pixel column instead, see \ref getChannelFillEnvelope.
 */
 const QPolygonF QCPGraph::getChannelFillPolygon(const QVector<QPointF> *lines) const
 {
@@ -21059,11 +23309,15 @@ const QPolygonF QCPGraph::getChannelFillPolygon(const QVector<QPointF> *lines) c
     return QPolygonF(); // don't have same axis orientation, can't fill that (Note: if keyAxis fits, valueAxis will fit too, because it's always orthogonal to keyAxis)
   
   if (lines->isEmpty()) return QPolygonF();
-  QVector<QPointF> otherData;
+  QVector<QPointF> &otherData = mChannelFillLines;
   mChannelFillGraph.data()->getLines(&otherData, QCPDataRange(0, mChannelFillGraph.data()->dataCount()));
   if (otherData.isEmpty()) return QPolygonF();
-  QVector<QPointF> thisData;
-  thisData.reserve(lines->size()+otherData.size()); // because we will join both vectors at end of this function
+  const QRect clip = clipRect();
+  if (lines->size()+otherData.size() > 4*(keyAxis->orientation() == Qt::Horizontal ? clip.width() : clip.height()))
+    return getChannelFillEnvelope(lines, &otherData);
+  QVector<QPointF> &thisData = mChannelFillPolygon;
+  thisData.resize(0);
+  qcpReserve(thisData, lines->size()+otherData.size()); // because we will join both vectors at end of this function
   for (int i=0; i<lines->size(); ++i) // don't use the vector<<(vector),  it squeezes internally, which ruins the performance tuning with reserve()
     thisData << lines->at(i);
   
@@ -21177,7 +23431,132 @@ const QPolygonF QCPGraph::getChannelFillPolygon(const QVector<QPointF> *lines) c
   // return joined:
   for (int i=otherData.size()-1; i>=0; --i) // insert reversed, otherwise the polygon will be twisted
     thisData << otherData.at(i);
-  return QPolygonF(thisData);
+  return mChannelFillPolygon;
+}
+
+/*! \internal
+  
+  Widens the per-pixel-column envelope given by \a minimum and \a maximum so it contains the
+  segments of \a lines (in pixel coordinates, the key axis being vertical if \a keyIsVertical is
+  true) between the key pixels \a lower and \a upper. Index 0 of the envelope is the column
+  starting at key pixel \a firstColumn. Segments with NaN coordinates are left out.
+  
+  This is used by \ref QCPGraph::getChannelFillEnvelope.
+*/
+static void qcpAddToColumnEnvelope(const QVector<QPointF> &lines, bool keyIsVertical, double lower, double upper, int firstColumn, double *minimum, double *maximum)
+{
+  for (int i=1; i<lines.size(); ++i)
+  {
+    double key0 = keyIsVertical ? lines.at(i-1).y() : lines.at(i-1).x();
+    double value0 = keyIsVertical ? lines.at(i-1).x() : lines.at(i-1).y();
+    double key1 = keyIsVertical ? lines.at(i).y() : lines.at(i).x();
+    double value1 = keyIsVertical ? lines.at(i).x() : lines.at(i).y();
+    if (key0 > key1)
+    {
+      qSwap(key0, key1);
+      qSwap(value0, value1);
+    }
+    if (!(key1 >= lower && key0 <= upper) || qIsNaN(value0) || qIsNaN(value1))
+      continue;
+    const double segmentLower = qMax(key0, lower);
+    const double segmentUpper = qMin(key1, upper);
+    const double slope = key1 > key0 ? (value1-value0)/(key1-key0) : 0;
+    // the segment is linear within each column, so its extremes there are at the column's borders:
+    for (double columnKey=std::floor(segmentLower); columnKey<=segmentUpper; columnKey+=1)
+    {
+      const int column = int(columnKey)-firstColumn;
+      double from = value0+slope*(qMax(segmentLower, columnKey)-key0);
+      double to = value0+slope*(qMin(segmentUpper, columnKey+1)-key0);
+      if (key1 == key0) // vertical segment, e.g. of a step line
+      {
+        from = value0;
+        to = value1;
+      }
+      minimum[column] = qMin(minimum[column], qMin(from, to));
+      maximum[column] = qMax(maximum[column], qMax(from, to));
+    }
+  }
+}
+
+/*! \internal
+  
+  Generates the channel fill polygon like \ref getChannelFillPolygon, from the lines of this graph
+  in \a lines and of the channel fill graph in \a otherLines, both in pixel coordinates.
+  
+  Since both lines are continuous, the fill in a pixel column spans from the lowest to the highest
+  pixel of either line in that column. So the fill is built from the envelopes of both lines per
+  pixel column, as a polygon that steps from column to column. It has at most four points per
+  pixel column of the clip rect, no matter how many points the lines have, and covers the same
+  pixel columns and rows as the fill between the full lines.
+*/
+const QPolygonF QCPGraph::getChannelFillEnvelope(const QVector<QPointF> *lines, const QVector<QPointF> *otherLines) const
+{
+  const bool keyIsVertical = mKeyAxis.data()->orientation() == Qt::Vertical;
+  const QRect clip = clipRect();
+  
+  // the fill is only drawn where the key ranges of both lines overlap, and within the clip rect:
+  const double thisFirst = keyIsVertical ? lines->first().y() : lines->first().x();
+  const double thisLast = keyIsVertical ? lines->last().y() : lines->last().x();
+  const double otherFirst = keyIsVertical ? otherLines->first().y() : otherLines->first().x();
+  const double otherLast = keyIsVertical ? otherLines->last().y() : otherLines->last().x();
+  double lower = qMax(qMin(thisFirst, thisLast), qMin(otherFirst, otherLast));
+  double upper = qMin(qMax(thisFirst, thisLast), qMax(otherFirst, otherLast));
+  lower = qMax(lower, keyIsVertical ? clip.top()-1.0 : clip.left()-1.0);
+  upper = qMin(upper, keyIsVertical ? clip.bottom()+2.0 : clip.right()+2.0);
+  if (!(lower < upper))
+    return QPolygonF();
+  const int firstColumn = int(std::floor(lower));
+  const int columnCount = int(std::floor(upper))-firstColumn+1;
+  
+  mChannelFillEnvelope.resize(columnCount*4);
+  double *thisMinimum = mChannelFillEnvelope.data();
+  double *thisMaximum = thisMinimum+columnCount;
+  double *otherMinimum = thisMaximum+columnCount;
+  double *otherMaximum = otherMinimum+columnCount;
+  const double infinity = std::numeric_limits<double>::infinity();
+  std::fill(thisMinimum, thisMaximum, infinity);
+  std::fill(thisMaximum, otherMinimum, -infinity);
+  std::fill(otherMinimum, otherMaximum, infinity);
+  std::fill(otherMaximum, otherMaximum+columnCount, -infinity);
+  qcpAddToColumnEnvelope(*lines, keyIsVertical, lower, upper, firstColumn, thisMinimum, thisMaximum);
+  qcpAddToColumnEnvelope(*otherLines, keyIsVertical, lower, upper, firstColumn, otherMinimum, otherMaximum);
+  
+  // the span of the fill per column goes to thisMinimum and thisMaximum. Columns where a line has a
+  // gap get an empty span at the previous span's lower end:
+  double gapValue = qQNaN();
+  for (int column=0; column<columnCount; ++column)
+  {
+    if (thisMinimum[column] <= thisMaximum[column] && otherMinimum[column] <= otherMaximum[column])
+    {
+      thisMinimum[column] = qMin(thisMinimum[column], otherMinimum[column]);
+      thisMaximum[column] = qMax(thisMaximum[column], otherMaximum[column]);
+      if (qIsNaN(gapValue))
+      {
+        for (int gapColumn=0; gapColumn<column; ++gapColumn)
+          thisMinimum[gapColumn] = thisMaximum[gapColumn] = thisMinimum[column];
+      }
+      gapValue = thisMinimum[column];
+    } else
+      thisMinimum[column] = thisMaximum[column] = gapValue;
+  }
+  if (qIsNaN(gapValue))
+    return QPolygonF();
+  
+  // one side of the spans forward and the other backward, each span from its column's start to end:
+  QPolygonF &result = mChannelFillPolygon;
+  result.resize(columnCount*4);
+  QPointF *forward = result.data();
+  QPointF *backward = result.data()+columnCount*4-1;
+  for (int column=0; column<columnCount; ++column)
+  {
+    const double columnStart = qMax(lower, double(firstColumn+column));
+    const double columnEnd = qMin(upper, double(firstColumn+column+1));
+    *forward++ = qcpLinePoint(keyIsVertical, columnStart, thisMinimum[column]);
+    *forward++ = qcpLinePoint(keyIsVertical, columnEnd, thisMinimum[column]);
+    *backward-- = qcpLinePoint(keyIsVertical, columnStart, thisMaximum[column]);
+    *backward-- = qcpLinePoint(keyIsVertical, columnEnd, thisMaximum[column]);
+  }
+  return result;
 }
 
 /*! \internal
@@ -21276,14 +23655,23 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint, QCPGraphDataContainer:
   // iterate over found data points and then choose the one with the shortest distance to pos:
   QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(posKeyMin, true);
   QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(posKeyMax, true);
-  for (QCPGraphDataContainer::const_iterator it=begin; it!=end; ++it)
+  const int blockSize = 256;
+  QPointF pixels[blockSize];
+  for (QCPGraphDataContainer::const_iterator blockBegin=begin; blockBegin!=end; blockBegin+=blockSize)
   {
-    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
-    if (currentDistSqr < minDistSqr)
+    const int count = qMin(blockSize, int(end-blockBegin));
+    dataToPixels(blockBegin, blockBegin+count, pixels);
+    for (int i=0; i<count; ++i)
     {
-      minDistSqr = currentDistSqr;
-      closestData = it;
+      const double currentDistSqr = QCPVector2D(pixels[i]-pixelPoint).lengthSquared();
+      if (currentDistSqr < minDistSqr)
+      {
+        minDistSqr = currentDistSqr;
+        closestData = blockBegin+i;
+      }
     }
+    if (count < blockSize)
+      break;
   }
     
   // calculate distance to graph line if there is one (if so, will probably be smaller than distance to closest data point):
@@ -21497,6 +23885,8 @@ QCPCurve::QCPCurve(QCPAxis *keyAxis, QCPAxis *valueAxis) :
   
   setScatterStyle(QCPScatterStyle());
   setLineStyle(lsLine);
+  setAdaptiveSampling(false);
+  setSamplingTolerance(1);
 }
 
 QCPCurve::~QCPCurve()
@@ -21598,6 +23988,41 @@ void QCPCurve::setLineStyle(QCPCurve::LineStyle style)
   mLineStyle = style;
 }
 
+/*!
+  Sets whether adaptive sampling shall be used when plotting this curve. This can drastically
+  improve the replot performance for curves with many data points per pixel, e.g. phase portraits
+  of millions of data points.
+  
+  If enabled, consecutive points of the curve's line that fall into the same cell of a grid are
+  merged into the first and last of them, which is where the line enters and leaves the cell.
+  Likewise, of consecutive scatters in the same cell, only the first is drawn. The cells are one
+  pixel by default, see \ref setSamplingTolerance. The line thus visits the same cells in the same
+  order as without adaptive sampling, and deviates from it by less than the diagonal of a cell.
+  
+  In contrast to \ref QCPGraph::setAdaptiveSampling, adaptive sampling is disabled by default.
+*/
+void QCPCurve::setAdaptiveSampling(bool enabled)
+{
+  mAdaptiveSampling = enabled;
+}
+
+/*!
+  Sets the size in pixels of the cells that adaptive sampling merges points in (see \ref
+  setAdaptiveSampling), which bounds how far the sampled line may deviate from the full one. The
+  default is one pixel.
+  
+  Larger values merge more points, which makes dense curves faster to draw at the cost of
+  accuracy. Smaller values keep more of the sub-pixel detail, which antialiased lines show.
+  \a pixels must be positive.
+*/
+void QCPCurve::setSamplingTolerance(double pixels)
+{
+  if (pixels > 0)
+    mSamplingTolerance = pixels;
+  else
+    qDebug() << Q_FUNC_INFO << "tolerance must be positive:" << pixels;
+}
+
 /*! \overload
   
   Adds the provided points in \a t, \a keys and \a values to the current data. The provided vectors
@@ -21865,6 +24290,34 @@ void QCPCurve::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> &poin
       style.drawShape(painter,  points.at(i));
 }
 
+/*! \internal
+  
+  Merges consecutive \a points (in pixel coordinates) that fall into the same square cell of \a
+  cellSize pixels, for the adaptive sampling of \ref QCPCurve. Every run of such points is replaced
+  by its first point, and if \a keepLast is true, also by its last point. Points with NaN
+  coordinates are never merged.
+*/
+static void qcpMergePointsInPixel(QVector<QPointF> *points, bool keepLast, double cellSize)
+{
+  QPointF *data = points->data();
+  const int count = points->size();
+  int resultCount = 0;
+  int i = 0;
+  while (i < count)
+  {
+    const double cellX = std::floor(data[i].x()/cellSize);
+    const double cellY = std::floor(data[i].y()/cellSize);
+    int runEnd = i+1;
+    while (runEnd < count && std::floor(data[runEnd].x()/cellSize) == cellX && std::floor(data[runEnd].y()/cellSize) == cellY)
+      ++runEnd;
+    data[resultCount++] = data[i];
+    if (keepLast && runEnd-i >= 2)
+      data[resultCount++] = data[runEnd-1];
+    i = runEnd;
+  }
+  points->resize(resultCount);
+}
+
 /*! \internal
 
   Called by \ref draw to generate points in pixel coordinates which represent the line of the
@@ -21890,6 +24343,9 @@ void QCPCurve::drawScatterPlot(QCPPainter *painter, const QVector<QPointF> &poin
 
   Methods that are also involved in the algorithm are: \ref getRegion, \ref getOptimizedPoint, \ref
   getOptimizedCornerPoints \ref mayTraverse, \ref getTraverse, \ref getTraverseCornerPoints.
+  
+  If adaptive sampling is enabled (\ref setAdaptiveSampling), consecutive points in the same cell
+  (see \ref setSamplingTolerance) are merged afterwards.
 
   \see drawCurveLine, drawScatterPlot
 */
@@ -21916,11 +24372,14 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
   QCPCurveDataContainer::const_iterator prevIt = itEnd-1;
   int prevRegion = getRegion(prevIt->key, prevIt->value, keyMin, valueMax, keyMax, valueMin);
   QVector<QPointF> trailingPoints; // points that must be applied after all other points (are generated only when handling first point to get virtual segment between last and first point right)
+  int coordsBegin = 0; // original points from here on are still in plot coordinates
   while (it != itEnd)
   {
     const int currentRegion = getRegion(it->key, it->value, keyMin, valueMax, keyMax, valueMin);
     if (currentRegion != prevRegion) // changed region, possibly need to add some optimized edge points or original points if entering R
     {
+      // the original points added since the last region change are transformed all at once, before optimized points in pixel coordinates follow them:
+      pointsToPixels(lines, coordsBegin);
       if (currentRegion != 5) // segment doesn't end in R, so it's a candidate for removal
       {
         QPointF crossA, crossB;
@@ -21957,23 +24416,19 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
           trailingPoints << getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin);
         else
           lines->append(getOptimizedPoint(prevRegion, prevIt->key, prevIt->value, it->key, it->value, keyMin, valueMax, keyMax, valueMin));
-        lines->append(coordsToPixels(it->key, it->value));
-      }
-    } else // region didn't change
-    {
-      if (currentRegion == 5) // still in R, keep adding original points
-      {
-        lines->append(coordsToPixels(it->key, it->value));
-      } else // still outside R, no need to add anything
-      {
-        // see how this is not doing anything? That's the main optimization...
       }
+      coordsBegin = lines->size();
     }
+    if (currentRegion == 5) // in R, keep adding original points. Outside R, no need to add anything, that's the main optimization
+      lines->append(QPointF(it->key, it->value));
     prevIt = it;
     prevRegion = currentRegion;
     ++it;
   }
+  pointsToPixels(lines, coordsBegin);
   *lines << trailingPoints;
+  if (mAdaptiveSampling)
+    qcpMergePointsInPixel(lines, true, mSamplingTolerance);
 }
 
 /*! \internal
@@ -21982,7 +24437,9 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRa
   curve. If a scatter skip is configured (\ref setScatterSkip), the returned points are accordingly
   sparser.
 
-  Scatters that aren't visible in the current axis rect are optimized away.
+  Scatters that aren't visible in the current axis rect are optimized away. If adaptive sampling is
+  enabled (\ref setAdaptiveSampling), of consecutive scatters in the same cell (see \ref
+  setSamplingTolerance) only the first one is kept.
 
   \a scatters will be filled with points in pixel coordinates, that can be drawn with \ref
   drawScatterPlot.
@@ -22028,50 +24485,63 @@ void QCPCurve::getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataR
     ++itIndex;
     ++it;
   }
-  if (keyAxis->orientation() == Qt::Vertical)
+  // collect the coordinates of the visible scatters first, so they can be transformed all at once:
+  while (it != end)
   {
-    while (it != end)
+    if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
+      scatters->append(QPointF(it->key, it->value));
+    
+    // advance iterator to next (non-skipped) data point:
+    if (!doScatterSkip)
+      ++it;
+    else
     {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
-        scatters->append(QPointF(valueAxis->coordToPixel(it->value), keyAxis->coordToPixel(it->key)));
-      
-      // advance iterator to next (non-skipped) data point:
-      if (!doScatterSkip)
-        ++it;
+      itIndex += scatterModulo;
+      if (itIndex < endIndex) // make sure we didn't jump over end
+        it += scatterModulo;
       else
       {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex) // make sure we didn't jump over end
-          it += scatterModulo;
-        else
-        {
-          it = end;
-          itIndex = endIndex;
-        }
+        it = end;
+        itIndex = endIndex;
       }
     }
-  } else
+  }
+  
+  pointsToPixels(scatters, 0);
+  if (mAdaptiveSampling)
+    qcpMergePointsInPixel(scatters, false, mSamplingTolerance);
+}
+
+/*! \internal
+
+  Transforms the points of \a points from index \a begin on, which hold key and value
+  coordinates, to pixel coordinates in place. The points are transformed in blocks with \ref
+  QCPAxis::coordsToPixels, which is much faster than transforming them one by one.
+
+  \see getCurveLines, getScatters
+*/
+void QCPCurve::pointsToPixels(QVector<QPointF> *points, int begin) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  
+  const bool keyIsVertical = keyAxis->orientation() == Qt::Vertical;
+  const int blockSize = 256;
+  double keyPixels[blockSize], valuePixels[blockSize];
+  QPointF *result = points->data();
+  for (int blockBegin=begin; blockBegin<points->size(); blockBegin+=blockSize)
   {
-    while (it != end)
+    const int count = qMin(blockSize, points->size()-blockBegin);
+    for (int i=0; i<count; ++i)
     {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) && valueRange.contains(it->value))
-        scatters->append(QPointF(keyAxis->coordToPixel(it->key), valueAxis->coordToPixel(it->value)));
-      
-      // advance iterator to next (non-skipped) data point:
-      if (!doScatterSkip)
-        ++it;
-      else
-      {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex) // make sure we didn't jump over end
-          it += scatterModulo;
-        else
-        {
-          it = end;
-          itIndex = endIndex;
-        }
-      }
+      keyPixels[i] = result[blockBegin+i].x();
+      valuePixels[i] = result[blockBegin+i].y();
     }
+    keyAxis->coordsToPixels(keyPixels, keyPixels, count);
+    valueAxis->coordsToPixels(valuePixels, valuePixels, count);
+    for (int i=0; i<count; ++i)
+      result[blockBegin+i] = keyIsVertical ? QPointF(valuePixels[i], keyPixels[i]) : QPointF(keyPixels[i], valuePixels[i]);
   }
 }
 
@@ -22717,14 +25187,23 @@ double QCPCurve::pointDistance(const QPointF &pixelPoint, QCPCurveDataContainer:
   // iterate over found data points and then choose the one with the shortest distance to pos:
   QCPCurveDataContainer::const_iterator begin = mDataContainer->constBegin();
   QCPCurveDataContainer::const_iterator end = mDataContainer->constEnd();
-  for (QCPCurveDataContainer::const_iterator it=begin; it!=end; ++it)
+  const int blockSize = 256;
+  QPointF pixels[blockSize];
+  for (QCPCurveDataContainer::const_iterator blockBegin=begin; blockBegin!=end; blockBegin+=blockSize)
   {
-    const double currentDistSqr = QCPVector2D(coordsToPixels(it->key, it->value)-pixelPoint).lengthSquared();
-    if (currentDistSqr < minDistSqr)
+    const int count = qMin(blockSize, int(end-blockBegin));
+    dataToPixels(blockBegin, blockBegin+count, pixels);
+    for (int i=0; i<count; ++i)
     {
-      minDistSqr = currentDistSqr;
-      closestData = it;
+      const double currentDistSqr = QCPVector2D(pixels[i]-pixelPoint).lengthSquared();
+      if (currentDistSqr < minDistSqr)
+      {
+        minDistSqr = currentDistSqr;
+        closestData = blockBegin+i;
+      }
     }
+    if (count < blockSize)
+      break;
   }
   
   // calculate distance to line if there is one (if so, will probably be smaller than distance to closest data point):
@@ -23483,10 +25962,12 @@ QCPDataSelection QCPBars::selectTestRect(const QRectF &rect, bool onlySelectable
   
   QCPBarsDataContainer::const_iterator visibleBegin, visibleEnd;
   getVisibleDataBounds(visibleBegin, visibleEnd);
+  QVector<QRectF> barRects;
+  getBarRects(visibleBegin, visibleEnd, barRects);
   
   for (QCPBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
   {
-    if (rect.intersects(getBarRect(it->key, it->value)))
+    if (rect.intersects(barRects.at(it-visibleBegin)))
       result.addDataRange(QCPDataRange(it-mDataContainer->constBegin(), it-mDataContainer->constBegin()+1), false);
   }
   result.simplify();
@@ -23507,9 +25988,11 @@ double QCPBars::selectTest(const QPointF &pos, bool onlySelectable, QVariant *de
     // get visible data range:
     QCPBarsDataContainer::const_iterator visibleBegin, visibleEnd;
     getVisibleDataBounds(visibleBegin, visibleEnd);
+    QVector<QRectF> barRects;
+    getBarRects(visibleBegin, visibleEnd, barRects);
     for (QCPBarsDataContainer::const_iterator it=visibleBegin; it!=visibleEnd; ++it)
     {
-      if (getBarRect(it->key, it->value).contains(pos))
+      if (barRects.at(it-visibleBegin).contains(pos))
       {
         if (details)
         {
@@ -23638,6 +26121,7 @@ void QCPBars::draw(QCPPainter *painter)
   QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
   getDataSegments(selectedSegments, unselectedSegments);
   allSegments << unselectedSegments << selectedSegments;
+  QVector<QRectF> &barRects = mBarRects; // kept between replots, so it doesn't need to be allocated again
   for (int i=0; i<allSegments.size(); ++i)
   {
     bool isSelectedSegment = i >= unselectedSegments.size();
@@ -23647,6 +26131,7 @@ void QCPBars::draw(QCPPainter *painter)
     if (begin == end)
       continue;
     
+    getBarRects(begin, end, barRects);
     for (QCPBarsDataContainer::const_iterator it=begin; it!=end; ++it)
     {
       // check data validity if flag set:
@@ -23665,7 +26150,7 @@ void QCPBars::draw(QCPPainter *painter)
         painter->setPen(mPen);
       }
       applyDefaultAntialiasingHint(painter);
-      painter->drawPolygon(getBarRect(it->key, it->value));
+      painter->drawPolygon(barRects.at(it-begin));
     }
   }
   
@@ -23774,12 +26259,85 @@ QRectF QCPBars::getBarRect(double key, double value) const
   double keyPixel = keyAxis->coordToPixel(key);
   if (mBarsGroup)
     keyPixel += mBarsGroup->keyPixelOffset(this, key);
+  return barRectFromPixels(keyPixel, lowerPixelWidth, upperPixelWidth, basePixel, valuePixel, value);
+}
+
+/*! \internal
+  
+  Returns the rects in pixel coordinates of the bars from \a begin to \a end in \a rects, the same
+  ones \ref getBarRect returns for every single bar.
+  
+  The keys, the stacked base values and the bar tops (and with \ref wtPlotCoords, also the keys of
+  the bar edges) are each transformed for all bars at once with \ref QCPAxis::coordsToPixels,
+  instead of with several calls of \ref QCPAxis::coordToPixel per bar.
+*/
+void QCPBars::getBarRects(const QCPBarsDataContainer::const_iterator &begin, const QCPBarsDataContainer::const_iterator &end, QVector<QRectF> &rects) const
+{
+  rects.resize(0);
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  
+  const int count = int(end-begin);
+  const bool plotCoordsWidth = mWidthType == wtPlotCoords;
+  // the coordinates are transformed in place, arrays that go through the same axis are adjacent:
+  mWorkingPixels.resize(count*(plotCoordsWidth ? 5 : 3));
+  double *keyPixels = mWorkingPixels.data();
+  double *lowerEdgePixels = keyPixels+count; // only used with plotCoordsWidth
+  double *upperEdgePixels = lowerEdgePixels+count; // only used with plotCoordsWidth
+  double *basePixels = keyPixels+count*(plotCoordsWidth ? 3 : 1);
+  double *valuePixels = basePixels+count;
+  int i = 0;
+  for (QCPBarsDataContainer::const_iterator it=begin; it!=end; ++it, ++i)
+  {
+    const double base = getStackedBaseValue(it->key, it->value >= 0);
+    keyPixels[i] = it->key;
+    basePixels[i] = base;
+    valuePixels[i] = base+it->value;
+    if (plotCoordsWidth)
+    {
+      lowerEdgePixels[i] = it->key-mWidth*0.5;
+      upperEdgePixels[i] = it->key+mWidth*0.5;
+    }
+  }
+  keyAxis->coordsToPixels(keyPixels, keyPixels, count*(plotCoordsWidth ? 3 : 1));
+  valueAxis->coordsToPixels(basePixels, basePixels, count*2);
+  
+  double lowerPixelWidth = 0, upperPixelWidth = 0;
+  if (!plotCoordsWidth)
+    getPixelWidth(0, lowerPixelWidth, upperPixelWidth); // the same for all keys
+  rects.resize(count);
+  i = 0;
+  for (QCPBarsDataContainer::const_iterator it=begin; it!=end; ++it, ++i)
+  {
+    double keyPixel = keyPixels[i];
+    if (plotCoordsWidth)
+    {
+      lowerPixelWidth = lowerEdgePixels[i]-keyPixel;
+      upperPixelWidth = upperEdgePixels[i]-keyPixel;
+    }
+    if (mBarsGroup)
+      keyPixel += mBarsGroup->keyPixelOffset(this, it->key);
+    rects[i] = barRectFromPixels(keyPixel, lowerPixelWidth, upperPixelWidth, basePixels[i], valuePixels[i], it->value);
+  }
+}
+
+/*! \internal
+  
+  Returns the rect of a bar with the pixel coordinates \a keyPixel, \a basePixel and \a valuePixel,
+  which extends \a lowerPixelWidth and \a upperPixelWidth from \a keyPixel (see \ref
+  getPixelWidth). The bottom is shifted so the border lines don't overlap with the bars stacked
+  below, the direction depends on the sign of \a value. Used by \ref getBarRect and \ref
+  getBarRects.
+*/
+QRectF QCPBars::barRectFromPixels(double keyPixel, double lowerPixelWidth, double upperPixelWidth, double basePixel, double valuePixel, double value) const
+{
   double bottomOffset = (mBarBelow && mPen != Qt::NoPen ? 1 : 0)*(mPen.isCosmetic() ? 1 : mPen.widthF());
   bottomOffset += mBarBelow ? mStackingGap : 0;
-  bottomOffset *= (value<0 ? -1 : 1)*valueAxis->pixelOrientation();
+  bottomOffset *= (value<0 ? -1 : 1)*mValueAxis.data()->pixelOrientation();
   if (qAbs(valuePixel-basePixel) <= qAbs(bottomOffset))
     bottomOffset = valuePixel-basePixel;
-  if (keyAxis->orientation() == Qt::Horizontal)
+  if (mKeyAxis.data()->orientation() == Qt::Horizontal)
   {
     return QRectF(QPointF(keyPixel+lowerPixelWidth, valuePixel), QPointF(keyPixel+upperPixelWidth, basePixel+bottomOffset)).normalized();
   } else
@@ -25690,6 +28248,12 @@ void QCPColorMap::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
   painter->drawRect(rect.adjusted(1, 1, 0, 0));
   */
 }
+
+/* inherits documentation from base class */
+const void *QCPColorMap::dataObject() const
+{
+  return mMapData;
+}
 /* end of 'src/plottables/plottable-colormap.cpp' */
 
 
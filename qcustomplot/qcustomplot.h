@@ -44,9 +44,18 @@
   #define QCP_DEVICEPIXELRATIO_SUPPORTED
 #endif
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define QCP_AVX2_DISPATCH
+#endif
+
+#if defined(QCUSTOMPLOT_COMPACT_GRAPH_DATA) && defined(QCUSTOMPLOT_USE_BLOCK_STORAGE)
+#  define QCP_PACKED_GRAPH_DATA
+#endif
+
 #include <QtCore/QObject>
 #include <QtCore/QPointer>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QSharedDataPointer>
 #include <QtCore/QTimer>
 #include <QtGui/QPainter>
 #include <QtGui/QPaintEvent>
@@ -62,9 +71,17 @@
 #include <QtCore/QStack>
 #include <QtCore/QCache>
 #include <QtCore/QMargins>
+#include <QtCore/QMutex>
+#include <QtCore/QHash>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
 #include <qmath.h>
 #include <limits>
 #include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <new>
 #ifdef QCP_OPENGL_FBO
 #  include <QtGui/QOpenGLContext>
 #  include <QtGui/QOpenGLFramebufferObject>
@@ -98,6 +115,7 @@ class QCPAxisRect;
 class QCPAxisPainterPrivate;
 class QCPAbstractPlottable;
 class QCPGraph;
+class QCPGraphSamplingChunk;
 class QCPAbstractItem;
 class QCPPlottableInterface1D;
 class QCPLegend;
@@ -235,6 +253,8 @@ enum PlottingHint { phNone              = 0x000 ///< <tt>0x000</tt> No hints are
                     ,phImmediateRefresh = 0x002 ///< <tt>0x002</tt> causes an immediate repaint() instead of a soft update() when QCustomPlot::replot() is called with parameter \ref QCustomPlot::rpRefreshHint.
                                                 ///<                This is set by default to prevent the plot from freezing on fast consecutive replots (e.g. user drags ranges with mouse).
                     ,phCacheLabels      = 0x004 ///< <tt>0x004</tt> axis (tick) labels will be cached as pixmaps, increasing replot performance.
+                    ,phParallelLayers   = 0x008 ///< <tt>0x008</tt> layers in mode \ref QCPLayer::lmBuffered are drawn concurrently on QThreadPool::globalInstance, into QImage based paint buffers
+                                                ///<                (see \ref QCPPaintBufferImage). Has no effect if OpenGL is enabled (\ref QCustomPlot::setOpenGl). See \ref QCustomPlot::replot for restrictions.
                   };
 Q_DECLARE_FLAGS(PlottingHints, PlottingHint)
 
@@ -564,6 +584,26 @@ protected:
 };
 
 
+class QCP_LIB_DECL QCPPaintBufferImage : public QCPAbstractPaintBuffer
+{
+public:
+  explicit QCPPaintBufferImage(const QSize &size, double devicePixelRatio);
+  virtual ~QCPPaintBufferImage();
+  
+  // reimplemented virtual methods:
+  virtual QCPPainter *startPainting() Q_DECL_OVERRIDE;
+  virtual void draw(QCPPainter *painter) const Q_DECL_OVERRIDE;
+  void clear(const QColor &color) Q_DECL_OVERRIDE;
+  
+protected:
+  // non-property members:
+  QImage mBuffer;
+  
+  // reimplemented virtual methods:
+  virtual void reallocateBuffer() Q_DECL_OVERRIDE;
+};
+
+
 #ifdef QCP_OPENGL_PBUFFER
 class QCP_LIB_DECL QCPPaintBufferGlPbuffer : public QCPAbstractPaintBuffer
 {
@@ -2084,6 +2124,7 @@ public:
   void rescale(bool onlyVisiblePlottables=false);
   double pixelToCoord(double value) const;
   double coordToPixel(double value) const;
+  void coordsToPixels(const double *coords, double *pixels, int count) const;
   SelectablePart getPartAt(const QPointF &pos) const;
   QList<QCPAbstractPlottable*> plottables() const;
   QList<QCPGraph*> graphs() const;
@@ -2370,168 +2411,1783 @@ Q_DECLARE_METATYPE(QCPScatterStyle::ScatterShape)
 template <class DataType>
 inline bool qcpLessThanSortKey(const DataType &a, const DataType &b) { return a.sortKey() < b.sortKey(); }
 
+/*! \relates QCPDataContainer
+  Returns whether the sort key of \a a is less than \a sortKey.
+  
+  Unlike comparing with a data point created by \a DataType::fromSortKey, this doesn't round \a
+  sortKey to the precision of the data type's members.
+*/
 template <class DataType>
-class QCP_LIB_DECL QCPDataContainer
+inline bool qcpSortKeyLessThan(const DataType &a, double sortKey) { return a.sortKey() < sortKey; }
+
+/*! \relates QCPDataContainer
+  Returns whether \a sortKey is less than the sort key of \a a. This is the counterpart of \ref
+  qcpSortKeyLessThan for std::upper_bound.
+*/
+template <class DataType>
+inline bool qcpSortKeyBefore(double sortKey, const DataType &a) { return sortKey < a.sortKey(); }
+
+/*! \internal \relates QCPDataContainer
+  Returns whether \a data is at or after the position that std::lower_bound finds for \a sortKey in
+  sorted data, or std::upper_bound if \a upperBound is true.
+*/
+template <class DataType>
+inline bool qcpAtOrAfterBound(const DataType &data, double sortKey, bool upperBound) { return upperBound ? qcpSortKeyBefore(sortKey, data) : !qcpSortKeyLessThan(data, sortKey); }
+
+class QCP_LIB_DECL QCPDataSummary
 {
 public:
-  typedef typename QVector<DataType>::const_iterator const_iterator;
-  typedef typename QVector<DataType>::iterator iterator;
+  QCPDataSummary();
+  template <class DataType>
+  explicit QCPDataSummary(const DataType &data);
   
-  QCPDataContainer();
+  template <class DataType>
+  void expand(const DataType &data);
+  void expand(const QCPDataSummary &other);
   
-  // getters:
-  int size() const { return mData.size()-mPreallocSize; }
-  bool isEmpty() const { return size() == 0; }
-  bool autoSqueeze() const { return mAutoSqueeze; }
+  double minimum, maximum, first, last;
+};
+Q_DECLARE_TYPEINFO(QCPDataSummary, Q_PRIMITIVE_TYPE);
+
+template <class DataType>
+class QCP_LIB_DECL QCPDataPyramid
+{
+public:
+  QCPDataPyramid();
   
-  // setters:
-  void setAutoSqueeze(bool enabled);
+  // getters:
+  int indexedSize() const { return mIndexedSize; }
+  int levelCount() const { return mLevels.size(); }
+  qint64 memoryUsage() const;
   
   // non-virtual methods:
-  void set(const QCPDataContainer<DataType> &data);
-  void set(const QVector<DataType> &data, bool alreadySorted=false);
-  void add(const QCPDataContainer<DataType> &data);
-  void add(const QVector<DataType> &data, bool alreadySorted=false);
-  void add(const DataType &data);
-  void removeBefore(double sortKey);
-  void removeAfter(double sortKey);
-  void remove(double sortKeyFrom, double sortKeyTo);
-  void remove(double sortKey);
+  void invalidate() { mIndexedSize = 0; }
+  void invalidateFrom(int position);
   void clear();
-  void sort();
-  void squeeze(bool preAllocation=true, bool postAllocation=true);
+  void removeFront(int n);
+  template <class Iterator>
+  void update(const Iterator &begin, int size);
+  template <class Iterator>
+  QCPDataSummary summary(const Iterator &begin, int from, int to) const;
   
-  const_iterator constBegin() const { return mData.constBegin()+mPreallocSize; }
-  const_iterator constEnd() const { return mData.constEnd(); }
-  iterator begin() { return mData.begin()+mPreallocSize; }
-  iterator end() { return mData.end(); }
-  const_iterator findBegin(double sortKey, bool expandedRange=true) const;
-  const_iterator findEnd(double sortKey, bool expandedRange=true) const;
-  const_iterator at(int index) const { return constBegin()+qBound(0, index, size()); }
-  QCPRange keyRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth);
-  QCPRange valueRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange());
-  QCPDataRange dataRange() const { return QCPDataRange(0, size()); }
-  void limitIteratorsToDataRange(const_iterator &begin, const_iterator &end, const QCPDataRange &dataRange) const;
+  static const int baseShift = 5;
   
 protected:
-  // property members:
-  bool mAutoSqueeze;
-  
-  // non-property memebers:
-  QVector<DataType> mData;
-  int mPreallocSize;
-  int mPreallocIteration;
+  // non-property members:
+  QVector<QVector<QCPDataSummary> > mLevels;
+  int mIndexedSize;
+  int mOrigin;
   
   // non-virtual methods:
-  void preallocateGrow(int minimumPreallocSize);
-  void performAutoSqueeze();
+  void propagate(int level, int firstDirty);
 };
 
-// include implementation in header since it is a class template:
-
-/* including file 'src/datacontainer.cpp', size 31224                        */
-/* commit 633339dadc92cb10c58ef3556b55570685fafb99 2016-09-13 23:54:56 +0200 */
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPDataContainer
-////////////////////////////////////////////////////////////////////////////////////////////////////
+template <class DataType, class Reference, class Pointer, int BlockShift>
+class QCPDataBlockIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef DataType value_type;
+  typedef int difference_type;
+  typedef Pointer pointer;
+  typedef Reference reference;
+  
+  QCPDataBlockIterator() : mBlocks(0), mIndex(0) {}
+  QCPDataBlockIterator(Pointer const *blocks, int index) : mBlocks(blocks), mIndex(index) {}
+  QCPDataBlockIterator(const QCPDataBlockIterator<DataType, DataType&, DataType*, BlockShift> &other) : mBlocks(other.blocks()), mIndex(other.index()) {}
+  
+  // getters:
+  Pointer const *blocks() const { return mBlocks; }
+  int index() const { return mIndex; }
+  
+  // non-virtual methods:
+  Reference operator*() const { return mBlocks[mIndex >> BlockShift][mIndex & ((1 << BlockShift)-1)]; }
+  Pointer operator->() const { return &operator*(); }
+  Reference operator[](int n) const { return *(*this+n); }
+  QCPDataBlockIterator &operator++() { ++mIndex; return *this; }
+  QCPDataBlockIterator &operator--() { --mIndex; return *this; }
+  QCPDataBlockIterator operator++(int) { QCPDataBlockIterator result(*this); ++mIndex; return result; }
+  QCPDataBlockIterator operator--(int) { QCPDataBlockIterator result(*this); --mIndex; return result; }
+  QCPDataBlockIterator &operator+=(int n) { mIndex += n; return *this; }
+  QCPDataBlockIterator &operator-=(int n) { mIndex -= n; return *this; }
+  QCPDataBlockIterator operator+(int n) const { return QCPDataBlockIterator(mBlocks, mIndex+n); }
+  QCPDataBlockIterator operator-(int n) const { return QCPDataBlockIterator(mBlocks, mIndex-n); }
+  friend QCPDataBlockIterator operator+(int n, const QCPDataBlockIterator &it) { return it+n; }
+  template <class R, class P> int operator-(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex-other.index(); }
+  template <class R, class P> bool operator==(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex == other.index(); }
+  template <class R, class P> bool operator!=(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex != other.index(); }
+  template <class R, class P> bool operator<(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex < other.index(); }
+  template <class R, class P> bool operator>(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex > other.index(); }
+  template <class R, class P> bool operator<=(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex <= other.index(); }
+  template <class R, class P> bool operator>=(const QCPDataBlockIterator<DataType, R, P, BlockShift> &other) const { return mIndex >= other.index(); }
+  
+protected:
+  Pointer const *mBlocks;
+  int mIndex;
+};
 
-/*! \class QCPDataContainer
-  \brief The generic data container for one-dimensional plottables
+class QCP_LIB_DECL QCPBlockAllocator
+{
+public:
+  QCPBlockAllocator();
+  virtual ~QCPBlockAllocator();
+  
+  // introduced virtual methods:
+  virtual void *allocate(qint64 bytes);
+  virtual void deallocate(void *memory, qint64 bytes);
+  
+  // static methods:
+  static QCPBlockAllocator *instance();
+  static void setInstance(QCPBlockAllocator *allocator);
+  
+private:
+  Q_DISABLE_COPY(QCPBlockAllocator)
+};
 
-  This class template provides a fast container for data storage of one-dimensional data. The data
-  type is specified as template parameter (called \a DataType in the following) and must provide
-  some methods as described in the \ref qcpdatacontainer-datatype "next section".
+class QCP_LIB_DECL QCPHugePageAllocator : public QCPBlockAllocator
+{
+public:
+  explicit QCPHugePageAllocator(qint64 slabSize=qint64(2)*1024*1024);
+  virtual ~QCPHugePageAllocator();
+  
+  // getters:
+  qint64 slabSize() const { return mSlabSize; }
+  int slabCount() const;
+  
+  // reimplemented virtual methods:
+  virtual void *allocate(qint64 bytes) Q_DECL_OVERRIDE;
+  virtual void deallocate(void *memory, qint64 bytes) Q_DECL_OVERRIDE;
+  
+protected:
+  struct Slab
+  {
+    char *memory;
+    qint64 blockBytes;
+    qint64 usedBytes;
+    int liveBlocks;
+    int partialIndex; // position in the list of slabs with room, or -1 if the slab is full
+    QVector<void*> freeBlocks;
+  };
+  
+  // property members:
+  qint64 mSlabSize;
+  
+  // non-property members:
+  mutable QMutex mMutex;
+  QHash<quintptr, Slab*> mSlabs;
+  QHash<qint64, QVector<Slab*> > mPartialSlabs;
+  Slab *mSpareSlab;
+  
+  // non-virtual methods:
+  Slab *createSlab(qint64 blockBytes);
+  void destroySlab(Slab *slab);
+  void addPartialSlab(Slab *slab);
+  void removePartialSlab(Slab *slab);
+  bool isFull(const Slab *slab) const { return slab->freeBlocks.isEmpty() && slab->usedBytes+slab->blockBytes > mSlabSize; }
+};
 
-  The data is stored in a sorted fashion, which allows very quick lookups by the sorted key as well
-  as retrieval of ranges (see \ref findBegin, \ref findEnd, \ref keyRange) using binary search. The
-  container uses a preallocation and a postallocation scheme, such that appending and prepending
-  data (with respect to the sort key) is very fast and minimizes reallocations. If data is added
-  which needs to be inserted between existing keys, the merge usually can be done quickly too,
-  using the fact that existing data is always sorted. The user can further improve performance by
-  specifying that added data is already itself sorted by key, if he can guarantee that this is the
-  case (see for example \ref add(const QVector<DataType> &data, bool alreadySorted)).
+template <class DataType>
+class QCPDataBlockTraits
+{
+public:
+  typedef DataType Element;
+  static const int blockShift = 12;
+  static const int headerSize = 0;
+  typedef QCPDataBlockIterator<DataType, const DataType&, const DataType*, blockShift> const_iterator;
+  typedef QCPDataBlockIterator<DataType, DataType&, DataType*, blockShift> iterator;
+  
+  static void initializeHeader(Element *block) { Q_UNUSED(block) }
+  static void copyHeader(const Element *from, Element *to) { Q_UNUSED(from) Q_UNUSED(to) }
+};
 
-  The data can be accessed with the provided const iterators (\ref constBegin, \ref constEnd). If
-  it is necessary to alter existing data in-place, the non-const iterators can be used (\ref begin,
-  \ref end). Changing data members that are not the sort key (for most data types called \a key) is
-  safe from the container's perspective.
+template <class DataType>
+class QCPDataBlockEpoch : public QSharedData
+{
+public:
+  explicit QCPDataBlockEpoch(QCPBlockAllocator *allocator) : mAllocator(allocator) {}
+  ~QCPDataBlockEpoch();
+  
+  QCPBlockAllocator *mAllocator;
+  QVector<typename QCPDataBlockTraits<DataType>::Element*> mRetiredBlocks;
+  QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > mNext;
+};
 
-  Great care must be taken however if the sort key is modified through the non-const iterators. For
-  performance reasons, the iterators don't automatically cause a re-sorting upon their
-  manipulation. It is thus the responsibility of the user to leave the container in a sorted state
-  when finished with the data manipulation, before calling any other methods on the container. A
-  complete re-sort (e.g. after finishing all sort key manipulation) can be done by calling \ref
-  sort. Failing to do so can not be detected by the container efficiently and will cause both
-  rendering artifacts and potential data loss.
+template <class DataType> class QCPDataSnapshot;
 
-  Implementing one-dimensional plottables that make use of a \ref QCPDataContainer<T> is usually
-  done by subclassing from \ref QCPAbstractPlottable1D "QCPAbstractPlottable1D<T>", which
-  introduces an according \a mDataContainer member and some convenience methods.
+template <class DataType>
+class QCP_LIB_DECL QCPDataBlockStorage
+{
+public:
+  typedef typename QCPDataBlockTraits<DataType>::Element Element;
+  static const int blockShift = QCPDataBlockTraits<DataType>::blockShift;
+  static const int blockSize = 1 << blockShift;
+  static const int blockBytes = QCPDataBlockTraits<DataType>::headerSize+blockSize*int(sizeof(Element));
+  typedef typename QCPDataBlockTraits<DataType>::const_iterator const_iterator;
+  typedef typename QCPDataBlockTraits<DataType>::iterator iterator;
+  
+  QCPDataBlockStorage();
+  QCPDataBlockStorage(const QCPDataBlockStorage<DataType> &other);
+  ~QCPDataBlockStorage();
+  QCPDataBlockStorage<DataType> &operator=(const QCPDataBlockStorage<DataType> &other);
+  QCPDataBlockStorage<DataType> &operator=(const QVector<DataType> &data);
+  
+  // getters:
+  int size() const { return mSize; }
+  bool isEmpty() const { return mSize == 0; }
+  int capacity() const { return mBlocks.size()*blockSize-mOffset; }
+  int blockCount() const { return mBlocks.size(); }
+  QCPBlockAllocator *allocator() const { return mAllocator; }
+  
+  // non-virtual methods:
+  const_iterator constBegin() const { return const_iterator(mBlocks.constData(), mOffset); }
+  const_iterator constEnd() const { return const_iterator(mBlocks.constData(), mOffset+mSize); }
+  iterator begin() { return iterator(mBlocks.constData(), mOffset); }
+  iterator end() { return iterator(mBlocks.constData(), mOffset+mSize); }
+  void resize(int size);
+  void append(const DataType &data);
+  iterator insert(iterator before, const DataType &data);
+  iterator erase(iterator begin, iterator end);
+  iterator erase(iterator pos) { return erase(pos, pos+1); }
+  void clear();
+  void squeeze();
+  void growFront(int n);
+  void shrinkFront(int n);
+  QCPDataSnapshot<DataType> snapshot(int from=0);
+  void detach(int from, int to);
+  
+protected:
+  // non-property members:
+  QVector<Element*> mBlocks;
+  QVector<bool> mSharedBlocks;
+  QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > mEpoch;
+  QCPBlockAllocator *mAllocator;
+  int mOffset;
+  int mSize;
+  
+  // non-virtual methods:
+  bool isShared() const { return mEpoch && mEpoch->ref.load() > 1; }
+  Element *allocateBlock() const;
+  void releaseBlock(Element *block);
+};
 
-  \section qcpdatacontainer-datatype Requirements for the DataType template parameter
+template <class DataType>
+class QCP_LIB_DECL QCPDataSnapshot
+{
+public:
+  typedef typename QCPDataBlockStorage<DataType>::const_iterator const_iterator;
+  
+  QCPDataSnapshot();
+  QCPDataSnapshot(const QVector<typename QCPDataBlockTraits<DataType>::Element*> &blocks, int offset, int size, QCPDataBlockEpoch<DataType> *epoch);
+  
+  // getters:
+  int size() const { return mSize; }
+  bool isEmpty() const { return mSize == 0; }
+  
+  // non-virtual methods:
+  const_iterator constBegin() const { return const_iterator(mBlocks.constData(), mOffset); }
+  const_iterator constEnd() const { return const_iterator(mBlocks.constData(), mOffset+mSize); }
+  const_iterator findBegin(double sortKey, bool expandedRange=true) const;
+  const_iterator findEnd(double sortKey, bool expandedRange=true) const;
+  const_iterator at(int index) const { return constBegin()+qBound(0, index, size()); }
+  QCPDataRange dataRange() const { return QCPDataRange(0, size()); }
+  
+protected:
+  // non-property members:
+  QVector<typename QCPDataBlockTraits<DataType>::Element*> mBlocks;
+  int mOffset;
+  int mSize;
+  QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > mEpoch;
+};
 
-  The template parameter <tt>DataType</tt> is the type of the stored data points. It must be
-  trivially copyable and have the following public methods, preferably inline:
+/*! \relates QCPDataContainer
 
-  \li <tt>double sortKey() const</tt>\n Returns the member variable of this data point that is the
-  sort key, defining the ordering in the container. Often this variable is simply called \a key.
+  Selects the storage type that a \ref QCPDataContainer with the given \a DataType uses if no
+  storage type is passed explicitly. This is a QVector, unless the traits class is specialized for
+  the data type, as done for \ref QCPGraphData when \c QCUSTOMPLOT_USE_BLOCK_STORAGE is defined.
+  
+  \see QCPDataBlockStorage
+*/
+template <class DataType>
+class QCPDataStorageTraits
+{
+public:
+  typedef QVector<DataType> StorageType;
+};
 
-  \li <tt>static DataType fromSortKey(double sortKey)</tt>\n Returns a new instance of the data
-  type initialized with its sort key set to \a sortKey.
+/*! \internal \relates QCPDataContainer
 
-  \li <tt>static bool sortKeyIsMainKey()</tt>\n Returns true if the sort key is equal to the main
-  key (see method \c mainKey below). For most plottables this is the case. It is not the case for
-  example for \ref QCPCurve, which uses \a t as sort key and \a key as main key. This is the reason
-  why QCPCurve unlike QCPGraph can display parametric curves with loops.
+  Inserts \a n unused elements in front of the \a preallocSize unused elements at the beginning of
+  \a storage. QVector has to move all existing elements to make room.
+*/
+template <class DataType>
+inline void qcpStorageGrowFront(QVector<DataType> &storage, int preallocSize, int n)
+{
+  storage.resize(storage.size()+n);
+  std::copy_backward(storage.begin()+preallocSize, storage.end()-n, storage.end());
+}
 
-  \li <tt>double mainKey() const</tt>\n Returns the variable of this data point considered the main
-  key. This is commonly the variable that is used as the coordinate of this data point on the key
-  axis of the plottable. This method is used for example when determining the automatic axis
-  rescaling of key axes (\ref QCPAxis::rescale).
+/*! \internal \relates QCPDataContainer
+  \overload
+  
+  QCPDataBlockStorage just adds blocks in front, without moving any elements.
+*/
+template <class DataType>
+inline void qcpStorageGrowFront(QCPDataBlockStorage<DataType> &storage, int preallocSize, int n)
+{
+  Q_UNUSED(preallocSize)
+  storage.growFront(n);
+}
 
-  \li <tt>double mainValue() const</tt>\n Returns the variable of this data point considered the
-  main value. This is commonly the variable that is used as the coordinate of this data point on
-  the value axis of the plottable.
+/*! \internal \relates QCPDataContainer
 
-  \li <tt>QCPRange valueRange() const</tt>\n Returns the range this data point spans in the value
-  axis coordinate. If the data is single-valued (e.g. QCPGraphData), this is simply a range with
-  both lower and upper set to the main data point value. However if the data points can represent
-  multiple values at once (e.g QCPFinancialData with its \a high, \a low, \a open and \a close
-  values at each \a key) this method should return the range those values span. This method is used
-  for example when determining the automatic axis rescaling of value axes (\ref
-  QCPAxis::rescale).
+  Removes the first \a n elements of \a storage. QVector has to move all remaining elements.
 */
+template <class DataType>
+inline void qcpStorageShrinkFront(QVector<DataType> &storage, int n)
+{
+  std::copy(storage.begin()+n, storage.end(), storage.begin());
+  storage.resize(storage.size()-n);
+}
 
-/* start documentation of inline functions */
-
-/*! \fn int QCPDataContainer<DataType>::size() const
+/*! \internal \relates QCPDataContainer
+  \overload
   
-  Returns the number of data points in the container.
+  QCPDataBlockStorage just releases the blocks that became unused, without moving any elements.
 */
+template <class DataType>
+inline void qcpStorageShrinkFront(QCPDataBlockStorage<DataType> &storage, int n)
+{
+  storage.shrinkFront(n);
+}
 
-/*! \fn bool QCPDataContainer<DataType>::isEmpty() const
+/*! \internal \relates QCPDataContainer
   
-  Returns whether this container holds no data points.
+  Announces that the elements from \a from to \a to of \a storage are about to be written. A
+  QVector storage can't be read through snapshots, so there is nothing to do.
 */
+template <class DataType>
+inline void qcpStorageDetach(QVector<DataType> &storage, int from, int to)
+{
+  Q_UNUSED(storage)
+  Q_UNUSED(from)
+  Q_UNUSED(to)
+}
 
-/*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::constBegin() const
+/*! \internal \relates QCPDataContainer
+  \overload
   
-  Returns a const iterator to the first data point in this container.
+  QCPDataBlockStorage copies the blocks in the range that are still referenced by snapshots.
 */
+template <class DataType>
+inline void qcpStorageDetach(QCPDataBlockStorage<DataType> &storage, int from, int to)
+{
+  storage.detach(from, to);
+}
 
-/*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::constEnd() const
+/*! \internal \relates QCPDataContainer
   
-  Returns a const iterator to the element past the last data point in this container.
+  Returns the number of bytes allocated by \a storage, including its unused capacity.
 */
+template <class DataType>
+inline qint64 qcpStorageMemoryUsage(const QVector<DataType> &storage)
+{
+  return qint64(storage.capacity())*sizeof(DataType);
+}
 
-/*! \fn QCPDataContainer::iterator QCPDataContainer<DataType>::begin() const
+/*! \internal \relates QCPDataContainer
+  \overload
   
-  Returns a non-const iterator to the first data point in this container.
-
-  You can manipulate the data points in-place through the non-const iterators, but great care must
-  be taken when manipulating the sort key of a data point, see \ref sort, or the detailed
-  description of this class.
+  QCPDataBlockStorage allocates whole blocks. Blocks that are shared with snapshots are counted as
+  well, even though they are freed only when the last snapshot reading them is gone.
+*/
+template <class DataType>
+inline qint64 qcpStorageMemoryUsage(const QCPDataBlockStorage<DataType> &storage)
+{
+  return qint64(storage.blockCount())*(QCPDataBlockStorage<DataType>::blockBytes+sizeof(void*)+sizeof(bool));
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Returns the number of data points from \a it up to \a end that are stored contiguously in memory,
+  so they can be processed through the pointer \c &*it.
+*/
+template <class DataType>
+inline int qcpContiguousCount(const DataType *it, const DataType *end)
+{
+  return int(end-it);
+}
+
+/*! \internal \relates QCPDataContainer
+  \overload
+  
+  For QCPDataBlockStorage, this is at most the rest of the block \a it is in.
+*/
+template <class DataType, class Reference, class Pointer, int BlockShift>
+inline int qcpContiguousCount(const QCPDataBlockIterator<DataType, Reference, Pointer, BlockShift> &it, const QCPDataBlockIterator<DataType, Reference, Pointer, BlockShift> &end)
+{
+  return qMin(int(end-it), (1 << BlockShift)-(it.index() & ((1 << BlockShift)-1)));
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Copies the data points from \a first up to \a last to the range starting at \a result, like \c
+  std::copy. \ref QCPDataContainer and \ref QCPDataBlockStorage write ranges of data points with
+  this and \ref qcpStorageCopyBackward, so a storage that doesn't keep the data points as they are
+  can provide overloads for its iterators.
+*/
+template <class InputIterator, class OutputIterator>
+inline OutputIterator qcpStorageCopy(InputIterator first, InputIterator last, OutputIterator result)
+{
+  return std::copy(first, last, result);
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Copies the data points from \a first up to \a last to the range ending at \a resultEnd, like \c
+  std::copy_backward. See \ref qcpStorageCopy.
+*/
+template <class BidirectionalIterator1, class BidirectionalIterator2>
+inline BidirectionalIterator2 qcpStorageCopyBackward(BidirectionalIterator1 first, BidirectionalIterator1 last, BidirectionalIterator2 resultEnd)
+{
+  return std::copy_backward(first, last, resultEnd);
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Merges the sorted data points from \a first to \a middle with the sorted ones from \a middle to
+  \a last, like \c std::inplace_merge. Data points with equal sort keys keep their order. See \ref
+  qcpStorageCopy.
+*/
+template <class DataType, class BidirectionalIterator>
+inline void qcpMergeByKey(BidirectionalIterator first, BidirectionalIterator middle, BidirectionalIterator last)
+{
+  std::inplace_merge(first, middle, last, qcpLessThanSortKey<DataType>);
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Returns the sort key of \a data mapped to an unsigned integer whose order is the same as the
+  order of the sort keys (NaN aside), so it can be sorted digit by digit in \ref qcpSortByKey.
+*/
+template <class DataType>
+inline quint64 qcpRadixSortKey(const DataType &data)
+{
+  const double sortKey = data.sortKey();
+  quint64 bits;
+  std::memcpy(&bits, &sortKey, sizeof(bits));
+  return (bits & Q_UINT64_C(0x8000000000000000)) ? ~bits : bits | Q_UINT64_C(0x8000000000000000);
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Sorts the data points from \a first to \a last with an LSD radix sort on the bit pattern of their
+  sort key (see \ref qcpRadixSortKey), using 8 bit digits. All digits are counted in one pass, and
+  digits that are the same for all data points, like the high bytes of timestamps, are skipped.
+  This needs a temporary buffer of the size of the range, and keeps data points with equal sort
+  keys in their original order.
+*/
+template <class DataType, class RandomAccessIterator>
+void qcpRadixSortByKey(RandomAccessIterator first, RandomAccessIterator last)
+{
+  const int n = int(last-first);
+  if (n < 2)
+    return;
+  const int digitCount = 8;
+  QVector<int> histograms(digitCount*256, 0);
+  int *counts = histograms.data();
+  for (RandomAccessIterator it=first; it!=last; ++it)
+  {
+    const quint64 key = qcpRadixSortKey(*it);
+    for (int d=0; d<digitCount; ++d)
+      ++counts[d*256+int((key>>(8*d))&0xFF)];
+  }
+  QVector<DataType> buffer(n);
+  DataType *bufferData = buffer.data();
+  bool inBuffer = false;
+  for (int d=0; d<digitCount; ++d)
+  {
+    int *digitCounts = counts+d*256;
+    if (digitCounts[int((qcpRadixSortKey(*first)>>(8*d))&0xFF)] == n) // all data points have the same digit, pass wouldn't change anything
+      continue;
+    int offset = 0;
+    for (int b=0; b<256; ++b)
+    {
+      const int count = digitCounts[b];
+      digitCounts[b] = offset;
+      offset += count;
+    }
+    if (inBuffer)
+    {
+      for (int i=0; i<n; ++i)
+        *(first+digitCounts[int((qcpRadixSortKey(bufferData[i])>>(8*d))&0xFF)]++) = bufferData[i];
+    } else
+    {
+      for (RandomAccessIterator it=first; it!=last; ++it)
+        bufferData[digitCounts[int((qcpRadixSortKey(*it)>>(8*d))&0xFF)]++] = *it;
+    }
+    inBuffer = !inBuffer;
+  }
+  if (inBuffer)
+    std::copy(bufferData, bufferData+n, first);
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  One step of the parallel sorting in \ref qcpSortByKey: Either radix sorting the data points from
+  \a first to \a last, or, if \a middle isn't \a last, merging the sorted data points from \a first
+  to \a middle with the sorted ones from \a middle to \a last. It is shared between the calling
+  thread and a \ref QCPSortTask, and whichever claims it first performs it.
+*/
+template <class DataType, class RandomAccessIterator>
+class QCPSortJob
+{
+public:
+  QCPSortJob() : done(0) {}
+  
+  bool claim() { return claimed.testAndSetOrdered(0, 1); }
+  void perform()
+  {
+    if (middle == last)
+      qcpRadixSortByKey<DataType>(first, last);
+    else
+      std::inplace_merge(first, middle, last, qcpLessThanSortKey<DataType>);
+  }
+  
+  QAtomicInt claimed;
+  QSemaphore *done;
+  RandomAccessIterator first, middle, last;
+};
+
+/*! \internal \relates QCPDataContainer
+  
+  Performs a \ref QCPSortJob on a thread of the pool, unless the calling thread has already
+  claimed it. The task may run after the sorting has finished, so it only holds a shared reference
+  to the job.
+*/
+template <class DataType, class RandomAccessIterator>
+class QCPSortTask : public QRunnable
+{
+public:
+  explicit QCPSortTask(const QSharedPointer<QCPSortJob<DataType, RandomAccessIterator> > &job) : mJob(job) {}
+  
+  virtual void run() Q_DECL_OVERRIDE
+  {
+    if (mJob->claim())
+    {
+      mJob->perform();
+      mJob->done->release();
+    }
+  }
+  
+private:
+  QSharedPointer<QCPSortJob<DataType, RandomAccessIterator> > mJob;
+};
+
+/*! \internal \relates QCPDataContainer
+  
+  Performs the independent \a jobs, all but the first on QThreadPool::globalInstance while the
+  calling thread performs the first. Jobs that no pool thread has started yet are performed by the
+  calling thread too, so this never waits for pool threads that are busy with other work. Returns
+  when all jobs are done.
+*/
+template <class DataType, class RandomAccessIterator>
+void qcpPerformSortJobs(const QVector<QSharedPointer<QCPSortJob<DataType, RandomAccessIterator> > > &jobs)
+{
+  QSemaphore done;
+  for (int i=1; i<jobs.size(); ++i)
+  {
+    jobs.at(i)->done = &done;
+    QThreadPool::globalInstance()->start(new QCPSortTask<DataType, RandomAccessIterator>(jobs.at(i)));
+  }
+  jobs.first()->perform();
+  int pending = 0;
+  for (int i=1; i<jobs.size(); ++i)
+  {
+    if (jobs.at(i)->claim())
+      jobs.at(i)->perform();
+    else
+      ++pending;
+  }
+  done.acquire(pending);
+}
+
+/*! \relates QCPDataContainer
+  
+  Sorts the data points from \a first to \a last by their sort key. This is what \ref
+  QCPDataContainer uses whenever it has to sort data, and it picks the cheapest method for the
+  data at hand:
+  
+  \li Data that is already sorted is detected in a single pass and left untouched.
+  \li Data that consists of a few sorted runs (e.g. the concatenated recordings of several
+  devices) is merged run by run.
+  \li Small ranges are sorted with \c std::sort.
+  \li Large ranges are sorted with an LSD radix sort on the bit pattern of the sort key (see \ref
+  qcpRadixSortByKey). This needs a temporary buffer of the size of the range.
+  \li Ranges of more than a million data points are split into chunks, one per thread of
+  QThreadPool::globalInstance. The chunks are radix sorted in parallel, and then merged pairwise,
+  with the merges of each round running in parallel as well. The calling thread takes part, so
+  this also works if the pool is busy.
+  
+  Unlike \c std::sort, the radix sort and the run merging keep data points with equal sort keys in
+  their original order.
+*/
+template <class DataType, class RandomAccessIterator>
+void qcpSortByKey(RandomAccessIterator first, RandomAccessIterator last)
+{
+  const int n = int(last-first);
+  if (n < 2)
+    return;
+  
+  // find the sorted runs, but stop looking once there are too many to merge them individually:
+  const int maxRuns = 16;
+  int runEnds[maxRuns];
+  int runCount = 0;
+  for (int i=1; i<n && runCount < maxRuns; ++i)
+  {
+    if (qcpLessThanSortKey<DataType>(*(first+i), *(first+(i-1))))
+      runEnds[runCount++] = i;
+  }
+  if (runCount == 0) // already sorted
+    return;
+  if (runCount < maxRuns) // few sorted runs, merge them
+  {
+    runEnds[runCount++] = n;
+    for (int step=1; step<runCount; step*=2)
+    {
+      for (int i=step; i<runCount; i+=2*step) // merge the runs i-step..i-1 with the runs i..i+step-1
+      {
+        const int begin = i == step ? 0 : runEnds[i-step-1];
+        std::inplace_merge(first+begin, first+runEnds[i-1], first+runEnds[qMin(i+step, runCount)-1], qcpLessThanSortKey<DataType>);
+      }
+    }
+    return;
+  }
+  if (n < 65536)
+  {
+    std::sort(first, last, qcpLessThanSortKey<DataType>);
+    return;
+  }
+  
+  const int minChunkSize = 1 << 18;
+  const int chunkCount = n < 4*minChunkSize ? 1 : qMin(QThreadPool::globalInstance()->maxThreadCount(), n/minChunkSize);
+  if (chunkCount < 2)
+  {
+    qcpRadixSortByKey<DataType>(first, last);
+    return;
+  }
+  
+  // radix sort the chunks in parallel, then merge neighbouring ones until one is left:
+  typedef QSharedPointer<QCPSortJob<DataType, RandomAccessIterator> > Job;
+  QVector<RandomAccessIterator> bounds(chunkCount+1);
+  for (int i=0; i<=chunkCount; ++i)
+    bounds[i] = first+int(qint64(n)*i/chunkCount);
+  QVector<Job> jobs(chunkCount);
+  for (int i=0; i<chunkCount; ++i)
+  {
+    jobs[i] = Job(new QCPSortJob<DataType, RandomAccessIterator>);
+    jobs[i]->first = bounds.at(i);
+    jobs[i]->middle = jobs[i]->last = bounds.at(i+1);
+  }
+  qcpPerformSortJobs<DataType, RandomAccessIterator>(jobs);
+  for (int step=1; step<chunkCount; step*=2)
+  {
+    jobs.clear();
+    for (int i=0; i+step<chunkCount; i+=2*step)
+    {
+      jobs.append(Job(new QCPSortJob<DataType, RandomAccessIterator>));
+      jobs.last()->first = bounds.at(i);
+      jobs.last()->middle = bounds.at(i+step);
+      jobs.last()->last = bounds.at(qMin(i+2*step, chunkCount));
+    }
+    qcpPerformSortJobs<DataType, RandomAccessIterator>(jobs);
+  }
+}
+
+/*! \internal \relates QCPDataContainer
+  
+  Copies the data points from \a first up to \a last to the range starting at \a result and sorts
+  them there by their sort key with \ref qcpSortByKey. See \ref qcpStorageCopy.
+*/
+template <class DataType, class ForwardIterator, class RandomAccessIterator>
+inline void qcpStorageCopySorted(ForwardIterator first, ForwardIterator last, RandomAccessIterator result)
+{
+  qcpSortByKey<DataType>(result, qcpStorageCopy(first, last, result));
+}
+
+template <class DataType>
+class QCPDataColumnIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef DataType value_type;
+  typedef int difference_type;
+  typedef const DataType *pointer;
+  typedef DataType reference;
+  
+  QCPDataColumnIterator(const double *keys, const double *values) : mKeys(keys), mValues(values) {}
+  
+  // non-virtual methods:
+  DataType operator*() const { return DataType(*mKeys, *mValues); }
+  DataType operator[](int n) const { return DataType(mKeys[n], mValues[n]); }
+  QCPDataColumnIterator &operator++() { ++mKeys; ++mValues; return *this; }
+  QCPDataColumnIterator &operator--() { --mKeys; --mValues; return *this; }
+  QCPDataColumnIterator operator++(int) { QCPDataColumnIterator result(*this); ++*this; return result; }
+  QCPDataColumnIterator operator--(int) { QCPDataColumnIterator result(*this); --*this; return result; }
+  QCPDataColumnIterator &operator+=(int n) { mKeys += n; mValues += n; return *this; }
+  QCPDataColumnIterator &operator-=(int n) { mKeys -= n; mValues -= n; return *this; }
+  QCPDataColumnIterator operator+(int n) const { return QCPDataColumnIterator(mKeys+n, mValues+n); }
+  QCPDataColumnIterator operator-(int n) const { return QCPDataColumnIterator(mKeys-n, mValues-n); }
+  int operator-(const QCPDataColumnIterator &other) const { return int(mKeys-other.mKeys); }
+  bool operator==(const QCPDataColumnIterator &other) const { return mKeys == other.mKeys; }
+  bool operator!=(const QCPDataColumnIterator &other) const { return mKeys != other.mKeys; }
+  bool operator<(const QCPDataColumnIterator &other) const { return mKeys < other.mKeys; }
+  
+protected:
+  const double *mKeys;
+  const double *mValues;
+};
+
+template <class DataType, class StorageType=typename QCPDataStorageTraits<DataType>::StorageType>
+class QCP_LIB_DECL QCPDataContainer
+{
+public:
+  typedef typename StorageType::const_iterator const_iterator;
+  typedef typename StorageType::iterator iterator;
+  
+  QCPDataContainer();
+  
+  // getters:
+  int size() const { if (!mStaging.isEmpty()) mergeStaging(); return mData.size()-mPreallocSize; }
+  bool isEmpty() const { return size() == 0; }
+  bool autoSqueeze() const { return mAutoSqueeze; }
+  bool pyramidIndex() const { return mPyramidIndex; }
+  int sizeLimit() const { return mSizeLimit; }
+  double keySpanLimit() const { return mKeySpanLimit; }
+  int stagingLimit() const { return mStagingLimit; }
+  quint64 editCount() const { if (!mStaging.isEmpty()) mergeStaging(); return mEditCount; }
+  quint64 removedFrontCount() const { if (!mStaging.isEmpty()) mergeStaging(); return mRemovedFrontCount; }
+  
+  // setters:
+  void setAutoSqueeze(bool enabled);
+  void setPyramidIndex(bool enabled);
+  void setSizeLimit(int limit);
+  void setKeySpanLimit(double span);
+  void setStagingLimit(int limit);
+  
+  // non-virtual methods:
+  void set(const QCPDataContainer<DataType, StorageType> &data);
+  void set(const QVector<DataType> &data, bool alreadySorted=false);
+  void add(const QCPDataContainer<DataType, StorageType> &data);
+  void add(const QVector<DataType> &data, bool alreadySorted=false);
+  void add(const DataType &data);
+  template <class InputIterator>
+  void add(InputIterator first, InputIterator last, bool alreadySorted=false);
+#ifdef Q_COMPILER_RVALUE_REFS
+  void set(QVector<DataType> &&data, bool alreadySorted=false);
+  void add(QVector<DataType> &&data, bool alreadySorted=false);
+#endif
+  void removeBefore(double sortKey);
+  void removeAfter(double sortKey);
+  void remove(double sortKeyFrom, double sortKeyTo);
+  void remove(double sortKey);
+  template <class InputIterator>
+  void replace(double sortKeyFrom, double sortKeyTo, InputIterator first, InputIterator last);
+  void clear();
+  void sort();
+  void squeeze(bool preAllocation=true, bool postAllocation=true);
+  void releasePyramidIndex();
+  void prepareForReading() const;
+  
+  const_iterator constBegin() const { if (!mStaging.isEmpty()) mergeStaging(); return mData.constBegin()+mPreallocSize; }
+  const_iterator constEnd() const { if (!mStaging.isEmpty()) mergeStaging(); return mData.constEnd(); }
+  iterator begin() { if (!mStaging.isEmpty()) mergeStaging(); mPyramid.invalidate(); ++mEditCount; qcpStorageDetach(mData, mPreallocSize, mData.size()); return mData.begin()+mPreallocSize; }
+  iterator end() { if (!mStaging.isEmpty()) mergeStaging(); mPyramid.invalidate(); ++mEditCount; qcpStorageDetach(mData, mPreallocSize, mData.size()); return mData.end(); }
+  const_iterator findBegin(double sortKey, bool expandedRange=true) const;
+  const_iterator findEnd(double sortKey, bool expandedRange=true) const;
+  const_iterator at(int index) const { return constBegin()+qBound(0, index, size()); }
+  QCPRange keyRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth);
+  QCPRange valueRange(bool &foundRange, QCP::SignDomain signDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange());
+  QCPDataSummary summary(const const_iterator &begin, const const_iterator &end) const;
+  QCPDataRange dataRange() const { return QCPDataRange(0, size()); }
+  QCPDataSnapshot<DataType> snapshot();
+  qint64 memoryUsage() const;
+  void limitIteratorsToDataRange(const_iterator &begin, const_iterator &end, const QCPDataRange &dataRange) const;
+  
+protected:
+  // property members:
+  bool mAutoSqueeze;
+  bool mPyramidIndex;
+  int mSizeLimit;
+  double mKeySpanLimit;
+  int mStagingLimit;
+  
+  // non-property memebers:
+  mutable StorageType mData;
+  mutable int mPreallocSize;
+  int mPreallocIteration;
+  mutable QCPDataPyramid<DataType> mPyramid;
+  mutable QVector<DataType> mStaging;
+  mutable QAtomicInt mFindBeginFinger, mFindEndFinger;
+  mutable quint64 mEditCount, mRemovedFrontCount;
+  
+  // non-virtual methods:
+  void preallocateGrow(int minimumPreallocSize);
+  void performAutoSqueeze();
+  int fingerSearch(double sortKey, bool upperBound, QAtomicInt &finger) const;
+  
+  static const int maxFingerStep = 16;
+  void removeFront(int count);
+  void applyLimits();
+  int limitExcess() const;
+  void mergeStaging() const;
+};
+
+// include implementation in header since it is a class template:
+
+/* including file 'src/datacontainer.cpp', size 31224                        */
+/* commit 633339dadc92cb10c58ef3556b55570685fafb99 2016-09-13 23:54:56 +0200 */
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDataSummary
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDataSummary
+  \brief Holds the value extremes and boundary values of a contiguous run of data points
+  
+  The stored data is:
+  \li \a minimum: the smallest lower bound of the data points' \a valueRange
+  \li \a maximum: the largest upper bound of the data points' \a valueRange
+  \li \a first: the \a mainValue of the first data point of the run
+  \li \a last: the \a mainValue of the last data point of the run
+  
+  NaN values of the data points are ignored for \a minimum and \a maximum. If the run contains no
+  data point with a valid value, \a minimum and \a maximum are NaN.
+  
+  Summaries are generated by \ref QCPDataContainer::summary, optionally accelerated by the
+  container's pyramid index (see \ref QCPDataContainer::setPyramidIndex).
+*/
+
+/*!
+  Constructs an empty summary, with all members set to NaN.
+*/
+inline QCPDataSummary::QCPDataSummary() :
+  minimum(qQNaN()),
+  maximum(qQNaN()),
+  first(qQNaN()),
+  last(qQNaN())
+{
+}
+
+/*!
+  Constructs a summary of the single data point \a data.
+*/
+template <class DataType>
+inline QCPDataSummary::QCPDataSummary(const DataType &data) :
+  minimum(data.valueRange().lower),
+  maximum(data.valueRange().upper),
+  first(data.mainValue()),
+  last(data.mainValue())
+{
+}
+
+/*!
+  Expands this summary by the data point \a data, which must follow the data points already
+  summarized with respect to the sort key.
+*/
+template <class DataType>
+inline void QCPDataSummary::expand(const DataType &data)
+{
+  const QCPRange range = data.valueRange();
+  if (qIsNaN(minimum) || range.lower < minimum)
+    minimum = range.lower;
+  if (qIsNaN(maximum) || range.upper > maximum)
+    maximum = range.upper;
+  last = data.mainValue();
+}
+
+/*! \overload
+
+  Expands this summary by the summary \a other, which must describe data points that follow the
+  data points already summarized with respect to the sort key.
+*/
+inline void QCPDataSummary::expand(const QCPDataSummary &other)
+{
+  if (qIsNaN(minimum) || other.minimum < minimum)
+    minimum = other.minimum;
+  if (qIsNaN(maximum) || other.maximum > maximum)
+    maximum = other.maximum;
+  last = other.last;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDataPyramid
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDataPyramid
+  \brief A multi-resolution index of the value extremes in a QCPDataContainer
+  
+  The pyramid stores a \ref QCPDataSummary for every block of <tt>2^(baseShift+level)</tt>
+  consecutive data points, for all levels up to the one that covers the whole container with a
+  single block. The summary of an arbitrary run of data points can thus be assembled from at most
+  two blocks per level, plus the few data points at the run's ends that don't fill a base block.
+  This makes value range queries O(log n) instead of O(n).
+  
+  The index is addressed by position relative to the container's first data point. It is
+  maintained lazily: \ref update only processes the data points that were appended since the last
+  call, so live data that grows at the end is indexed incrementally. Data points removed from the
+  front are reported with \ref removeFront, which keeps the index valid. If only the data points
+  from some position on were modified, \ref invalidateFrom makes the next \ref update rebuild just
+  that part. Any other modification requires a call to \ref invalidate, after which the next \ref
+  update rebuilds the index completely.
+  
+  This class is used internally by \ref QCPDataContainer, see \ref
+  QCPDataContainer::setPyramidIndex.
+*/
+
+/*!
+  Constructs an empty pyramid index.
+*/
+template <class DataType>
+QCPDataPyramid<DataType>::QCPDataPyramid() :
+  mIndexedSize(0),
+  mOrigin(0)
+{
+}
+
+/*!
+  Invalidates the index and frees the memory held by its levels.
+*/
+template <class DataType>
+void QCPDataPyramid<DataType>::clear()
+{
+  mLevels.clear();
+  mIndexedSize = 0;
+  mOrigin = 0;
+}
+
+/*!
+  Returns the number of bytes allocated by the levels of the index. The index can always be
+  rebuilt from the data, so this memory may be freed with \ref clear if it is needed elsewhere (see
+  \ref QCPDataContainer::releasePyramidIndex).
+*/
+template <class DataType>
+qint64 QCPDataPyramid<DataType>::memoryUsage() const
+{
+  qint64 bytes = qint64(mLevels.capacity())*sizeof(QVector<QCPDataSummary>);
+  for (int i=0; i<mLevels.size(); ++i)
+    bytes += qint64(mLevels.at(i).capacity())*sizeof(QCPDataSummary);
+  return bytes;
+}
+
+/*!
+  Invalidates the index for the data points from \a position on, e.g. because data points were
+  inserted there. The next \ref update only rebuilds the blocks from the one containing \a
+  position onwards.
+*/
+template <class DataType>
+void QCPDataPyramid<DataType>::invalidateFrom(int position)
+{
+  if (position >= mIndexedSize)
+    return;
+  const int validEnd = ((mOrigin+position) >> baseShift) << baseShift; // start of the base block containing position
+  if (validEnd <= mOrigin || mLevels.isEmpty())
+  {
+    invalidate();
+    return;
+  }
+  mLevels[0].resize(validEnd >> baseShift);
+  mIndexedSize = validEnd-mOrigin;
+}
+
+/*!
+  Tells the index that the first \a n data points were removed from the container, without
+  changing any of the others.
+  
+  The blocks are aligned to the position the container's first data point had when the index was
+  built, so instead of moving the blocks, the index just remembers how far the first data point has
+  moved. Blocks that only cover removed data points are never used by \ref summary again. Once
+  they outnumber the blocks still in use, the index drops them, which keeps the memory and the cost
+  per removed data point bounded for containers that continuously drop old data.
+*/
+template <class DataType>
+void QCPDataPyramid<DataType>::removeFront(int n)
+{
+  if (n <= 0 || mIndexedSize == 0)
+    return;
+  if (n >= mIndexedSize)
+  {
+    clear();
+    return;
+  }
+  mOrigin += n;
+  mIndexedSize -= n;
+  if (mOrigin < mIndexedSize)
+    return;
+  
+  // drop the leading blocks on all levels up to the largest block size that fits into the removed
+  // range, those blocks stay aligned. The levels above are rebuilt from there:
+  int level = 0;
+  while (level+1 < mLevels.size() && (qint64(1) << (baseShift+level+1)) <= mOrigin)
+    ++level;
+  const int shift = mOrigin & ~((1 << (baseShift+level))-1);
+  if (shift == 0)
+    return;
+  for (int i=0; i<=level; ++i)
+    mLevels[i].remove(0, shift >> (baseShift+i));
+  mLevels.resize(level+1);
+  mOrigin -= shift;
+  propagate(level, 0);
+}
+
+/*!
+  Brings the index up to date with the \a size data points starting at \a begin. Data points that
+  were already indexed are assumed unchanged, so only the ones appended since the last update are
+  processed, together with the O(log n) ancestor blocks they touch. After \ref invalidate, the
+  index is rebuilt completely.
+*/
+template <class DataType>
+template <class Iterator>
+void QCPDataPyramid<DataType>::update(const Iterator &begin, int size)
+{
+  if (mIndexedSize == 0 || size < mIndexedSize)
+    clear();
+  if (size == mIndexedSize)
+    return;
+  
+  // summarize the new data points into the base level:
+  if (mLevels.isEmpty())
+    mLevels.append(QVector<QCPDataSummary>());
+  QVector<QCPDataSummary> &baseLevel = mLevels[0];
+  for (int i=mIndexedSize; i<size; ++i)
+  {
+    const int block = (mOrigin+i) >> baseShift;
+    if (block == baseLevel.size())
+      baseLevel.append(QCPDataSummary(*(begin+i)));
+    else
+      baseLevel[block].expand(*(begin+i));
+  }
+  
+  propagate(0, (mOrigin+mIndexedSize) >> baseShift);
+  mIndexedSize = size;
+}
+
+/*! \internal
+  
+  Recomputes the blocks above \a level that depend on the blocks of \a level starting at index \a
+  firstDirty, adding levels until the top level consists of a single block.
+*/
+template <class DataType>
+void QCPDataPyramid<DataType>::propagate(int level, int firstDirty)
+{
+  for (; mLevels.at(level).size() > 1; ++level)
+  {
+    if (level+1 == mLevels.size())
+    {
+      mLevels.append(QVector<QCPDataSummary>());
+      firstDirty = 0;
+    }
+    const QVector<QCPDataSummary> &children = mLevels.at(level);
+    QVector<QCPDataSummary> &parents = mLevels[level+1];
+    firstDirty /= 2;
+    parents.resize((children.size()+1)/2);
+    for (int i=firstDirty; i<parents.size(); ++i)
+    {
+      parents[i] = children.at(i*2);
+      if (i*2+1 < children.size())
+        parents[i].expand(children.at(i*2+1));
+    }
+  }
+}
+
+/*!
+  Returns the summary of the data points with positions \a from (inclusive) to \a to (exclusive),
+  where the positions are counted from \a begin. The index must be up to date for this range, see
+  \ref update.
+*/
+template <class DataType>
+template <class Iterator>
+QCPDataSummary QCPDataPyramid<DataType>::summary(const Iterator &begin, int from, int to) const
+{
+  QCPDataSummary result;
+  if (from >= to)
+    return result;
+  const qint64 baseSize = qint64(1) << baseShift;
+  // block boundaries are aligned to positions counted from mOrigin data points before begin:
+  int i = mOrigin+from;
+  to += mOrigin;
+  while (i < to)
+  {
+    if ((i & (baseSize-1)) != 0 || i+baseSize > to || mLevels.isEmpty()) // not at a block boundary, or no full block left
+    {
+      result.expand(*(begin+(i-mOrigin)));
+      ++i;
+    } else // find the largest block that starts at i and fits into the remaining range
+    {
+      int level = 0;
+      while (level+1 < mLevels.size())
+      {
+        const qint64 blockSize = baseSize << (level+1);
+        if ((i & (blockSize-1)) != 0 || i+blockSize > to)
+          break;
+        ++level;
+      }
+      result.expand(mLevels.at(level).at(i >> (baseShift+level)));
+      i += baseSize << level;
+    }
+  }
+  result.first = (begin+from)->mainValue();
+  return result;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDataBlockStorage
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDataBlockStorage
+  \brief A storage backend for QCPDataContainer that keeps the data in fixed-size blocks
+  
+  By default, \ref QCPDataContainer stores its data points in a single QVector. When such a vector
+  grows, it is reallocated and all data points are copied, which for tens of millions of data
+  points means a noticeable hitch and a transient doubling of the memory. QCPDataBlockStorage
+  instead keeps the data points in blocks of \ref blockSize elements, referenced by a block table.
+  Appending and prepending only ever allocate a new block (and occasionally reallocate the small
+  block table), so growth never copies existing data points. Releasing unused memory at the front
+  or back frees whole blocks, again without copying.
+  
+  The storage provides random-access iterators (\ref QCPDataBlockIterator, unless the \ref
+  QCPDataBlockTraits of the data type say otherwise), so all algorithms of \ref QCPDataContainer
+  and the plottables based on \ref QCPAbstractPlottable1D work unchanged. Dereferencing an
+  iterator costs a block table lookup, which is slightly more than a pointer dereference.
+  
+  To use the block storage for a container, pass it as the second template parameter of \ref
+  QCPDataContainer, e.g. <tt>QCPDataContainer<QCPGraphData, QCPDataBlockStorage<QCPGraphData>
+  ></tt>. To make \ref QCPGraph use it, define \c QCUSTOMPLOT_USE_BLOCK_STORAGE when compiling
+  QCustomPlot and the application, which changes \ref QCPGraphDataContainer accordingly.
+  
+  The block structure also allows immutable snapshots of the data (\ref snapshot) that cost a copy
+  of the block table instead of the data points, see \ref QCPDataSnapshot.
+  
+  The memory of the blocks comes from a \ref QCPBlockAllocator, the one set with \ref
+  QCPBlockAllocator::setInstance when the storage is constructed. With a \ref
+  QCPHugePageAllocator, the blocks are packed into huge pages, which reduces page faults and TLB
+  misses for very large containers.
+*/
+
+/*! \class QCPDataBlockIterator
+  \brief The random-access iterator of QCPDataBlockStorage
+  
+  The iterator addresses a data point by its index into the block table of the storage. Like
+  QVector iterators, it is invalidated when the storage allocates new blocks.
+*/
+
+/*! \class QCPDataBlockTraits
+  \brief Describes how QCPDataBlockStorage keeps the data points in its blocks
+  
+  By default, a block is a plain array of \a blockSize data points, and the iterators of the
+  storage are \ref QCPDataBlockIterator "QCPDataBlockIterators" that return references into it.
+  
+  A specialization may keep the data points in the blocks as a different \a Element type, with a
+  header of \a headerSize bytes in front of the elements of every block. \a initializeHeader
+  prepares the header of a new block, and \a copyHeader copies it when a block is copied for
+  writing (see \ref QCPDataBlockStorage::detach). The iterators then have to convert between the
+  elements and the data points. This is done for \ref QCPGraphData if both \c
+  QCUSTOMPLOT_COMPACT_GRAPH_DATA and \c QCUSTOMPLOT_USE_BLOCK_STORAGE are defined, see \ref
+  QCPPackedGraphData.
+*/
+
+/*! \class QCPDataSnapshot
+  \brief An immutable view of the data in a QCPDataBlockStorage at one point in time
+  
+  A snapshot is obtained with \ref QCPDataContainer::snapshot (or \ref
+  QCPDataBlockStorage::snapshot) and shares the blocks of the storage instead of copying the data
+  points. It keeps seeing the data points it was taken with, no matter how the container is
+  modified afterwards, and it can be copied and read from any thread, while the thread that owns
+  the container keeps modifying it. This allows rendering, exporting or hit-testing the data in
+  another thread without locking the container, and without blocking appends.
+  
+  This works because the container never writes to a data point that a snapshot may read:
+  Appending writes behind the last data point of every snapshot, and prepending writes in front of
+  their first one. Everything else, e.g. inserting, removing or modifying data points through the
+  non-const iterators, first replaces the affected blocks with private copies (copy-on-write).
+  Blocks that are no longer used by the container are released only when all snapshots that were
+  taken before are destroyed (epoch-based reclamation, see \ref QCPDataBlockEpoch). A reader
+  therefore never waits for the writer, and the writer only ever copies the blocks it modifies.
+  
+  Taking snapshots is only supported for containers with \ref QCPDataBlockStorage, and must be done
+  by the thread that modifies the container.
+*/
+
+/*! \class QCPDataBlockEpoch
+  \brief Keeps the blocks of a QCPDataBlockStorage alive for the snapshots that may read them
+  
+  All snapshots taken between two block releases share one epoch. A block that the storage
+  releases while snapshots exist is retired to the current epoch instead of being deleted, and the
+  next snapshot starts a new epoch. Every epoch references the next one, so an epoch and the blocks
+  retired to it are only destroyed when all snapshots of it and of all older epochs are gone.
+*/
+
+/*!
+  Deletes the blocks that were retired to this epoch, and releases the newer epochs.
+  
+  Newer epochs that aren't referenced by anything else are unlinked and destroyed one after the
+  other. Letting the reference to the next epoch destroy it would recurse once per epoch, which
+  could overflow the stack for a long chain of epochs kept alive by an old snapshot.
+*/
+template <class DataType>
+QCPDataBlockEpoch<DataType>::~QCPDataBlockEpoch()
+{
+  typedef typename QCPDataBlockTraits<DataType>::Element Element;
+  for (int i=0; i<mRetiredBlocks.size(); ++i)
+  {
+    Element *block = mRetiredBlocks.at(i);
+    for (int k=0; k<QCPDataBlockStorage<DataType>::blockSize; ++k)
+      block[k].~Element();
+    mAllocator->deallocate(reinterpret_cast<char*>(block)-QCPDataBlockTraits<DataType>::headerSize, QCPDataBlockStorage<DataType>::blockBytes);
+  }
+  
+  QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > next;
+  next.swap(mNext);
+  while (next && next->ref.loadAcquire() == 1) // only referenced here, so no other thread can reach it anymore
+  {
+    QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > afterNext;
+    afterNext.swap(next->mNext);
+    next = afterNext; // destroys the epoch, which has no next epoch to release anymore
+  }
+}
+
+/*!
+  Constructs an empty block storage. Its blocks are allocated by the allocator that is current at
+  this point, see \ref QCPBlockAllocator::setInstance.
+*/
+template <class DataType>
+QCPDataBlockStorage<DataType>::QCPDataBlockStorage() :
+  mAllocator(QCPBlockAllocator::instance()),
+  mOffset(0),
+  mSize(0)
+{
+}
+
+/*!
+  Constructs a block storage with a deep copy of the data points in \a other.
+*/
+template <class DataType>
+QCPDataBlockStorage<DataType>::QCPDataBlockStorage(const QCPDataBlockStorage<DataType> &other) :
+  mAllocator(QCPBlockAllocator::instance()),
+  mOffset(0),
+  mSize(0)
+{
+  *this = other;
+}
+
+template <class DataType>
+QCPDataBlockStorage<DataType>::~QCPDataBlockStorage()
+{
+  clear();
+}
+
+/*!
+  Replaces the data points of this storage with a deep copy of the ones in \a other.
+*/
+template <class DataType>
+QCPDataBlockStorage<DataType> &QCPDataBlockStorage<DataType>::operator=(const QCPDataBlockStorage<DataType> &other)
+{
+  if (&other != this)
+  {
+    clear();
+    resize(other.size());
+    qcpStorageCopy(other.constBegin(), other.constEnd(), begin());
+  }
+  return *this;
+}
+
+/*! \overload
+
+  Replaces the data points of this storage with a copy of the ones in \a data.
+*/
+template <class DataType>
+QCPDataBlockStorage<DataType> &QCPDataBlockStorage<DataType>::operator=(const QVector<DataType> &data)
+{
+  clear();
+  resize(data.size());
+  qcpStorageCopy(data.constBegin(), data.constEnd(), begin());
+  return *this;
+}
+
+/*!
+  Changes the number of elements to \a size. Blocks are allocated as needed, but when shrinking,
+  blocks are only released by \ref squeeze. Like with QVector, elements that are added don't have
+  a meaningful value until they are assigned.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::resize(int size)
+{
+  if (size < mSize)
+    detach(size, mSize); // elements behind the end are written again when growing
+  const int requiredBlocks = (mOffset+size+blockSize-1) >> blockShift;
+  if (requiredBlocks > mBlocks.size())
+  {
+    mBlocks.reserve(qMax(requiredBlocks, mBlocks.size()*2));
+    while (mBlocks.size() < requiredBlocks)
+    {
+      mBlocks.append(allocateBlock());
+      mSharedBlocks.append(false);
+    }
+  }
+  mSize = size;
+}
+
+/*!
+  Appends \a data to the end of the storage.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::append(const DataType &data)
+{
+  const int index = mOffset+mSize;
+  if (index >= mBlocks.size()*blockSize)
+    resize(mSize+1);
+  else
+    ++mSize;
+  *iterator(mBlocks.constData(), index) = data;
+}
+
+/*!
+  Inserts \a data before the element \a before and returns an iterator to the inserted element.
+  The elements on the shorter side of the insertion point are moved.
+*/
+template <class DataType>
+typename QCPDataBlockStorage<DataType>::iterator QCPDataBlockStorage<DataType>::insert(iterator before, const DataType &data)
+{
+  const int pos = before-begin();
+  if (pos < mSize/2) // move the front part one element towards the front
+  {
+    growFront(1);
+    detach(0, pos+1);
+    qcpStorageCopy(begin()+1, begin()+1+pos, begin());
+  } else // move the back part one element towards the back
+  {
+    resize(mSize+1);
+    detach(pos, mSize);
+    qcpStorageCopyBackward(begin()+pos, end()-1, end());
+  }
+  *(begin()+pos) = data;
+  return begin()+pos;
+}
+
+/*!
+  Removes the elements from \a begin up to (but not including) \a end and returns an iterator to
+  the element that followed the removed range. The elements on the shorter side of the removed
+  range are moved.
+*/
+template <class DataType>
+typename QCPDataBlockStorage<DataType>::iterator QCPDataBlockStorage<DataType>::erase(iterator begin, iterator end)
+{
+  const int pos = begin-this->begin();
+  const int n = end-begin;
+  if (n <= 0)
+    return begin;
+  if (pos < mSize-pos-n) // move the front part towards the back
+  {
+    detach(0, pos+n);
+    qcpStorageCopyBackward(this->begin(), this->begin()+pos, this->begin()+pos+n);
+    shrinkFront(n);
+  } else // move the back part towards the front
+  {
+    detach(pos, mSize); // also covers the elements behind the new end, see resize
+    qcpStorageCopy(this->begin()+pos+n, this->end(), this->begin()+pos);
+    mSize -= n;
+  }
+  return this->begin()+pos;
+}
+
+/*!
+  Removes all elements and releases all blocks.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::clear()
+{
+  for (int i=0; i<mBlocks.size(); ++i)
+    releaseBlock(mBlocks.at(i));
+  mBlocks.clear();
+  mSharedBlocks.clear();
+  mOffset = 0;
+  mSize = 0;
+}
+
+/*!
+  Releases the blocks behind the last element that are no longer needed.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::squeeze()
+{
+  if (mSize == 0)
+  {
+    clear();
+    return;
+  }
+  const int requiredBlocks = (mOffset+mSize+blockSize-1) >> blockShift;
+  for (int i=requiredBlocks; i<mBlocks.size(); ++i)
+    releaseBlock(mBlocks.at(i));
+  mBlocks.resize(requiredBlocks);
+  mBlocks.squeeze();
+  mSharedBlocks.resize(requiredBlocks);
+}
+
+/*!
+  Inserts \a n elements at the front. The new elements don't have a meaningful value until they
+  are assigned. Existing elements are not moved, if the first block has no room left, new blocks
+  are put in front of it.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::growFront(int n)
+{
+  if (mOffset > 0 && n > 0 && !mBlocks.isEmpty()) // the unused elements in the first block may still be visible to snapshots
+    detach(-1, 0);
+  if (n > mOffset)
+  {
+    const int newBlocks = (n-mOffset+blockSize-1) >> blockShift;
+    mBlocks.insert(0, newBlocks, 0);
+    mSharedBlocks.insert(0, newBlocks, false);
+    for (int i=0; i<newBlocks; ++i)
+      mBlocks[i] = allocateBlock();
+    mOffset += newBlocks*blockSize;
+  }
+  mOffset -= n;
+  mSize += n;
+}
+
+/*!
+  Removes the first \a n elements. Blocks that no longer hold any element are released, the
+  remaining elements are not moved.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::shrinkFront(int n)
+{
+  n = qBound(0, n, mSize);
+  mOffset += n;
+  mSize -= n;
+  const int unusedBlocks = mOffset >> blockShift;
+  if (unusedBlocks > 0)
+  {
+    for (int i=0; i<unusedBlocks; ++i)
+      releaseBlock(mBlocks.at(i));
+    mBlocks.remove(0, unusedBlocks);
+    mSharedBlocks.remove(0, unusedBlocks);
+    mOffset -= unusedBlocks*blockSize;
+  }
+}
+
+/*!
+  Returns a snapshot of the elements from \a from up to the end, see \ref QCPDataSnapshot. The
+  snapshot shares the blocks of this storage, so this only copies the block table (if at all).
+  
+  From now on, elements that the snapshot may read are no longer written to. The blocks that are
+  written to are replaced by copies first, see \ref detach.
+*/
+template <class DataType>
+QCPDataSnapshot<DataType> QCPDataBlockStorage<DataType>::snapshot(int from)
+{
+  if (!mEpoch || !mEpoch->mRetiredBlocks.isEmpty()) // start a new epoch, so the retired blocks can be deleted before later snapshots are gone
+  {
+    QExplicitlySharedDataPointer<QCPDataBlockEpoch<DataType> > epoch(new QCPDataBlockEpoch<DataType>(mAllocator));
+    if (mEpoch)
+      mEpoch->mNext = epoch;
+    mEpoch = epoch;
+  }
+  mSharedBlocks.fill(true);
+  from = qBound(0, from, mSize);
+  return QCPDataSnapshot<DataType>(mBlocks, mOffset+from, mSize-from, mEpoch.data());
+}
+
+/*!
+  Prepares writing to the elements from \a from up to (but not including) \a to: All blocks that
+  hold elements of this range and may be read by a snapshot are replaced by private copies. The
+  range may extend into the unused elements at the front and the back of the blocks.
+  
+  The methods of this storage call this themselves as necessary. Code that writes to the elements
+  through the non-const iterators must call it before, \ref QCPDataContainer does this.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::detach(int from, int to)
+{
+  if (!mEpoch)
+    return;
+  if (!isShared()) // all snapshots are gone, nothing needs to be copied anymore
+  {
+    mEpoch.reset();
+    mSharedBlocks.fill(false);
+    return;
+  }
+  const int firstBlock = qMax(0, (mOffset+from) >> blockShift);
+  const int lastBlock = qMin(mBlocks.size()-1, (mOffset+to-1) >> blockShift);
+  for (int i=firstBlock; i<=lastBlock; ++i)
+  {
+    if (mSharedBlocks.at(i))
+    {
+      Element *block = allocateBlock();
+      QCPDataBlockTraits<DataType>::copyHeader(mBlocks.at(i), block);
+      std::copy(mBlocks.at(i), mBlocks.at(i)+blockSize, block);
+      releaseBlock(mBlocks.at(i));
+      mBlocks[i] = block;
+      mSharedBlocks[i] = false;
+    }
+  }
+}
+
+/*! \internal
+  
+  Returns a new block from the allocator of this storage, with default-constructed elements. The
+  elements follow the block header, if the \ref QCPDataBlockTraits of the data type have one.
+*/
+template <class DataType>
+typename QCPDataBlockStorage<DataType>::Element *QCPDataBlockStorage<DataType>::allocateBlock() const
+{
+  char *memory = static_cast<char*>(mAllocator->allocate(blockBytes));
+  Element *block = reinterpret_cast<Element*>(memory+QCPDataBlockTraits<DataType>::headerSize);
+  for (int i=0; i<blockSize; ++i)
+    new (block+i) Element;
+  QCPDataBlockTraits<DataType>::initializeHeader(block);
+  return block;
+}
+
+/*! \internal
+  
+  Deletes \a block, or retires it to the current epoch if snapshots may still read it.
+*/
+template <class DataType>
+void QCPDataBlockStorage<DataType>::releaseBlock(Element *block)
+{
+  if (isShared())
+    mEpoch->mRetiredBlocks.append(block);
+  else
+  {
+    for (int i=0; i<blockSize; ++i)
+      block[i].~Element();
+    mAllocator->deallocate(reinterpret_cast<char*>(block)-QCPDataBlockTraits<DataType>::headerSize, blockBytes);
+  }
+}
+
+/*!
+  Constructs an empty snapshot.
+*/
+template <class DataType>
+QCPDataSnapshot<DataType>::QCPDataSnapshot() :
+  mOffset(0),
+  mSize(0)
+{
+}
+
+/*!
+  Constructs a snapshot of the \a size elements starting at \a offset in the blocks \a blocks,
+  which are kept alive by \a epoch. Snapshots are usually obtained with \ref
+  QCPDataContainer::snapshot instead.
+*/
+template <class DataType>
+QCPDataSnapshot<DataType>::QCPDataSnapshot(const QVector<typename QCPDataBlockTraits<DataType>::Element*> &blocks, int offset, int size, QCPDataBlockEpoch<DataType> *epoch) :
+  mBlocks(blocks),
+  mOffset(offset),
+  mSize(size),
+  mEpoch(epoch)
+{
+}
+
+/*!
+  Returns an iterator to the data point with a (sort-)key that is equal to, just below, or just
+  above \a sortKey, like \ref QCPDataContainer::findBegin.
+*/
+template <class DataType>
+typename QCPDataSnapshot<DataType>::const_iterator QCPDataSnapshot<DataType>::findBegin(double sortKey, bool expandedRange) const
+{
+  if (isEmpty())
+    return constEnd();
+  
+  const_iterator it = std::lower_bound(constBegin(), constEnd(), sortKey, qcpSortKeyLessThan<DataType>);
+  if (expandedRange && it != constBegin())
+    --it;
+  return it;
+}
+
+/*!
+  Returns an iterator to the element after the data point with a (sort-)key that is equal to, just
+  above or just below \a sortKey, like \ref QCPDataContainer::findEnd.
+*/
+template <class DataType>
+typename QCPDataSnapshot<DataType>::const_iterator QCPDataSnapshot<DataType>::findEnd(double sortKey, bool expandedRange) const
+{
+  if (isEmpty())
+    return constEnd();
+  
+  const_iterator it = std::upper_bound(constBegin(), constEnd(), sortKey, qcpSortKeyBefore<DataType>);
+  if (expandedRange && it != constEnd())
+    ++it;
+  return it;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDataColumnIterator
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDataColumnIterator
+  \brief Iterates over separate key and value arrays as if they were an array of data points
+  
+  Dereferencing the iterator yields a \a DataType constructed from the current key and value, so
+  it works with data types that have a <tt>DataType(double key, double value)</tt> constructor,
+  like \ref QCPGraphData. It is meant to be passed to \ref QCPDataContainer::add(InputIterator
+  first, InputIterator last, bool alreadySorted), which then copies the data points directly from
+  the arrays into the container:
+  
+  \code
+  QCPDataColumnIterator<QCPGraphData> first(keys, values), last(keys+count, values+count);
+  container->add(first, last, true);
+  \endcode
+  
+  Since dereferencing returns a temporary instead of a reference, the iterator can only be read
+  from. \ref QCPGraph::addData(const double *keys, const double *values, int count, bool
+  alreadySorted) is implemented with it.
+*/
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPDataContainer
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPDataContainer
+  \brief The generic data container for one-dimensional plottables
+
+  This class template provides a fast container for data storage of one-dimensional data. The data
+  type is specified as template parameter (called \a DataType in the following) and must provide
+  some methods as described in the \ref qcpdatacontainer-datatype "next section".
+
+  The data is stored in a sorted fashion, which allows very quick lookups by the sorted key as well
+  as retrieval of ranges (see \ref findBegin, \ref findEnd, \ref keyRange) using binary search. The
+  container uses a preallocation and a postallocation scheme, such that appending and prepending
+  data (with respect to the sort key) is very fast and minimizes reallocations. If data is added
+  which needs to be inserted between existing keys, the merge usually can be done quickly too,
+  using the fact that existing data is always sorted. The user can further improve performance by
+  specifying that added data is already itself sorted by key, if he can guarantee that this is the
+  case (see for example \ref add(const QVector<DataType> &data, bool alreadySorted)).
+
+  For very large data sets, an optional pyramid index of the value extremes can be enabled with
+  \ref setPyramidIndex. It answers value range queries over arbitrary key ranges in O(log n) time.
+  
+  Streams where single data points occasionally arrive out of order can use a staging area for
+  those data points (\ref setStagingLimit), which is merged into the container in one pass instead
+  of inserting every data point individually.
+  
+  For live data that should only be kept for a while, the container can be limited to a number of
+  data points (\ref setSizeLimit) or a span of sort keys (\ref setKeySpanLimit). It then works like
+  a ring buffer: Whenever data is added, the data points with the smallest sort keys that exceed
+  the limit are dropped. This takes amortized constant time per data point and keeps the pyramid
+  index valid, so memory and replot time stay flat for arbitrarily long sessions. With the default
+  QVector storage, reclaiming the dropped data points occasionally moves the remaining ones, which
+  \ref QCPDataBlockStorage avoids.
+  
+  The data can be accessed with the provided const iterators (\ref constBegin, \ref constEnd). If
+  it is necessary to alter existing data in-place, the non-const iterators can be used (\ref begin,
+  \ref end). Changing data members that are not the sort key (for most data types called \a key) is
+  safe from the container's perspective.
+
+  Great care must be taken however if the sort key is modified through the non-const iterators. For
+  performance reasons, the iterators don't automatically cause a re-sorting upon their
+  manipulation. It is thus the responsibility of the user to leave the container in a sorted state
+  when finished with the data manipulation, before calling any other methods on the container. A
+  complete re-sort (e.g. after finishing all sort key manipulation) can be done by calling \ref
+  sort. Failing to do so can not be detected by the container efficiently and will cause both
+  rendering artifacts and potential data loss.
+
+  Implementing one-dimensional plottables that make use of a \ref QCPDataContainer<T> is usually
+  done by subclassing from \ref QCPAbstractPlottable1D "QCPAbstractPlottable1D<T>", which
+  introduces an according \a mDataContainer member and some convenience methods.
+
+  \section qcpdatacontainer-datatype Requirements for the DataType template parameter
+
+  The template parameter <tt>DataType</tt> is the type of the stored data points. It must be
+  trivially copyable and have the following public methods, preferably inline:
+
+  \li <tt>double sortKey() const</tt>\n Returns the member variable of this data point that is the
+  sort key, defining the ordering in the container. Often this variable is simply called \a key.
+
+  \li <tt>static DataType fromSortKey(double sortKey)</tt>\n Returns a new instance of the data
+  type initialized with its sort key set to \a sortKey.
+
+  \li <tt>static bool sortKeyIsMainKey()</tt>\n Returns true if the sort key is equal to the main
+  key (see method \c mainKey below). For most plottables this is the case. It is not the case for
+  example for \ref QCPCurve, which uses \a t as sort key and \a key as main key. This is the reason
+  why QCPCurve unlike QCPGraph can display parametric curves with loops.
+
+  \li <tt>double mainKey() const</tt>\n Returns the variable of this data point considered the main
+  key. This is commonly the variable that is used as the coordinate of this data point on the key
+  axis of the plottable. This method is used for example when determining the automatic axis
+  rescaling of key axes (\ref QCPAxis::rescale).
+
+  \li <tt>double mainValue() const</tt>\n Returns the variable of this data point considered the
+  main value. This is commonly the variable that is used as the coordinate of this data point on
+  the value axis of the plottable.
+
+  \li <tt>QCPRange valueRange() const</tt>\n Returns the range this data point spans in the value
+  axis coordinate. If the data is single-valued (e.g. QCPGraphData), this is simply a range with
+  both lower and upper set to the main data point value. However if the data points can represent
+  multiple values at once (e.g QCPFinancialData with its \a high, \a low, \a open and \a close
+  values at each \a key) this method should return the range those values span. This method is used
+  for example when determining the automatic axis rescaling of value axes (\ref
+  QCPAxis::rescale).
+*/
+
+/* start documentation of inline functions */
+
+/*! \fn int QCPDataContainer<DataType>::size() const
+  
+  Returns the number of data points in the container.
+*/
+
+/*! \fn bool QCPDataContainer<DataType>::isEmpty() const
+  
+  Returns whether this container holds no data points.
+*/
+
+/*! \fn quint64 QCPDataContainer<DataType>::editCount() const
+  
+  Returns how often the data points of this container were changed in a way other than appending
+  data points at the end or removing them from the front. This includes inserting or removing data
+  points anywhere else, replacing the data, and handing out non-const iterators (see \ref begin).
+  
+  Together with \ref removedFrontCount, this allows users of the data to tell whether data points
+  they processed earlier are still unchanged, e.g. to only process the data points that were
+  appended since. As long as the edit count stays the same, the data point that had index \a i is
+  unchanged and now has index <tt>i - (removedFrontCount() - oldRemovedFrontCount)</tt>, unless it
+  was removed.
+*/
+
+/*! \fn quint64 QCPDataContainer<DataType>::removedFrontCount() const
+  
+  Returns how many data points were removed from the front of this container, e.g. by \ref
+  removeBefore or due to the limits set with \ref setSizeLimit and \ref setKeySpanLimit. Data
+  points removed in any other way count as edits instead, see \ref editCount.
+*/
+
+/*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::constBegin() const
+  
+  Returns a const iterator to the first data point in this container.
+*/
+
+/*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::constEnd() const
+  
+  Returns a const iterator to the element past the last data point in this container.
+*/
+
+/*! \fn QCPDataContainer::iterator QCPDataContainer<DataType>::begin() const
+  
+  Returns a non-const iterator to the first data point in this container.
+
+  You can manipulate the data points in-place through the non-const iterators, but great care must
+  be taken when manipulating the sort key of a data point, see \ref sort, or the detailed
+  description of this class.
+  
+  Since the data may be modified through the returned iterator, calling this method invalidates
+  the pyramid index, see \ref setPyramidIndex. Blocks that are still read by snapshots are copied
+  first, see \ref snapshot.
 */
 
 /*! \fn QCPDataContainer::iterator QCPDataContainer<DataType>::end() const
@@ -2541,6 +4197,10 @@ protected:
   You can manipulate the data points in-place through the non-const iterators, but great care must
   be taken when manipulating the sort key of a data point, see \ref sort, or the detailed
   description of this class.
+  
+  Since the data may be modified through the returned iterator, calling this method invalidates
+  the pyramid index, see \ref setPyramidIndex. Blocks that are still read by snapshots are copied
+  first, see \ref snapshot.
 */
 
 /*! \fn QCPDataContainer::const_iterator QCPDataContainer<DataType>::at(int index) const
@@ -2565,11 +4225,17 @@ protected:
   Constructs a QCPDataContainer used for plottable classes that represent a series of key-sorted
   data
 */
-template <class DataType>
-QCPDataContainer<DataType>::QCPDataContainer() :
+template <class DataType, class StorageType>
+QCPDataContainer<DataType, StorageType>::QCPDataContainer() :
   mAutoSqueeze(true),
+  mPyramidIndex(false),
+  mSizeLimit(0),
+  mKeySpanLimit(0),
+  mStagingLimit(0),
   mPreallocSize(0),
-  mPreallocIteration(0)
+  mPreallocIteration(0),
+  mEditCount(0),
+  mRemovedFrontCount(0)
 {
 }
 
@@ -2581,8 +4247,8 @@ QCPDataContainer<DataType>::QCPDataContainer() :
   If auto squeeze is disabled, you can manually decide when to release pre-/postallocation with
   \ref squeeze.
 */
-template <class DataType>
-void QCPDataContainer<DataType>::setAutoSqueeze(bool enabled)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::setAutoSqueeze(bool enabled)
 {
   if (mAutoSqueeze != enabled)
   {
@@ -2592,14 +4258,97 @@ void QCPDataContainer<DataType>::setAutoSqueeze(bool enabled)
   }
 }
 
+/*!
+  Sets whether the container maintains a pyramid index of the value extremes of its data points
+  (see \ref QCPDataPyramid). By default this is disabled.
+  
+  With the index enabled, \ref summary and \ref valueRange (for the sign domain \ref QCP::sdBoth)
+  answer in O(log n) instead of O(n), and \ref QCPGraph uses it to perform adaptive sampling of
+  very dense data without visiting every data point. The index costs about one eighth of the memory
+  of the data itself. It is maintained incrementally while data is appended at the end of the
+  container, as is typical for live data, and while data is removed from the front with \ref
+  removeBefore or due to the limits set with \ref setSizeLimit and \ref setKeySpanLimit. Any other
+  modification (prepending, inserting, removing elsewhere, or access through the non-const
+  iterators \ref begin and \ref end) causes the index to be rebuilt on the next query.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::setPyramidIndex(bool enabled)
+{
+  mPyramidIndex = enabled;
+  if (!mPyramidIndex)
+    mPyramid.clear();
+}
+
+/*!
+  Limits the container to the \a limit data points with the largest sort keys. Whenever data is
+  added and the container would exceed the limit, the data points with the smallest sort keys are
+  removed, like in a ring buffer. Set \a limit to 0 to disable the limit, which is the default.
+  
+  If the container currently holds more than \a limit data points, the excess is removed
+  immediately.
+  
+  \see setKeySpanLimit
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::setSizeLimit(int limit)
+{
+  mergeStaging(); // staged data points are still subject to the old limits
+  mSizeLimit = qMax(0, limit);
+  applyLimits();
+}
+
+/*!
+  Limits the sort keys in the container to a span of \a span below the largest sort key. Whenever
+  data is added, the data points with sort keys smaller than the largest sort key minus \a span
+  are removed. For live data with timestamps as keys, this keeps the most recent time window. Set
+  \a span to 0 to disable the limit, which is the default.
+  
+  If the container currently holds data points outside the span, they are removed immediately.
+  
+  \see setSizeLimit
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::setKeySpanLimit(double span)
+{
+  mergeStaging(); // staged data points are still subject to the old limits
+  mKeySpanLimit = qMax(0.0, span);
+  applyLimits();
+}
+
+/*!
+  Sets the size of the staging area for out-of-order data points. By default, the limit is 0 and
+  the staging area is disabled.
+  
+  When a single data point is added with \ref add(const DataType &data) and it belongs neither to
+  the end nor to the beginning of the container, it has to be inserted in the middle, which moves
+  all following data points. For streams with occasional late data points, this makes every late
+  data point cost O(n). With a staging limit, such data points are collected in a small sorted
+  buffer instead. Once it holds \a limit data points, or as soon as the data is accessed in any
+  way, they are merged into the container in one pass. The data as seen through the container's
+  interface is always merged and sorted, and data points with equal sort keys end up in the same
+  order as without the staging area.
+  
+  Limits set with \ref setSizeLimit and \ref setKeySpanLimit are applied when the staged data points
+  are merged.
+  
+  A limit in the order of a few hundred to a few thousand data points is typical.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::setStagingLimit(int limit)
+{
+  mStagingLimit = qMax(0, limit);
+  if (mStaging.size() >= mStagingLimit)
+    mergeStaging();
+}
+
 /*! \overload
   
   Replaces the current data in this container with the provided \a data.
   
   \see add, remove
 */
-template <class DataType>
-void QCPDataContainer<DataType>::set(const QCPDataContainer<DataType> &data)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::set(const QCPDataContainer<DataType, StorageType> &data)
 {
   clear();
   add(data);
@@ -2614,14 +4363,23 @@ void QCPDataContainer<DataType>::set(const QCPDataContainer<DataType> &data)
   
   \see add, remove
 */
-template <class DataType>
-void QCPDataContainer<DataType>::set(const QVector<DataType> &data, bool alreadySorted)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::set(const QVector<DataType> &data, bool alreadySorted)
 {
-  mData = data;
+  if (alreadySorted)
+    mData = data;
+  else // sort while copying, see qcpStorageCopySorted
+  {
+    mData.clear();
+    mData.resize(data.size());
+    qcpStorageCopySorted<DataType>(data.constBegin(), data.constEnd(), mData.begin());
+  }
+  mStaging.clear();
   mPreallocSize = 0;
   mPreallocIteration = 0;
-  if (!alreadySorted)
-    sort();
+  mPyramid.invalidate();
+  ++mEditCount;
+  applyLimits();
 }
 
 /*! \overload
@@ -2630,28 +4388,10 @@ void QCPDataContainer<DataType>::set(const QVector<DataType> &data, bool already
   
   \see set, remove
 */
-template <class DataType>
-void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::add(const QCPDataContainer<DataType, StorageType> &data)
 {
-  if (data.isEmpty())
-    return;
-  
-  const int n = data.size();
-  const int oldSize = size();
-  
-  if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*constBegin(), *(data.constEnd()-1))) // prepend if new data keys are all smaller than or equal to existing ones
-  {
-    if (mPreallocSize < n)
-      preallocateGrow(n);
-    mPreallocSize -= n;
-    std::copy(data.constBegin(), data.constEnd(), begin());
-  } else // don't need to prepend, so append and merge if necessary
-  {
-    mData.resize(mData.size()+n);
-    std::copy(data.constBegin(), data.constEnd(), end()-n);
-    if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
-      std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
-  }
+  add(data.constBegin(), data.constEnd(), true);
 }
 
 /*!
@@ -2662,8 +4402,8 @@ void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data)
   
   \see set, remove
 */
-template <class DataType>
-void QCPDataContainer<DataType>::add(const QVector<DataType> &data, bool alreadySorted)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::add(const QVector<DataType> &data, bool alreadySorted)
 {
   if (data.isEmpty())
     return;
@@ -2672,65 +4412,166 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data, bool already
     set(data, alreadySorted);
     return;
   }
+  add(data.constBegin(), data.constEnd(), alreadySorted);
+}
+
+/*! \overload
+  
+  Adds the provided single data point to the current data.
+  
+  A data point whose sort key equals that of existing data points is placed after them, no matter
+  whether it is appended, inserted directly or buffered in the staging area (see \ref
+  setStagingLimit). So data points with equal sort keys keep the order in which they were added.
+  
+  \see remove
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::add(const DataType &data)
+{
+  // this method accesses mData directly, so data points in the staging area aren't merged prematurely
+  if (mData.size() == mPreallocSize || !qcpLessThanSortKey<DataType>(data, *(mData.constEnd()-1))) // quickly handle appends if new data key is greater or equal to existing ones
+  {
+    mData.append(data);
+  } else if (qcpLessThanSortKey<DataType>(data, *(mData.constBegin()+mPreallocSize)))  // quickly handle prepends using preallocated space
+  {
+    if (mPreallocSize < 1)
+      preallocateGrow(1);
+    --mPreallocSize;
+    qcpStorageDetach(mData, mPreallocSize, mPreallocSize+1);
+    *(mData.begin()+mPreallocSize) = data;
+    mPyramid.invalidate();
+    ++mEditCount;
+  } else if (mStagingLimit > 0) // buffer inserts in the sorted staging area, and merge them all at once later
+  {
+    mStaging.insert(std::upper_bound(mStaging.begin(), mStaging.end(), data, qcpLessThanSortKey<DataType>), data);
+    if (mStaging.size() < mStagingLimit)
+      return;
+    mergeStaging();
+  } else // handle inserts, maintaining sorted keys
+  {
+    const int insertionIndex = int(std::upper_bound(mData.constBegin()+mPreallocSize, mData.constEnd(), data, qcpLessThanSortKey<DataType>)-(mData.constBegin()+mPreallocSize));
+    mData.insert(mData.begin()+mPreallocSize+insertionIndex, data);
+    mPyramid.invalidateFrom(insertionIndex);
+    ++mEditCount;
+  }
+  applyLimits();
+}
+
+/*! \overload
+  
+  Adds the data points from \a first up to (but not including) \a last to the current data.
+  Dereferencing the iterators must yield a \a DataType (or something convertible to it), and they
+  must allow multiple passes over the range.
+  
+  The data points are copied directly into the free space at the end of the container (or at the
+  beginning, if they are sorted and precede the existing data), without any intermediate buffer.
+  This makes it the most efficient way to add data that isn't already in a QVector, e.g. from a
+  plain array, or from separate key and value arrays using \ref QCPDataColumnIterator.
   
-  const int n = data.size();
+  If you can guarantee that the data points have ascending order with respect to the DataType's
+  sort key, set \a alreadySorted to true to avoid an unnecessary sorting run.
+  
+  \see set, remove
+*/
+template <class DataType, class StorageType>
+template <class InputIterator>
+void QCPDataContainer<DataType, StorageType>::add(InputIterator first, InputIterator last, bool alreadySorted)
+{
+  const int n = int(std::distance(first, last));
+  if (n <= 0)
+    return;
+  mergeStaging(); // the code below accesses mData directly
   const int oldSize = size();
   
-  if (alreadySorted && oldSize > 0 && !qcpLessThanSortKey<DataType>(*constBegin(), *(data.constEnd()-1))) // prepend if new data is sorted and keys are all smaller than or equal to existing ones
+  InputIterator lastData = first;
+  std::advance(lastData, n-1);
+  if (alreadySorted && oldSize > 0 && qcpLessThanSortKey<DataType>(*lastData, *constBegin())) // prepend if new data is sorted and keys are all smaller than existing ones
   {
     if (mPreallocSize < n)
       preallocateGrow(n);
     mPreallocSize -= n;
-    std::copy(data.constBegin(), data.constEnd(), begin());
+    qcpStorageDetach(mData, mPreallocSize, mPreallocSize+n);
+    qcpStorageCopy(first, last, mData.begin()+mPreallocSize);
+    mPyramid.invalidate();
+    ++mEditCount;
   } else // don't need to prepend, so append and then sort and merge if necessary
   {
     mData.resize(mData.size()+n);
-    std::copy(data.constBegin(), data.constEnd(), end()-n);
-    if (!alreadySorted) // sort appended subrange if it wasn't already sorted
-      std::sort(end()-n, end(), qcpLessThanSortKey<DataType>);
+    if (alreadySorted)
+      qcpStorageCopy(first, last, mData.end()-n);
+    else // sort appended subrange if it wasn't already sorted
+      qcpStorageCopySorted<DataType>(first, last, mData.end()-n);
     if (oldSize > 0 && !qcpLessThanSortKey<DataType>(*(constEnd()-n-1), *(constEnd()-n))) // if appended range keys aren't all greater than existing ones, merge the two partitions
-      std::inplace_merge(begin(), end()-n, end(), qcpLessThanSortKey<DataType>);
+    {
+      // only the existing data points behind the first appended one take part in the merge:
+      const int mergeBegin = int(std::upper_bound(constBegin(), constEnd()-n, *(constEnd()-n), qcpLessThanSortKey<DataType>)-constBegin());
+      qcpStorageDetach(mData, mPreallocSize+mergeBegin, mData.size());
+      qcpMergeByKey<DataType>(mData.begin()+mPreallocSize+mergeBegin, mData.end()-n, mData.end());
+      mPyramid.invalidateFrom(mergeBegin);
+      ++mEditCount;
+    }
   }
+  applyLimits();
 }
 
+#ifdef Q_COMPILER_RVALUE_REFS
 /*! \overload
   
-  Adds the provided single data point to the current data.
+  Replaces the current data in this container with the provided \a data, taking over its memory
+  instead of copying it if the container stores its data in a QVector (see \ref
+  QCPDataStorageTraits). \a data is left empty.
   
-  \see remove
+  If you can guarantee that the data points in \a data have ascending order with respect to the
+  DataType's sort key, set \a alreadySorted to true to avoid an unnecessary sorting run.
+  
+  \see add, remove
 */
-template <class DataType>
-void QCPDataContainer<DataType>::add(const DataType &data)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::set(QVector<DataType> &&data, bool alreadySorted)
+{
+  if (!alreadySorted) // sort before the data points are taken over, see qcpStorageCopySorted
+    qcpSortByKey<DataType>(data.begin(), data.end());
+  mData = std::move(data);
+  data.clear();
+  mStaging.clear();
+  mPreallocSize = 0;
+  mPreallocIteration = 0;
+  mPyramid.invalidate();
+  ++mEditCount;
+  applyLimits();
+}
+
+/*! \overload
+  
+  Adds the provided data points in \a data to the current data. If the container is empty, this
+  takes over the memory of \a data like \ref set(QVector<DataType> &&data, bool alreadySorted).
+  
+  \see set, remove
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::add(QVector<DataType> &&data, bool alreadySorted)
 {
-  if (isEmpty() || !qcpLessThanSortKey<DataType>(data, *(constEnd()-1))) // quickly handle appends if new data key is greater or equal to existing ones
-  {
-    mData.append(data);
-  } else if (qcpLessThanSortKey<DataType>(data, *constBegin()))  // quickly handle prepends using preallocated space
-  {
-    if (mPreallocSize < 1)
-      preallocateGrow(1);
-    --mPreallocSize;
-    *begin() = data;
-  } else // handle inserts, maintaining sorted keys
+  if (data.isEmpty())
+    return;
+  if (isEmpty())
   {
-    QCPDataContainer<DataType>::iterator insertionPoint = std::lower_bound(begin(), end(), data, qcpLessThanSortKey<DataType>);
-    mData.insert(insertionPoint, data);
+    set(std::move(data), alreadySorted);
+    return;
   }
+  add(data.constBegin(), data.constEnd(), alreadySorted);
 }
+#endif
 
 /*!
   Removes all data points with (sort-)keys smaller than or equal to \a sortKey.
   
   \see removeAfter, remove, clear
 */
-template <class DataType>
-void QCPDataContainer<DataType>::removeBefore(double sortKey)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::removeBefore(double sortKey)
 {
-  QCPDataContainer<DataType>::iterator it = begin();
-  QCPDataContainer<DataType>::iterator itEnd = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
-  mPreallocSize += itEnd-it; // don't actually delete, just add it to the preallocated block (if it gets too large, squeeze will take care of it)
-  if (mAutoSqueeze)
-    performAutoSqueeze();
+  QCPDataContainer<DataType, StorageType>::const_iterator itEnd = std::lower_bound(constBegin(), constEnd(), sortKey, qcpSortKeyLessThan<DataType>);
+  removeFront(itEnd-constBegin());
 }
 
 /*!
@@ -2738,12 +4579,13 @@ void QCPDataContainer<DataType>::removeBefore(double sortKey)
 
   \see removeBefore, remove, clear
 */
-template <class DataType>
-void QCPDataContainer<DataType>::removeAfter(double sortKey)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::removeAfter(double sortKey)
 {
-  QCPDataContainer<DataType>::iterator it = std::upper_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
-  QCPDataContainer<DataType>::iterator itEnd = end();
-  mData.erase(it, itEnd); // typically adds it to the postallocated block
+  const int index = int(std::upper_bound(constBegin(), constEnd(), sortKey, qcpSortKeyBefore<DataType>)-constBegin());
+  mData.erase(mData.begin()+mPreallocSize+index, mData.end()); // typically adds it to the postallocated block
+  mPyramid.invalidateFrom(index);
+  ++mEditCount;
   if (mAutoSqueeze)
     performAutoSqueeze();
 }
@@ -2755,15 +4597,18 @@ void QCPDataContainer<DataType>::removeAfter(double sortKey)
   
   \see removeBefore, removeAfter, clear
 */
-template <class DataType>
-void QCPDataContainer<DataType>::remove(double sortKeyFrom, double sortKeyTo)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::remove(double sortKeyFrom, double sortKeyTo)
 {
   if (sortKeyFrom >= sortKeyTo || isEmpty())
     return;
   
-  QCPDataContainer<DataType>::iterator it = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKeyFrom), qcpLessThanSortKey<DataType>);
-  QCPDataContainer<DataType>::iterator itEnd = std::upper_bound(it, end(), DataType::fromSortKey(sortKeyTo), qcpLessThanSortKey<DataType>);
-  mData.erase(it, itEnd);
+  QCPDataContainer<DataType, StorageType>::const_iterator it = std::lower_bound(constBegin(), constEnd(), sortKeyFrom, qcpSortKeyLessThan<DataType>);
+  QCPDataContainer<DataType, StorageType>::const_iterator itEnd = std::upper_bound(it, constEnd(), sortKeyTo, qcpSortKeyBefore<DataType>);
+  const int index = int(it-constBegin());
+  mData.erase(mData.begin()+mPreallocSize+index, mData.begin()+mPreallocSize+int(itEnd-constBegin()));
+  mPyramid.invalidateFrom(index);
+  ++mEditCount;
   if (mAutoSqueeze)
     performAutoSqueeze();
 }
@@ -2777,17 +4622,68 @@ void QCPDataContainer<DataType>::remove(double sortKeyFrom, double sortKeyTo)
   
   \see removeBefore, removeAfter, clear
 */
-template <class DataType>
-void QCPDataContainer<DataType>::remove(double sortKey)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::remove(double sortKey)
 {
-  QCPDataContainer::iterator it = std::lower_bound(begin(), end(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
-  if (it != end() && it->sortKey() == sortKey)
+  QCPDataContainer::const_iterator it = std::lower_bound(constBegin(), constEnd(), sortKey, qcpSortKeyLessThan<DataType>);
+  if (it != constEnd() && it->sortKey() == sortKey)
   {
-    if (it == begin())
+    const int index = int(it-constBegin());
+    if (index == 0)
+    {
       ++mPreallocSize; // don't actually delete, just add it to the preallocated block (if it gets too large, squeeze will take care of it)
-    else
-      mData.erase(it);
+      mPyramid.removeFront(1);
+      ++mRemovedFrontCount;
+    } else
+    {
+      mData.erase(mData.begin()+mPreallocSize+index);
+      mPyramid.invalidateFrom(index);
+      ++mEditCount;
+    }
+  }
+  if (mAutoSqueeze)
+    performAutoSqueeze();
+}
+
+/*!
+  Replaces the data points with (sort-)keys from \a sortKeyFrom up to and including \a sortKeyTo
+  with the data points from \a first up to (but not including) \a last. Unlike with \ref
+  remove(double sortKeyFrom, double sortKeyTo), \a sortKeyFrom may equal \a sortKeyTo.
+  
+  The new data points must be sorted, and lie between the data points in front of and behind the
+  replaced ones, so the container stays sorted without merging. Only the data points on the
+  shorter side of the replaced ones are moved, and the pyramid index (see \ref setPyramidIndex) is
+  only rebuilt from the replaced data points on. This makes it cheap to exchange a small part of a
+  large container, e.g. to show some key range in more or less detail.
+  
+  \see add, remove
+*/
+template <class DataType, class StorageType>
+template <class InputIterator>
+void QCPDataContainer<DataType, StorageType>::replace(double sortKeyFrom, double sortKeyTo, InputIterator first, InputIterator last)
+{
+  mergeStaging(); // the code below accesses mData directly
+  const int n = int(std::distance(first, last));
+  const int index = int(std::lower_bound(constBegin(), constEnd(), sortKeyFrom, qcpSortKeyLessThan<DataType>)-constBegin());
+  const int replaced = int(std::upper_bound(constBegin()+index, constEnd(), sortKeyTo, qcpSortKeyBefore<DataType>)-constBegin())-index;
+  if (n == 0 && replaced == 0)
+    return;
+  
+  if (n < replaced)
+  {
+    mData.erase(mData.begin()+mPreallocSize+index+n, mData.begin()+mPreallocSize+index+replaced);
+  } else if (n > replaced) // make room by moving the data points behind the replaced ones towards the back
+  {
+    const int oldDataSize = mData.size();
+    mData.resize(oldDataSize+n-replaced);
+    qcpStorageDetach(mData, mPreallocSize+index+replaced, mData.size());
+    qcpStorageCopyBackward(mData.begin()+mPreallocSize+index+replaced, mData.begin()+oldDataSize, mData.end());
   }
+  qcpStorageDetach(mData, mPreallocSize+index, mPreallocSize+index+n);
+  qcpStorageCopy(first, last, mData.begin()+mPreallocSize+index);
+  mPyramid.invalidateFrom(index);
+  ++mEditCount;
+  applyLimits();
   if (mAutoSqueeze)
     performAutoSqueeze();
 }
@@ -2797,12 +4693,15 @@ void QCPDataContainer<DataType>::remove(double sortKey)
   
   \see remove, removeAfter, removeBefore
 */
-template <class DataType>
-void QCPDataContainer<DataType>::clear()
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::clear()
 {
   mData.clear();
+  mStaging.clear();
   mPreallocIteration = 0;
   mPreallocSize = 0;
+  mPyramid.clear();
+  ++mEditCount;
 }
 
 /*!
@@ -2816,10 +4715,10 @@ void QCPDataContainer<DataType>::clear()
   are called on it. This can be achieved by calling this method immediately after finishing the
   sort key manipulation.
 */
-template <class DataType>
-void QCPDataContainer<DataType>::sort()
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::sort()
 {
-  std::sort(begin(), end(), qcpLessThanSortKey<DataType>);
+  qcpSortByKey<DataType>(begin(), end());
 }
 
 /*!
@@ -2832,15 +4731,14 @@ void QCPDataContainer<DataType>::sort()
   The parameters \a preAllocation and \a postAllocation control whether pre- and/or post allocation
   should be freed, respectively.
 */
-template <class DataType>
-void QCPDataContainer<DataType>::squeeze(bool preAllocation, bool postAllocation)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::squeeze(bool preAllocation, bool postAllocation)
 {
   if (preAllocation)
   {
     if (mPreallocSize > 0)
     {
-      std::copy(begin(), end(), mData.begin());
-      mData.resize(size());
+      qcpStorageShrinkFront(mData, mPreallocSize);
       mPreallocSize = 0;
     }
     mPreallocIteration = 0;
@@ -2849,6 +4747,35 @@ void QCPDataContainer<DataType>::squeeze(bool preAllocation, bool postAllocation
     mData.squeeze();
 }
 
+/*!
+  Frees the memory held by the pyramid index (see \ref setPyramidIndex). The index stays enabled
+  and is rebuilt completely on the next query that needs it.
+  
+  The index can always be rebuilt from the data, so this is a cheap way to give memory back when
+  it is needed elsewhere, e.g. for containers that aren't currently plotted.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::releasePyramidIndex()
+{
+  mPyramid.clear();
+}
+
+/*!
+  Merges the data points that were added since the last query and, if it is enabled, brings the
+  pyramid index up to date (see \ref setPyramidIndex). Until the container is modified again, its
+  const methods then only read it, so several threads may query it at the same time.
+  
+  \ref QCustomPlot::replot calls this for the data of all plottables before it draws layers
+  concurrently (see \ref QCP::phParallelLayers).
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::prepareForReading() const
+{
+  const int dataSize = size(); // merges the staged data points
+  if (mPyramidIndex && dataSize > 0)
+    mPyramid.update(constBegin(), dataSize);
+}
+
 /*!
   Returns an iterator to the data point with a (sort-)key that is equal to, just below, or just
   above \a sortKey. If \a expandedRange is true, the data point just below \a sortKey will be
@@ -2861,16 +4788,20 @@ void QCPDataContainer<DataType>::squeeze(bool preAllocation, bool postAllocation
   returned.
 
   If the container is empty, returns \ref constEnd.
+  
+  The search starts where the previous call of this method ended up, and widens exponentially from
+  there before it falls back to a binary search. Consecutive lookups of nearby sort keys, like
+  those of a cursor following the mouse, thus take O(1) time, and far jumps O(log n).
 
   \see findEnd, QCPPlottableInterface1D::findBegin
 */
-template <class DataType>
-typename QCPDataContainer<DataType>::const_iterator QCPDataContainer<DataType>::findBegin(double sortKey, bool expandedRange) const
+template <class DataType, class StorageType>
+typename QCPDataContainer<DataType, StorageType>::const_iterator QCPDataContainer<DataType, StorageType>::findBegin(double sortKey, bool expandedRange) const
 {
   if (isEmpty())
     return constEnd();
   
-  QCPDataContainer<DataType>::const_iterator it = std::lower_bound(constBegin(), constEnd(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
+  QCPDataContainer<DataType, StorageType>::const_iterator it = constBegin()+fingerSearch(sortKey, false, mFindBeginFinger);
   if (expandedRange && it != constBegin()) // also covers it == constEnd case, and we know --constEnd is valid because mData isn't empty
     --it;
   return it;
@@ -2888,16 +4819,18 @@ typename QCPDataContainer<DataType>::const_iterator QCPDataContainer<DataType>::
   returned.
 
   If the container is empty, \ref constEnd is returned.
+  
+  Like \ref findBegin, this starts searching where its previous call ended up.
 
   \see findBegin, QCPPlottableInterface1D::findEnd
 */
-template <class DataType>
-typename QCPDataContainer<DataType>::const_iterator QCPDataContainer<DataType>::findEnd(double sortKey, bool expandedRange) const
+template <class DataType, class StorageType>
+typename QCPDataContainer<DataType, StorageType>::const_iterator QCPDataContainer<DataType, StorageType>::findEnd(double sortKey, bool expandedRange) const
 {
   if (isEmpty())
     return constEnd();
   
-  QCPDataContainer<DataType>::const_iterator it = std::upper_bound(constBegin(), constEnd(), DataType::fromSortKey(sortKey), qcpLessThanSortKey<DataType>);
+  QCPDataContainer<DataType, StorageType>::const_iterator it = constBegin()+fingerSearch(sortKey, true, mFindEndFinger);
   if (expandedRange && it != constEnd())
     ++it;
   return it;
@@ -2918,8 +4851,8 @@ typename QCPDataContainer<DataType>::const_iterator QCPDataContainer<DataType>::
   
   \see valueRange
 */
-template <class DataType>
-QCPRange QCPDataContainer<DataType>::keyRange(bool &foundRange, QCP::SignDomain signDomain)
+template <class DataType, class StorageType>
+QCPRange QCPDataContainer<DataType, StorageType>::keyRange(bool &foundRange, QCP::SignDomain signDomain)
 {
   if (isEmpty())
   {
@@ -2931,8 +4864,8 @@ QCPRange QCPDataContainer<DataType>::keyRange(bool &foundRange, QCP::SignDomain
   bool haveUpper = false;
   double current;
   
-  QCPDataContainer<DataType>::const_iterator it = constBegin();
-  QCPDataContainer<DataType>::const_iterator itEnd = constEnd();
+  QCPDataContainer<DataType, StorageType>::const_iterator it = constBegin();
+  QCPDataContainer<DataType, StorageType>::const_iterator itEnd = constEnd();
   if (signDomain == QCP::sdBoth) // range may be anywhere
   {
     if (DataType::sortKeyIsMainKey()) // if DataType is sorted by main key (e.g. QCPGraph, but not QCPCurve), use faster algorithm by finding just first and last key with non-NaN value
@@ -3039,10 +4972,13 @@ QCPRange QCPDataContainer<DataType>::keyRange(bool &foundRange, QCP::SignDomain
   relevant e.g. for logarithmic plots which can mathematically only display one sign domain at a
   time.
 
+  If the pyramid index is enabled (see \ref setPyramidIndex) and \a signDomain is \ref
+  QCP::sdBoth, the range is found in O(log n) time via \ref summary.
+  
   \see keyRange
 */
-template <class DataType>
-QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomain signDomain, const QCPRange &inKeyRange)
+template <class DataType, class StorageType>
+QCPRange QCPDataContainer<DataType, StorageType>::valueRange(bool &foundRange, QCP::SignDomain signDomain, const QCPRange &inKeyRange)
 {
   if (isEmpty())
   {
@@ -3054,8 +4990,25 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   bool haveLower = false;
   bool haveUpper = false;
   QCPRange current;
-  QCPDataContainer<DataType>::const_iterator itBegin = constBegin();
-  QCPDataContainer<DataType>::const_iterator itEnd = constEnd();
+  QCPDataContainer<DataType, StorageType>::const_iterator itBegin = constBegin();
+  QCPDataContainer<DataType, StorageType>::const_iterator itEnd = constEnd();
+  if (mPyramidIndex && signDomain == QCP::sdBoth && (DataType::sortKeyIsMainKey() || !restrictKeyRange)) // use the pyramid index, data points are already limited to inKeyRange exactly
+  {
+    if (restrictKeyRange)
+    {
+      itBegin = findBegin(inKeyRange.lower, false);
+      itEnd = findEnd(inKeyRange.upper, false);
+    }
+    const QCPDataSummary dataSummary = summary(itBegin, itEnd);
+    haveLower = !qIsNaN(dataSummary.minimum);
+    haveUpper = !qIsNaN(dataSummary.maximum);
+    if (haveLower)
+      range.lower = dataSummary.minimum;
+    if (haveUpper)
+      range.upper = dataSummary.maximum;
+    foundRange = haveLower && haveUpper;
+    return range;
+  }
   if (DataType::sortKeyIsMainKey() && restrictKeyRange)
   {
     itBegin = findBegin(inKeyRange.lower);
@@ -3063,7 +5016,7 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   }
   if (signDomain == QCP::sdBoth) // range may be anywhere
   {
-    for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
+    for (QCPDataContainer<DataType, StorageType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
       if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
@@ -3081,7 +5034,7 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
     }
   } else if (signDomain == QCP::sdNegative) // range may only be in the negative sign domain
   {
-    for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
+    for (QCPDataContainer<DataType, StorageType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
       if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
@@ -3099,7 +5052,7 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
     }
   } else if (signDomain == QCP::sdPositive) // range may only be in the positive sign domain
   {
-    for (QCPDataContainer<DataType>::const_iterator it = itBegin; it != itEnd; ++it)
+    for (QCPDataContainer<DataType, StorageType>::const_iterator it = itBegin; it != itEnd; ++it)
     {
       if (restrictKeyRange && (it->mainKey() < inKeyRange.lower || it->mainKey() > inKeyRange.upper))
         continue;
@@ -3121,6 +5074,67 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   return range;
 }
 
+/*!
+  Returns the \ref QCPDataSummary of the data points from \a begin up to (but not including) \a
+  end, i.e. the extremes of their value ranges and the main values of the first and last data
+  point.
+  
+  If the pyramid index is enabled (see \ref setPyramidIndex), the summary is assembled from the
+  index in O(log n) time. Otherwise all data points in the range are visited.
+  
+  \see valueRange
+*/
+template <class DataType, class StorageType>
+QCPDataSummary QCPDataContainer<DataType, StorageType>::summary(const const_iterator &begin, const const_iterator &end) const
+{
+  if (begin >= end)
+    return QCPDataSummary();
+  if (mPyramidIndex)
+  {
+    mPyramid.update(constBegin(), size());
+    return mPyramid.summary(constBegin(), begin-constBegin(), end-constBegin());
+  }
+  QCPDataSummary result;
+  for (const_iterator it=begin; it!=end; ++it)
+    result.expand(*it);
+  result.first = begin->mainValue();
+  return result;
+}
+
+/*!
+  Returns an immutable snapshot of the current data, see \ref QCPDataSnapshot. The snapshot can be
+  handed to another thread, e.g. for rendering or exporting, while this container keeps being
+  modified by the thread that owns it, without any locking in between.
+  
+  Taking a snapshot doesn't copy the data points, and modifying the container afterwards only
+  copies the blocks that the modification writes to and that the snapshot still reads. Appending
+  and prepending data points and the limits (\ref setSizeLimit, \ref setKeySpanLimit) never cause
+  copies.
+  
+  This is only available if the container uses \ref QCPDataBlockStorage, and must be called from
+  the thread that modifies the container.
+*/
+template <class DataType, class StorageType>
+QCPDataSnapshot<DataType> QCPDataContainer<DataType, StorageType>::snapshot()
+{
+  mergeStaging();
+  return mData.snapshot(mPreallocSize);
+}
+
+/*!
+  Returns the number of bytes the container currently allocates for its data points, including
+  the preallocated space in front (see \ref squeeze), the staging area (see \ref
+  setStagingLimit) and the pyramid index (see \ref setPyramidIndex).
+  
+  This is meant for applications that keep track of how much memory their data takes up, e.g. to
+  limit it. The memory of the container object itself isn't included.
+*/
+template <class DataType, class StorageType>
+qint64 QCPDataContainer<DataType, StorageType>::memoryUsage() const
+{
+  return qcpStorageMemoryUsage(mData)+qint64(mStaging.capacity())*sizeof(DataType)+mPyramid.memoryUsage();
+}
+
 /*!
   Makes sure \a begin and \a end mark a data range that is both within the bounds of this data
   container's data, as well as within the specified \a dataRange.
@@ -3128,8 +5142,8 @@ QCPRange QCPDataContainer<DataType>::valueRange(bool &foundRange, QCP::SignDomai
   This function doesn't require for \a dataRange to be within the bounds of this data container's
   valid range.
 */
-template <class DataType>
-void QCPDataContainer<DataType>::limitIteratorsToDataRange(const_iterator &begin, const_iterator &end, const QCPDataRange &dataRange) const
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::limitIteratorsToDataRange(const_iterator &begin, const_iterator &end, const QCPDataRange &dataRange) const
 {
   QCPDataRange iteratorRange(begin-constBegin(), end-constBegin());
   iteratorRange = iteratorRange.bounded(dataRange.bounded(this->dataRange()));
@@ -3146,8 +5160,8 @@ void QCPDataContainer<DataType>::limitIteratorsToDataRange(const_iterator &begin
   if \a minimumPreallocSize is smaller than or equal to the current preallocation pool size, this
   method does nothing.
 */
-template <class DataType>
-void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::preallocateGrow(int minimumPreallocSize)
 {
   if (minimumPreallocSize <= mPreallocSize)
     return;
@@ -3157,8 +5171,7 @@ void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
   ++mPreallocIteration;
   
   int sizeDifference = newPreallocSize-mPreallocSize;
-  mData.resize(mData.size()+sizeDifference);
-  std::copy_backward(mData.begin()+mPreallocSize, mData.end()-sizeDifference, mData.end());
+  qcpStorageGrowFront(mData, mPreallocSize, sizeDifference);
   mPreallocSize = newPreallocSize;
 }
 
@@ -3176,8 +5189,8 @@ void QCPDataContainer<DataType>::preallocateGrow(int minimumPreallocSize)
   preallocateGrow. The hysteresis between allocation and deallocation should be made high enough
   (at the expense of possibly larger unused memory from time to time).
 */
-template <class DataType>
-void QCPDataContainer<DataType>::performAutoSqueeze()
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::performAutoSqueeze()
 {
   const int totalAlloc = mData.capacity();
   const int postAllocSize = totalAlloc-mData.size();
@@ -3197,6 +5210,155 @@ void QCPDataContainer<DataType>::performAutoSqueeze()
   if (shrinkPreAllocation || shrinkPostAllocation)
     squeeze(shrinkPreAllocation, shrinkPostAllocation);
 }
+
+/*! \internal
+  
+  Returns the index of the first data point whose sort key is not less than \a sortKey, or if \a
+  upperBound is true, of the first one whose sort key is greater than \a sortKey (like
+  std::lower_bound and std::upper_bound).
+  
+  The search starts at the index stored in \a finger, which is the result of the previous search,
+  and probes 1, 2, 4,... up to \ref maxFingerStep data points away from it. If that brackets the
+  result, only the bracket is searched with a binary search. Otherwise, the whole container is
+  searched as usual: the upper levels of a plain binary search probe the same data points every
+  time and stay in the CPU cache, which makes it faster than widening the search further for
+  faraway results. The result is stored in \a finger for the next search.
+  
+  The finger is only a hint: when data was modified since, the search is still correct, just
+  possibly slower. Separate fingers are used for \ref findBegin and \ref findEnd, because they
+  usually look up the two ends of the visible key range. The fingers are atomic, so const access
+  from several threads stays well-defined.
+*/
+template <class DataType, class StorageType>
+int QCPDataContainer<DataType, StorageType>::fingerSearch(double sortKey, bool upperBound, QAtomicInt &finger) const
+{
+  const const_iterator begin = constBegin();
+  const int n = size();
+  const int hint = qBound(0, int(finger.load()), n);
+  int lower = 0, upper = n; // the result is in [lower, upper]
+  if (hint < n && !qcpAtOrAfterBound(*(begin+hint), sortKey, upperBound))
+  {
+    for (int step=1; step <= maxFingerStep && hint+step < n; step *= 2)
+    {
+      if (qcpAtOrAfterBound(*(begin+(hint+step)), sortKey, upperBound))
+      {
+        lower = hint+step/2+1;
+        upper = hint+step;
+        break;
+      }
+    }
+  } else
+  {
+    for (int step=1; step <= maxFingerStep && hint-step >= 0; step *= 2)
+    {
+      if (!qcpAtOrAfterBound(*(begin+(hint-step)), sortKey, upperBound))
+      {
+        lower = hint-step+1;
+        upper = hint-step/2;
+        break;
+      }
+    }
+  }
+  const_iterator it;
+  if (upperBound)
+    it = std::upper_bound(begin+lower, begin+upper, sortKey, qcpSortKeyBefore<DataType>);
+  else
+    it = std::lower_bound(begin+lower, begin+upper, sortKey, qcpSortKeyLessThan<DataType>);
+  const int result = it-begin;
+  finger.store(result);
+  return result;
+}
+
+/*! \internal
+  
+  Removes the first \a count data points. They aren't actually deleted but added to the
+  preallocated block (if it gets too large, squeeze will take care of it), and the pyramid index is
+  informed instead of invalidated.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::removeFront(int count)
+{
+  mPreallocSize += count;
+  mPyramid.removeFront(count);
+  mRemovedFrontCount += count;
+  if (mAutoSqueeze)
+    performAutoSqueeze();
+}
+
+/*! \internal
+  
+  Removes the data points with the smallest sort keys that exceed the limits set with \ref
+  setSizeLimit and \ref setKeySpanLimit.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::applyLimits()
+{
+  if (!mStaging.isEmpty()) // with data points in the staging area, the limits are applied once they are merged
+    return;
+  const int excess = limitExcess();
+  if (excess > 0)
+    removeFront(excess);
+}
+
+/*! \internal
+  
+  Returns how many data points at the beginning of the container exceed the limits set with \ref
+  setSizeLimit and \ref setKeySpanLimit.
+*/
+template <class DataType, class StorageType>
+int QCPDataContainer<DataType, StorageType>::limitExcess() const
+{
+  if (isEmpty())
+    return 0;
+  int excess = 0;
+  if (mSizeLimit > 0)
+    excess = size()-mSizeLimit;
+  if (mKeySpanLimit > 0)
+  {
+    const double lowestSortKey = (constEnd()-1)->sortKey()-mKeySpanLimit;
+    if (constBegin()->sortKey() < lowestSortKey) // only search if the first data point is outside the span
+      excess = qMax(excess, int(std::lower_bound(constBegin(), constEnd(), lowestSortKey, qcpSortKeyLessThan<DataType>)-constBegin()));
+  }
+  return excess;
+}
+
+/*! \internal
+  
+  Merges the data points of the staging area (see \ref setStagingLimit) into the main data. The
+  staged data points are appended and merged with the part of the main data they interleave with,
+  so the cost is proportional to how far back the earliest staged data point goes, not to the size
+  of the container. The pyramid index is only invalidated from there on. Afterwards, the data points
+  exceeding the limits (see \ref setSizeLimit) are removed.
+  
+  This is called by all accessors before they hand out iterators, so iteration always sees the
+  merged data. Hence this method is const, and the involved members are mutable. Auto squeezing is
+  left to the next modifying method.
+*/
+template <class DataType, class StorageType>
+void QCPDataContainer<DataType, StorageType>::mergeStaging() const
+{
+  if (mStaging.isEmpty())
+    return;
+  const int n = mStaging.size();
+  const typename StorageType::const_iterator mainBegin = mData.constBegin()+mPreallocSize;
+  const int mergeBegin = int(std::upper_bound(mainBegin, mData.constEnd(), mStaging.first(), qcpLessThanSortKey<DataType>)-mainBegin);
+  if (mergeBegin < mData.size()-mPreallocSize) // staged data points that all follow the existing ones are just appended
+    ++mEditCount;
+  mData.resize(mData.size()+n);
+  qcpStorageCopy(mStaging.constBegin(), mStaging.constEnd(), mData.end()-n);
+  qcpStorageDetach(mData, mPreallocSize+mergeBegin, mData.size()-n);
+  qcpMergeByKey<DataType>(mData.begin()+mPreallocSize+mergeBegin, mData.end()-n, mData.end());
+  mStaging.clear();
+  mPyramid.invalidateFrom(mergeBegin);
+  
+  const int excess = limitExcess();
+  if (excess > 0)
+  {
+    mPreallocSize += excess;
+    mPyramid.removeFront(excess);
+    mRemovedFrontCount += excess;
+  }
+}
 /* end of 'src/datacontainer.cpp' */
 
 
@@ -3343,6 +5505,8 @@ protected:
   
   // introduced virtual methods:
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const = 0;
+  virtual void prepareDataForReading() const;
+  virtual const void *dataObject() const;
   
   // non-virtual methods:
   void applyFillAntialiasingHint(QCPPainter *painter) const;
@@ -3695,6 +5859,7 @@ public:
   bool saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality=-1, int resolution=96, QCP::ResolutionUnit resolutionUnit=QCP::ruDotsPerInch);
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
+  qint64 paintBufferMemoryUsage() const;
   Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpRefreshHint);
   
   QCPAxis *xAxis, *yAxis, *xAxis2, *yAxis2;
@@ -3793,6 +5958,7 @@ protected:
   void drawBackground(QCPPainter *painter);
   void setupPaintBuffers();
   QCPAbstractPaintBuffer *createPaintBuffer();
+  void drawLayersParallel();
   bool hasInvalidatedPaintBuffers();
   bool setupOpenGl();
   void freeOpenGl();
@@ -3859,9 +6025,17 @@ protected:
   // property members:
   QSharedPointer<QCPDataContainer<DataType> > mDataContainer;
   
+  // reimplemented virtual methods:
+  virtual void prepareDataForReading() const Q_DECL_OVERRIDE;
+  virtual const void *dataObject() const Q_DECL_OVERRIDE;
+  
   // helpers for subclasses:
   void getDataSegments(QList<QCPDataRange> &selectedSegments, QList<QCPDataRange> &unselectedSegments) const;
   void drawPolyline(QCPPainter *painter, const QVector<QPointF> &lineData) const;
+  template <class InputIterator>
+  void dataToPixels(InputIterator begin, InputIterator end, double *keyPixels, double *valuePixels) const;
+  template <class InputIterator>
+  void dataToPixels(InputIterator begin, InputIterator end, QPointF *pixels) const;
 
 private:
   Q_DISABLE_COPY(QCPAbstractPlottable1D)
@@ -4299,6 +6473,20 @@ double QCPAbstractPlottable1D<DataType>::selectTest(const QPointF &pos, bool onl
   return qSqrt(minDistSqr);
 }
 
+/* inherits documentation from base class */
+template <class DataType>
+void QCPAbstractPlottable1D<DataType>::prepareDataForReading() const
+{
+  mDataContainer->prepareForReading();
+}
+
+/* inherits documentation from base class */
+template <class DataType>
+const void *QCPAbstractPlottable1D<DataType>::dataObject() const
+{
+  return mDataContainer.data();
+}
+
 /*!
   Splits all data into selected and unselected segments and outputs them via \a selectedSegments
   and \a unselectedSegments, respectively.
@@ -4312,14 +6500,18 @@ double QCPAbstractPlottable1D<DataType>::selectTest(const QPointF &pos, bool onl
 template <class DataType>
 void QCPAbstractPlottable1D<DataType>::getDataSegments(QList<QCPDataRange> &selectedSegments, QList<QCPDataRange> &unselectedSegments) const
 {
-  selectedSegments.clear();
-  unselectedSegments.clear();
-  if (mSelectable == QCP::stWhole) // stWhole selection type draws the entire plottable with selected style if mSelection isn't empty
+  if (mSelectable == QCP::stWhole || mSelection.isEmpty()) // stWhole selection type draws the entire plottable with selected style if mSelection isn't empty
   {
-    if (selected())
-      selectedSegments << QCPDataRange(0, dataCount());
+    // a single segment, set in place so lists that are passed in again for every replot don't reallocate:
+    QList<QCPDataRange> &wholeSegments = selected() ? selectedSegments : unselectedSegments;
+    (selected() ? unselectedSegments : selectedSegments).clear();
+    if (wholeSegments.size() == 1)
+      wholeSegments[0] = QCPDataRange(0, dataCount());
     else
-      unselectedSegments << QCPDataRange(0, dataCount());
+    {
+      wholeSegments.clear();
+      wholeSegments << QCPDataRange(0, dataCount());
+    }
   } else
   {
     QCPDataSelection sel(selection());
@@ -4329,6 +6521,67 @@ void QCPAbstractPlottable1D<DataType>::getDataSegments(QList<QCPDataRange> &sele
   }
 }
 
+/*!
+  A helper method which transforms the data points from \a begin to \a end to pixel coordinates,
+  writing the pixel positions of their keys to \a keyPixels and of their values to \a valuePixels.
+  Both arrays must have room for all data points. The data type must have \a key and \a value
+  members.
+  
+  The data points are transformed with \ref QCPAxis::coordsToPixels, so this is considerably faster
+  than calling \ref coordsToPixels for every data point, with the same result.
+*/
+template <class DataType>
+template <class InputIterator>
+void QCPAbstractPlottable1D<DataType>::dataToPixels(InputIterator begin, InputIterator end, double *keyPixels, double *valuePixels) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return; }
+  
+  int count = 0;
+  for (InputIterator it=begin; it!=end; ++it, ++count)
+  {
+    keyPixels[count] = it->key;
+    valuePixels[count] = it->value;
+  }
+  keyAxis->coordsToPixels(keyPixels, keyPixels, count);
+  valueAxis->coordsToPixels(valuePixels, valuePixels, count);
+}
+
+/*! \overload
+  
+  Writes the pixel positions of the data points from \a begin to \a end to \a pixels, with x and y
+  depending on the orientation of the key axis, like \ref coordsToPixels. \a pixels must have room
+  for all data points.
+*/
+template <class DataType>
+template <class InputIterator>
+void QCPAbstractPlottable1D<DataType>::dataToPixels(InputIterator begin, InputIterator end, QPointF *pixels) const
+{
+  QCPAxis *keyAxis = mKeyAxis.data();
+  if (!keyAxis) { qDebug() << Q_FUNC_INFO << "invalid key axis"; return; }
+  
+  const bool keyIsVertical = keyAxis->orientation() == Qt::Vertical;
+  const int blockSize = 256;
+  double keyPixels[blockSize], valuePixels[blockSize];
+  InputIterator it = begin;
+  while (it != end)
+  {
+    InputIterator blockEnd = it;
+    int count = 0;
+    while (blockEnd != end && count < blockSize)
+    {
+      ++blockEnd;
+      ++count;
+    }
+    dataToPixels(it, blockEnd, keyPixels, valuePixels);
+    for (int i=0; i<count; ++i)
+      pixels[i] = keyIsVertical ? QPointF(valuePixels[i], keyPixels[i]) : QPointF(keyPixels[i], valuePixels[i]);
+    pixels += count;
+    it = blockEnd;
+  }
+}
+
 /*!
   A helper method which draws a line with the passed \a painter, according to the pixel data in \a
   lineData. NaN points create gaps in the line, as expected from QCustomPlot's plottables (this is
@@ -5085,6 +7338,54 @@ private:
 /* including file 'src/plottables/plottable-graph.h', size 8826              */
 /* commit 633339dadc92cb10c58ef3556b55570685fafb99 2016-09-13 23:54:56 +0200 */
 
+#ifdef QCUSTOMPLOT_COMPACT_GRAPH_DATA
+#ifndef QCUSTOMPLOT_COMPACT_KEY_TICKS
+#  define QCUSTOMPLOT_COMPACT_KEY_TICKS 1e9
+#endif
+class QCP_LIB_DECL QCPCompactKey
+{
+public:
+  QCPCompactKey() : mLow(0), mHigh(0) {}
+  explicit QCPCompactKey(double key) { setKey(key); }
+
+  // getters:
+  qint64 ticks() const { return qint64((quint64(quint32(mHigh)) << 32) | mLow); }
+  double key() const { return mHigh == nanHigh ? qQNaN() : ticks()*resolution(); }
+  operator double() const { return key(); }
+
+  // setters:
+  void setKey(double key);
+  QCPCompactKey &operator=(double key) { setKey(key); return *this; }
+
+  // static methods:
+  static double resolution() { return 1.0/(QCUSTOMPLOT_COMPACT_KEY_TICKS); }
+
+  static const qint32 nanHigh = -2147483647-1;
+
+protected:
+  quint32 mLow;
+  qint32 mHigh;
+};
+Q_DECLARE_TYPEINFO(QCPCompactKey, Q_PRIMITIVE_TYPE);
+
+inline void QCPCompactKey::setKey(double key)
+{
+  const double maxTicks = 9223372032559808512.0; // 2^63-2^32, keeps nanHigh free for NaN
+  const double ticks = key*(QCUSTOMPLOT_COMPACT_KEY_TICKS);
+  qint64 result;
+  if (qIsNaN(ticks))
+    result = qint64(quint64(quint32(nanHigh)) << 32);
+  else if (ticks >= maxTicks)
+    result = qint64(maxTicks);
+  else if (ticks <= -maxTicks)
+    result = -qint64(maxTicks);
+  else
+    result = qRound64(ticks);
+  mLow = quint32(quint64(result));
+  mHigh = qint32(quint64(result) >> 32);
+}
+#endif
+
 class QCP_LIB_DECL QCPGraphData
 {
 public:
@@ -5100,10 +7401,275 @@ public:
   
   inline QCPRange valueRange() const { return QCPRange(value, value); }
   
+#if defined(QCP_PACKED_GRAPH_DATA)
+  double key;
+  float value;
+#elif defined(QCUSTOMPLOT_COMPACT_GRAPH_DATA)
+  QCPCompactKey key;
+  float value;
+#else
   double key, value;
+#endif
 };
 Q_DECLARE_TYPEINFO(QCPGraphData, Q_PRIMITIVE_TYPE);
 
+#ifdef QCP_PACKED_GRAPH_DATA
+class QCPPackedGraphDataReference;
+
+class QCP_LIB_DECL QCPPackedGraphData
+{
+public:
+  struct Header
+  {
+    double base;
+    double range;
+  };
+  
+  QCPPackedGraphData() : key(0), value(0) {}
+  
+  float key;
+  float value;
+  
+  // static methods:
+  static Header *header(QCPPackedGraphData *block) { return reinterpret_cast<Header*>(block)-1; }
+  static const Header *header(const QCPPackedGraphData *block) { return reinterpret_cast<const Header*>(block)-1; }
+  static QCPGraphData at(const QCPPackedGraphData *block, int slot) { return QCPGraphData(header(block)->base+block[slot].key, block[slot].value); }
+  static QCPPackedGraphDataReference at(QCPPackedGraphData *block, int slot);
+  static void write(QCPPackedGraphData *block, int slot, const QCPGraphData &data);
+  static void writeRange(QCPPackedGraphData *block, int slot, const QCPGraphData *data, int count);
+  static float keyOffset(double base, double key);
+  static float keyOffsetBound(double base, double key);
+  
+protected:
+  static void store(QCPPackedGraphData *block, int slot, const QCPGraphData &data);
+  static void setBase(QCPPackedGraphData *block, double key, int from);
+  static void extendRange(QCPPackedGraphData *block, double key);
+  static void fitRange(Header *blockHeader, double distance);
+  static void encodeAgain(QCPPackedGraphData *block, const Header &oldHeader, int from);
+  static qint64 lastOffset(double base, double key, bool strict);
+  static bool offsetMatches(double base, double key, bool strict, qint64 ordered) { return strict ? base+fromOrdered(ordered) < key : base+fromOrdered(ordered) <= key; }
+  static qint32 toOrdered(float offset);
+  static float fromOrdered(qint64 ordered);
+};
+Q_DECLARE_TYPEINFO(QCPPackedGraphData, Q_PRIMITIVE_TYPE);
+
+class QCPPackedGraphDataReference
+{
+public:
+  QCPPackedGraphDataReference(QCPPackedGraphData *block, int slot) : mBlock(block), mSlot(slot) {}
+  
+  operator QCPGraphData() const { return QCPPackedGraphData::at(static_cast<const QCPPackedGraphData*>(mBlock), mSlot); }
+  QCPPackedGraphDataReference &operator=(const QCPGraphData &data) { QCPPackedGraphData::write(mBlock, mSlot, data); return *this; }
+  QCPPackedGraphDataReference &operator=(const QCPPackedGraphDataReference &other) { return operator=(QCPGraphData(other)); }
+  friend void swap(QCPPackedGraphDataReference a, QCPPackedGraphDataReference b) { QCPGraphData data(a); a = QCPGraphData(b); b = data; }
+  
+protected:
+  QCPPackedGraphData *mBlock;
+  int mSlot;
+};
+
+class QCPPackedGraphDataPointer
+{
+public:
+  explicit QCPPackedGraphDataPointer(const QCPGraphData &data) : mData(data) {}
+  
+  const QCPGraphData *operator->() const { return &mData; }
+  
+protected:
+  QCPGraphData mData;
+};
+
+template <class Reference, class Element, int BlockShift>
+class QCPPackedGraphDataIterator
+{
+public:
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef QCPGraphData value_type;
+  typedef int difference_type;
+  typedef QCPPackedGraphDataPointer pointer;
+  typedef Reference reference;
+  
+  QCPPackedGraphDataIterator() : mBlocks(0), mIndex(0) {}
+  QCPPackedGraphDataIterator(Element *const *blocks, int index) : mBlocks(blocks), mIndex(index) {}
+  QCPPackedGraphDataIterator(const QCPPackedGraphDataIterator<QCPPackedGraphDataReference, QCPPackedGraphData, BlockShift> &other) : mBlocks(other.blocks()), mIndex(other.index()) {}
+  
+  // getters:
+  Element *const *blocks() const { return mBlocks; }
+  int index() const { return mIndex; }
+  Element *block() const { return mBlocks[mIndex >> BlockShift]; }
+  int slot() const { return mIndex & ((1 << BlockShift)-1); }
+  
+  // non-virtual methods:
+  Reference operator*() const { return QCPPackedGraphData::at(block(), slot()); }
+  QCPPackedGraphDataPointer operator->() const { return QCPPackedGraphDataPointer(QCPPackedGraphData::at(static_cast<const QCPPackedGraphData*>(block()), slot())); }
+  Reference operator[](int n) const { return *(*this+n); }
+  QCPPackedGraphDataIterator &operator++() { ++mIndex; return *this; }
+  QCPPackedGraphDataIterator &operator--() { --mIndex; return *this; }
+  QCPPackedGraphDataIterator operator++(int) { QCPPackedGraphDataIterator result(*this); ++mIndex; return result; }
+  QCPPackedGraphDataIterator operator--(int) { QCPPackedGraphDataIterator result(*this); --mIndex; return result; }
+  QCPPackedGraphDataIterator &operator+=(int n) { mIndex += n; return *this; }
+  QCPPackedGraphDataIterator &operator-=(int n) { mIndex -= n; return *this; }
+  QCPPackedGraphDataIterator operator+(int n) const { return QCPPackedGraphDataIterator(mBlocks, mIndex+n); }
+  QCPPackedGraphDataIterator operator-(int n) const { return QCPPackedGraphDataIterator(mBlocks, mIndex-n); }
+  friend QCPPackedGraphDataIterator operator+(int n, const QCPPackedGraphDataIterator &it) { return it+n; }
+  template <class R, class E> int operator-(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex-other.index(); }
+  template <class R, class E> bool operator==(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex == other.index(); }
+  template <class R, class E> bool operator!=(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex != other.index(); }
+  template <class R, class E> bool operator<(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex < other.index(); }
+  template <class R, class E> bool operator>(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex > other.index(); }
+  template <class R, class E> bool operator<=(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex <= other.index(); }
+  template <class R, class E> bool operator>=(const QCPPackedGraphDataIterator<R, E, BlockShift> &other) const { return mIndex >= other.index(); }
+  
+protected:
+  Element *const *mBlocks;
+  int mIndex;
+};
+
+inline QCPPackedGraphDataReference QCPPackedGraphData::at(QCPPackedGraphData *block, int slot)
+{
+  return QCPPackedGraphDataReference(block, slot);
+}
+
+inline void QCPPackedGraphData::write(QCPPackedGraphData *block, int slot, const QCPGraphData &data)
+{
+  if (slot == 0) // a new first data point moves the base, see writeRange
+    writeRange(block, slot, &data, 1);
+  else
+    store(block, slot, data);
+}
+
+inline void QCPPackedGraphData::store(QCPPackedGraphData *block, int slot, const QCPGraphData &data)
+{
+  Header *blockHeader = header(block);
+  if (qIsFinite(data.key) && !(qAbs(data.key-blockHeader->base) < blockHeader->range)) // no base yet, or the key is out of its range
+    extendRange(block, data.key);
+  block[slot].key = keyOffset(blockHeader->base, data.key);
+  block[slot].value = data.value;
+}
+
+template <>
+class QCPDataBlockTraits<QCPGraphData>
+{
+public:
+  typedef QCPPackedGraphData Element;
+  static const int blockShift = 12;
+  static const int headerSize = int(sizeof(QCPPackedGraphData::Header));
+  typedef QCPPackedGraphDataIterator<QCPGraphData, const QCPPackedGraphData, blockShift> const_iterator;
+  typedef QCPPackedGraphDataIterator<QCPPackedGraphDataReference, QCPPackedGraphData, blockShift> iterator;
+  
+  static void initializeHeader(Element *block) { QCPPackedGraphData::header(block)->base = 0; QCPPackedGraphData::header(block)->range = 0; }
+  static void copyHeader(const Element *from, Element *to) { *QCPPackedGraphData::header(to) = *QCPPackedGraphData::header(from); }
+};
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Data points in packed blocks can't be processed through a pointer to QCPGraphData, so this
+  returns the number of elements that follow \a it in its block. Use \ref
+  QCPPackedGraphDataIterator::block and \ref QCPPackedGraphDataIterator::slot to access them.
+*/
+template <class Reference, class Element, int BlockShift>
+inline int qcpContiguousCount(const QCPPackedGraphDataIterator<Reference, Element, BlockShift> &it, const QCPPackedGraphDataIterator<Reference, Element, BlockShift> &end)
+{
+  return qMin(int(end-it), (1 << BlockShift)-it.slot());
+}
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Collects the data points of every destination block in a buffer and writes them with \ref
+  QCPPackedGraphData::writeRange, so a block that is written from its first slot gets the first
+  written key as its base.
+*/
+template <class ForwardIterator>
+QCPDataBlockTraits<QCPGraphData>::iterator qcpStorageCopy(ForwardIterator first, ForwardIterator last, QCPDataBlockTraits<QCPGraphData>::iterator result)
+{
+  const int blockSize = 1 << QCPDataBlockTraits<QCPGraphData>::blockShift;
+  int n = int(std::distance(first, last));
+  QVector<QCPGraphData> buffer(qMin(n, blockSize));
+  QCPGraphData *data = buffer.data();
+  while (n > 0)
+  {
+    const int count = qMin(n, blockSize-result.slot());
+    for (int i=0; i<count; ++i, ++first)
+      data[i] = *first;
+    QCPPackedGraphData::writeRange(result.block(), result.slot(), data, count);
+    result += count;
+    n -= count;
+  }
+  return result;
+}
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Like \ref qcpStorageCopy, but starting with the last destination block. The source range of a
+  block is read completely before the block is written, so the ranges may overlap.
+*/
+template <class BidirectionalIterator>
+QCPDataBlockTraits<QCPGraphData>::iterator qcpStorageCopyBackward(BidirectionalIterator first, BidirectionalIterator last, QCPDataBlockTraits<QCPGraphData>::iterator resultEnd)
+{
+  const int blockSize = 1 << QCPDataBlockTraits<QCPGraphData>::blockShift;
+  int n = int(std::distance(first, last));
+  QVector<QCPGraphData> buffer(qMin(n, blockSize));
+  QCPGraphData *data = buffer.data();
+  while (n > 0)
+  {
+    const int count = qMin(n, (resultEnd-1).slot()+1);
+    for (int i=count-1; i>=0; --i)
+      data[i] = *--last;
+    resultEnd -= count;
+    QCPPackedGraphData::writeRange(resultEnd.block(), resultEnd.slot(), data, count);
+    n -= count;
+  }
+  return resultEnd;
+}
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Sorts a copy of the data points and writes them back, so the blocks get their bases from the
+  sorted keys.
+*/
+template <class DataType>
+void qcpSortByKey(QCPDataBlockTraits<QCPGraphData>::iterator first, QCPDataBlockTraits<QCPGraphData>::iterator last)
+{
+  QVector<QCPGraphData> buffer(last-first);
+  std::copy(first, last, buffer.begin());
+  qcpSortByKey<QCPGraphData>(buffer.begin(), buffer.end());
+  qcpStorageCopy(buffer.constBegin(), buffer.constEnd(), first);
+}
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Merges a copy of the data points and writes it back, see \ref qcpSortByKey.
+*/
+template <class DataType>
+void qcpMergeByKey(QCPDataBlockTraits<QCPGraphData>::iterator first, QCPDataBlockTraits<QCPGraphData>::iterator middle, QCPDataBlockTraits<QCPGraphData>::iterator last)
+{
+  QVector<QCPGraphData> buffer(last-first);
+  std::copy(first, last, buffer.begin());
+  std::inplace_merge(buffer.begin(), buffer.begin()+(middle-first), buffer.end(), qcpLessThanSortKey<QCPGraphData>);
+  qcpStorageCopy(buffer.constBegin(), buffer.constEnd(), first);
+}
+
+/*! \internal \relates QCPPackedGraphData
+  \overload
+  
+  Sorts the data points before they are written, so they are encoded only once and the blocks get
+  their bases from the sorted keys.
+*/
+template <class DataType, class ForwardIterator>
+void qcpStorageCopySorted(ForwardIterator first, ForwardIterator last, QCPDataBlockTraits<QCPGraphData>::iterator result)
+{
+  QVector<QCPGraphData> buffer(int(std::distance(first, last)));
+  std::copy(first, last, buffer.begin());
+  qcpSortByKey<QCPGraphData>(buffer.begin(), buffer.end());
+  qcpStorageCopy(buffer.constBegin(), buffer.constEnd(), result);
+}
+#endif
+
 
 /*! \typedef QCPGraphDataContainer
   
@@ -5112,8 +7678,19 @@ Q_DECLARE_TYPEINFO(QCPGraphData, Q_PRIMITIVE_TYPE);
   This template instantiation is the container in which QCPGraph holds its data. For details about
   the generic container, see the documentation of the class template \ref QCPDataContainer.
   
+  If \c QCUSTOMPLOT_USE_BLOCK_STORAGE is defined, the container stores the data points in a \ref
+  QCPDataBlockStorage instead of a single QVector.
+  
   \see QCPGraphData, QCPGraph::setData
 */
+#ifdef QCUSTOMPLOT_USE_BLOCK_STORAGE
+template <>
+class QCPDataStorageTraits<QCPGraphData>
+{
+public:
+  typedef QCPDataBlockStorage<QCPGraphData> StorageType;
+};
+#endif
 typedef QCPDataContainer<QCPGraphData> QCPGraphDataContainer;
 
 class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData>
@@ -5123,8 +7700,11 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData>
   Q_PROPERTY(LineStyle lineStyle READ lineStyle WRITE setLineStyle)
   Q_PROPERTY(QCPScatterStyle scatterStyle READ scatterStyle WRITE setScatterStyle)
   Q_PROPERTY(int scatterSkip READ scatterSkip WRITE setScatterSkip)
+  Q_PROPERTY(bool scatterDeduplication READ scatterDeduplication WRITE setScatterDeduplication)
+  Q_PROPERTY(double scatterDeduplicationCellSize READ scatterDeduplicationCellSize WRITE setScatterDeduplicationCellSize)
   Q_PROPERTY(QCPGraph* channelFillGraph READ channelFillGraph WRITE setChannelFillGraph)
   Q_PROPERTY(bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
+  Q_PROPERTY(SamplingStrategy samplingStrategy READ samplingStrategy WRITE setSamplingStrategy)
   /// \endcond
 public:
   /*!
@@ -5142,6 +7722,17 @@ public:
                  };
   Q_ENUMS(LineStyle)
   
+  /*!
+    Defines how the data points of the graph's line are reduced when adaptive sampling applies (see
+    \ref setAdaptiveSampling).
+    \see setSamplingStrategy
+  */
+  enum SamplingStrategy { ssAdaptive ///< per pixel, the value extremes are placed at fixed fractions of the pixel (the default, fastest for live data)
+                          ,ssM4      ///< per pixel column, the first, last, minimum and maximum data point are kept, so the line is drawn exactly like the full data
+                          ,ssLttb    ///< about one data point per pixel is picked with the largest-triangle-three-buckets algorithm, for visually smooth lines
+                        };
+  Q_ENUMS(SamplingStrategy)
+  
   explicit QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
   virtual ~QCPGraph();
   
@@ -5150,8 +7741,11 @@ public:
   LineStyle lineStyle() const { return mLineStyle; }
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   int scatterSkip() const { return mScatterSkip; }
+  bool scatterDeduplication() const { return mScatterDeduplication; }
+  double scatterDeduplicationCellSize() const { return mScatterDeduplicationCellSize; }
   QCPGraph *channelFillGraph() const { return mChannelFillGraph.data(); }
   bool adaptiveSampling() const { return mAdaptiveSampling; }
+  SamplingStrategy samplingStrategy() const { return mSamplingStrategy; }
   
   // setters:
   void setData(QSharedPointer<QCPGraphDataContainer> data);
@@ -5159,12 +7753,17 @@ public:
   void setLineStyle(LineStyle ls);
   void setScatterStyle(const QCPScatterStyle &style);
   void setScatterSkip(int skip);
+  void setScatterDeduplication(bool enabled);
+  void setScatterDeduplicationCellSize(double pixels);
   void setChannelFillGraph(QCPGraph *targetGraph);
   void setAdaptiveSampling(bool enabled);
+  void setSamplingStrategy(SamplingStrategy strategy);
   
   // non-property methods:
   void addData(const QVector<double> &keys, const QVector<double> &values, bool alreadySorted=false);
+  void addData(const double *keys, const double *values, int count, bool alreadySorted=false);
   void addData(double key, double value);
+  double valueAtKey(double key, bool &found) const;
   
   // reimplemented virtual methods:
   virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const Q_DECL_OVERRIDE;
@@ -5172,12 +7771,55 @@ public:
   virtual QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange()) const Q_DECL_OVERRIDE;
   
 protected:
+  struct LineCache
+  {
+    bool valid;
+    // what the lines were made from:
+    QCPGraphDataContainer *container;
+    quint64 editCount;
+    qint64 begin, end; // data point indices plus the container's removedFrontCount, which stay the same when data points are removed from the front
+    QCPAxis *keyAxis, *valueAxis;
+    QCPRange keyRange, valueRange;
+    QRect keyAxisRect, valueAxisRect;
+    QCPAxis::ScaleType keyScaleType, valueScaleType;
+    bool keyRangeReversed, valueRangeReversed;
+    LineStyle lineStyle;
+    bool adaptiveSampling, sampled;
+    SamplingStrategy samplingStrategy;
+    // where sampling continues when data points are appended (resume is -1 if it can't):
+    qint64 resume;
+    int resumeSize;
+    // the sampled data points and the resulting lines in pixel coordinates:
+    QVector<QCPGraphData> data;
+    QVector<QPointF> lines;
+  };
+  
   // property members:
   LineStyle mLineStyle;
   QCPScatterStyle mScatterStyle;
   int mScatterSkip;
+  bool mScatterDeduplication;
+  double mScatterDeduplicationCellSize;
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
+  SamplingStrategy mSamplingStrategy;
+  
+  // non-property members:
+  mutable QVector<QCPGraphData> mWorkingData;
+  mutable QVector<double> mWorkingPixels;
+  mutable QVector<double> mSamplingPixels;
+  mutable QVector<quint64> mScatterOccupancy;
+  mutable QVector<QPair<int, int> > mWorkingIntervals;
+  mutable QVector<QPointF> mLines, mScatters, mChannelFillLines;
+  mutable QVector<double> mChannelFillEnvelope;
+  mutable QPolygonF mChannelFillPolygon;
+  QList<QCPDataRange> mSelectedSegments, mUnselectedSegments;
+  mutable LineCache mLineCache;
+  mutable QVector<QCPGraphDataContainer::const_iterator> mSamplingBounds;
+  mutable QVector<QCPGraphSamplingChunk*> mSamplingChunks; // kept between replots by getOptimizedLineDataParallel, so their buffers are reused
+  mutable QVector<QPair<int, int> > mSamplingIntervals;
+  mutable QSemaphore mSamplingDone;
+  static const int parallelSamplingChunkSize = 1 << 17; // minimum number of data points per chunk of getOptimizedLineDataParallel
   
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
@@ -5196,16 +7838,28 @@ protected:
   void getVisibleDataBounds(QCPGraphDataContainer::const_iterator &begin, QCPGraphDataContainer::const_iterator &end, const QCPDataRange &rangeRestriction) const;
   void getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange) const;
   void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange) const;
+  void getDeduplicatedScatters(QVector<QPointF> *scatters, QCPGraphDataContainer::const_iterator begin, const QCPGraphDataContainer::const_iterator &end) const;
+  void clipLinesToValueRange(const QVector<QPointF> &lines, QVector<QPointF> *clippedLines) const;
+  void trimWorkingData() const;
+  void updateLineCache(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const;
+  bool extendLineCache(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, qint64 removedFrontCount) const;
+  bool isLineDataSampled(const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const;
+  void getOptimizedLineDataChunk(QVector<QCPGraphData> *lineData, QVector<QPair<int, int> > *intervals, QCPGraphDataContainer::const_iterator &it, const QCPGraphDataContainer::const_iterator &chunkEnd, const QCPGraphDataContainer::const_iterator &end, double lastIntervalEndKey, double keyEpsilon) const;
+  void getOptimizedLineDataParallel(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end, int chunkCount, double keyEpsilon, QPair<int, int> *lastInterval) const;
+  void getM4LineData(QVector<QCPGraphData> *lineData, QVector<QPair<int, int> > *intervals, QCPGraphDataContainer::const_iterator it, const QCPGraphDataContainer::const_iterator &end) const;
+  void getLttbLineData(QVector<QCPGraphData> *lineData, const QCPGraphDataContainer::const_iterator &begin, const QCPGraphDataContainer::const_iterator &end) const;
   QVector<QPointF> dataToLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToStepLeftLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToStepRightLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToStepCenterLines(const QVector<QCPGraphData> &data) const;
   QVector<QPointF> dataToImpulseLines(const QVector<QCPGraphData> &data) const;
+  void dataToStyledLines(const QVector<QCPGraphData> &data, LineStyle style, QVector<QPointF> *lines) const;
   void addFillBasePoints(QVector<QPointF> *lines) const;
   void removeFillBasePoints(QVector<QPointF> *lines) const;
   QPointF lowerFillBasePoint(double lowerKey) const;
   QPointF upperFillBasePoint(double upperKey) const;
   const QPolygonF getChannelFillPolygon(const QVector<QPointF> *lines) const;
+  const QPolygonF getChannelFillEnvelope(const QVector<QPointF> *lines, const QVector<QPointF> *otherLines) const;
   int findIndexBelowX(const QVector<QPointF> *data, double x) const;
   int findIndexAboveX(const QVector<QPointF> *data, double x) const;
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
@@ -5214,8 +7868,10 @@ protected:
   
   friend class QCustomPlot;
   friend class QCPLegend;
+  friend class QCPGraphSamplingChunk;
 };
 Q_DECLARE_METATYPE(QCPGraph::LineStyle)
+Q_DECLARE_METATYPE(QCPGraph::SamplingStrategy)
 
 /* end of 'src/plottables/plottable-graph.h' */
 
@@ -5262,6 +7918,8 @@ class QCP_LIB_DECL QCPCurve : public QCPAbstractPlottable1D<QCPCurveData>
   Q_PROPERTY(QCPScatterStyle scatterStyle READ scatterStyle WRITE setScatterStyle)
   Q_PROPERTY(int scatterSkip READ scatterSkip WRITE setScatterSkip)
   Q_PROPERTY(LineStyle lineStyle READ lineStyle WRITE setLineStyle)
+  Q_PROPERTY(bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
+  Q_PROPERTY(double samplingTolerance READ samplingTolerance WRITE setSamplingTolerance)
   /// \endcond
 public:
   /*!
@@ -5282,6 +7940,8 @@ public:
   QCPScatterStyle scatterStyle() const { return mScatterStyle; }
   int scatterSkip() const { return mScatterSkip; }
   LineStyle lineStyle() const { return mLineStyle; }
+  bool adaptiveSampling() const { return mAdaptiveSampling; }
+  double samplingTolerance() const { return mSamplingTolerance; }
   
   // setters:
   void setData(QSharedPointer<QCPCurveDataContainer> data);
@@ -5290,6 +7950,8 @@ public:
   void setScatterStyle(const QCPScatterStyle &style);
   void setScatterSkip(int skip);
   void setLineStyle(LineStyle style);
+  void setAdaptiveSampling(bool enabled);
+  void setSamplingTolerance(double pixels);
   
   // non-property methods:
   void addData(const QVector<double> &t, const QVector<double> &keys, const QVector<double> &values, bool alreadySorted=false);
@@ -5307,6 +7969,8 @@ protected:
   QCPScatterStyle mScatterStyle;
   int mScatterSkip;
   LineStyle mLineStyle;
+  bool mAdaptiveSampling;
+  double mSamplingTolerance;
   
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
@@ -5319,6 +7983,7 @@ protected:
   // non-virtual methods:
   void getCurveLines(QVector<QPointF> *lines, const QCPDataRange &dataRange, double penWidth) const;
   void getScatters(QVector<QPointF> *scatters, const QCPDataRange &dataRange, double scatterWidth) const;
+  void pointsToPixels(QVector<QPointF> *points, int begin) const;
   int getRegion(double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
   QPointF getOptimizedPoint(int prevRegion, double prevKey, double prevValue, double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
   QVector<QPointF> getOptimizedCornerPoints(int prevRegion, int currentRegion, double prevKey, double prevValue, double key, double value, double keyMin, double valueMax, double keyMax, double valueMin) const;
@@ -5503,6 +8168,10 @@ protected:
   double mStackingGap;
   QPointer<QCPBars> mBarBelow, mBarAbove;
   
+  // non-property members:
+  mutable QVector<double> mWorkingPixels;
+  QVector<QRectF> mBarRects;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
@@ -5510,6 +8179,8 @@ protected:
   // non-virtual methods:
   void getVisibleDataBounds(QCPBarsDataContainer::const_iterator &begin, QCPBarsDataContainer::const_iterator &end) const;
   QRectF getBarRect(double key, double value) const;
+  void getBarRects(const QCPBarsDataContainer::const_iterator &begin, const QCPBarsDataContainer::const_iterator &end, QVector<QRectF> &rects) const;
+  QRectF barRectFromPixels(double keyPixel, double lowerPixelWidth, double upperPixelWidth, double basePixel, double valuePixel, double value) const;
   void getPixelWidth(double key, double &lower, double &upper) const;
   double getStackedBaseValue(double key, bool positive) const;
   static void connectBars(QCPBars* lower, QCPBars* upper);
@@ -5768,6 +8439,7 @@ protected:
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+  virtual const void *dataObject() const Q_DECL_OVERRIDE;
   
   friend class QCustomPlot;
   friend class QCPLegend;
@@ -0,0 +1,588 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <iterator>
+#include <algorithm>
+
+#include "Birdcage.hpp"
+
+namespace
+{
+
+// Decompressed chunks kept for panning and zooming around old samples
+const int cacheSize{8};
+
+// Late samples collected before they are merged into their chunks
+const int lateLimit{1024};
+
+} // namespace
+
+constexpr int Birdcage::chunkSize;
+constexpr int Birdcage::hotSize;
+
+Birdcage::Birdcage(int channels) :
+    data{QSharedPointer<QCPGraphDataContainer>::create()},
+    columns(channels),
+    viewed{0},
+    coldCount{0},
+    nextChunkId{0},
+    materialized{0},
+    lateKept{0},
+    viewportPixels{0}
+{
+    data->setPyramidIndex(true);
+}
+
+int Birdcage::channels() const
+{
+    return static_cast<int>(columns.size());
+}
+
+int Birdcage::size() const
+{
+    return coldCount + hotCount();
+}
+
+bool Birdcage::isEmpty() const
+{
+    return size() == 0;
+}
+
+void Birdcage::add(double key, std::initializer_list<double> values)
+{
+    // Samples usually arrive in order, so they are appended. Late ones are
+    // inserted where the container will put them, which is after any
+    // samples with the same key. Those that are older than the hot samples
+    // go into their chunk.
+    const QCPGraphData sample{key, 0};
+    if (!cold.empty()) {
+        const bool beforeHot{hotCount() == 0
+            ? sample.sortKey() <= cold.back().lastKey()
+            : sample.sortKey() < (data->constBegin() + materialized)->sortKey()};
+        if (beforeHot) {
+            addCold(sample.key, values);
+            return;
+        }
+    }
+
+    const int oldSize{data->size()};
+    int index{oldSize};
+    if (!data->isEmpty() && sample.sortKey() < (data->constEnd() - 1)->sortKey()) {
+        index = data->findEnd(sample.sortKey(), false) - data->constBegin();
+    }
+    index -= materialized;
+
+    auto value{values.begin()};
+    for (int channel{0}; channel < channels(); ++channel, ++value) {
+        QCPDataBlockStorage<Value>& column{columns[channel]};
+        if (channel == viewed) {
+            data->add(QCPGraphData(key, *value));
+        } else if (index == column.size()) {
+            column.append(*value);
+        } else {
+            column.insert(column.begin() + index, *value);
+        }
+    }
+
+    // The container drops the oldest samples beyond its key span limit
+    removeFront(oldSize + 1 - data->size());
+    dropExpiredChunks();
+    seal();
+}
+
+void Birdcage::clear()
+{
+    data->clear();
+    for (auto& column : columns) {
+        column.clear();
+    }
+    cold.clear();
+    coldCount = 0;
+    materialized = 0;
+    details.clear();
+    cache.clear();
+    spillFile.clear();
+    spillGaps.clear();
+    lateKeys.clear();
+    lateValues.clear();
+    lateKept = 0;
+}
+
+double Birdcage::keySpanLimit() const
+{
+    return data->keySpanLimit();
+}
+
+void Birdcage::setKeySpanLimit(double span)
+{
+    const int oldSize{data->size()};
+    data->setKeySpanLimit(span);
+    removeFront(oldSize - data->size());
+    dropExpiredChunks();
+}
+
+int Birdcage::viewedChannel() const
+{
+    return viewed;
+}
+
+QSharedPointer<QCPGraphDataContainer> Birdcage::view(int channel)
+{
+    if (channel != viewed) {
+        QCPDataBlockStorage<Value>& from{columns[viewed]};
+        QCPDataBlockStorage<Value>& to{columns[channel]};
+
+        // Swap the values of the viewed channel into its column, and the
+        // values of the requested channel into the container
+        from.resize(hotCount());
+        auto fromIt{from.begin()};
+        auto toIt{to.constBegin()};
+        for (auto it{data->begin() + materialized}; it != data->end(); ++it, ++fromIt, ++toIt) {
+            *fromIt = it->value;
+            *it = QCPGraphData(it->key, *toIt);
+        }
+        to.clear();
+        viewed = channel;
+
+        // The cold samples in the container belong to the old channel
+        materialize();
+    }
+
+    return data;
+}
+
+void Birdcage::setViewport(const QCPRange& range, int pixels)
+{
+    viewportRange = range;
+    viewportPixels = pixels;
+    updateDetails();
+}
+
+std::size_t Birdcage::memoryUsage() const
+{
+    std::size_t bytes{static_cast<std::size_t>(data->memoryUsage())};
+    for (const auto& column : columns) {
+        bytes += column.blockCount() * QCPDataBlockStorage<Value>::blockSize * sizeof(Value);
+    }
+    for (const auto& chunk : cold) {
+        bytes += chunk.memoryUsage();
+    }
+    for (const auto& chunk : cache) {
+        bytes += chunk.keys.capacity() * sizeof(double);
+        for (const auto& channel : chunk.values) {
+            bytes += channel.capacity() * sizeof(Value);
+        }
+    }
+    bytes += lateKeys.capacity() * sizeof(double) + lateValues.capacity() * sizeof(Value);
+
+    return bytes;
+}
+
+std::size_t Birdcage::reclaim(MemoryBudget::Reclaim way, std::size_t bytes)
+{
+    const std::size_t before{memoryUsage()};
+
+    if (way == MemoryBudget::Rebuild) {
+        // Decompressed chunks are decoded again when they are materialized.
+        // The pyramid index of the container stays: the container is always
+        // plotted, so it would be rebuilt by the next value range query
+        cache.clear();
+    } else if (way == MemoryBudget::Spill) {
+        if (!spillFile) {
+            spillFile = QSharedPointer<QTemporaryFile>::create();
+            if (!spillFile->open()) {
+                spillFile.clear();
+                return 0;
+            }
+        }
+
+        // The oldest chunks are the least likely to be looked at again
+        std::size_t freed{0};
+        for (auto& chunk : cold) {
+            if (freed >= bytes) {
+                break;
+            }
+            if (!chunk.isSpilled()) {
+                const std::size_t size{chunk.memoryUsage()};
+                const qint64 offset{allocateSpill(chunk.compressedSize())};
+                if (!chunk.spill(spillFile, offset)) {
+                    freeSpill(offset, chunk.compressedSize());
+                    break;
+                }
+                freed += size - chunk.memoryUsage();
+            }
+        }
+    }
+
+    const std::size_t after{memoryUsage()};
+    return before > after ? before - after : 0;
+}
+
+int Birdcage::hotCount() const
+{
+    return data->size() - materialized;
+}
+
+void Birdcage::addCold(double key, std::initializer_list<double> values)
+{
+    // Chunks are immutable, so late samples are collected and merged into
+    // their chunks together, which compresses every chunk only once per
+    // batch
+    const auto position{std::upper_bound(lateKeys.begin(), lateKeys.end(), key) - lateKeys.begin()};
+    lateKeys.insert(lateKeys.begin() + position, key);
+    lateValues.insert(lateValues.begin() + position * channels(), values.begin(), values.end());
+    ++coldCount;
+
+    if (static_cast<int>(lateKeys.size()) >= lateKept + lateLimit) {
+        mergeLate();
+    }
+}
+
+void Birdcage::mergeLate()
+{
+    // A late sample goes into the first chunk that doesn't end before it,
+    // or the last one, after any samples with the same key. The samples of
+    // chunks that can't be read stay here, and the chunks stay as they are.
+    std::vector<double> keptKeys;
+    std::vector<Value> keptValues;
+    std::size_t next{0};
+    while (next < lateKeys.size()) {
+        auto chunk{std::lower_bound(cold.begin(), cold.end(), lateKeys[next],
+                                    [](const SealedChunk& chunk, double key) {
+                                        return chunk.lastKey() < key;
+                                    })};
+        if (chunk == cold.end()) {
+            --chunk;
+        }
+        const std::size_t end{chunk + 1 == cold.end()
+            ? lateKeys.size()
+            : static_cast<std::size_t>(std::upper_bound(lateKeys.begin() + next, lateKeys.end(), chunk->lastKey()) - lateKeys.begin())};
+
+        std::vector<double> keys;
+        std::vector<std::vector<Value>> values;
+        if (!chunk->decode(keys, values)) {
+            keptKeys.insert(keptKeys.end(), lateKeys.begin() + next, lateKeys.begin() + end);
+            keptValues.insert(keptValues.end(), lateValues.begin() + next * channels(), lateValues.begin() + end * channels());
+            next = end;
+            continue;
+        }
+
+        std::vector<double> mergedKeys;
+        std::vector<std::vector<Value>> mergedValues(channels());
+        mergedKeys.reserve(keys.size() + end - next);
+        for (auto& channel : mergedValues) {
+            channel.reserve(keys.size() + end - next);
+        }
+        std::size_t old{0};
+        const auto takeOld = [&](std::size_t until) {
+            for (; old < until; ++old) {
+                mergedKeys.push_back(keys[old]);
+                for (int channel{0}; channel < channels(); ++channel) {
+                    mergedValues[channel].push_back(values[channel][old]);
+                }
+            }
+        };
+        for (std::size_t i{next}; i < end; ++i) {
+            takeOld(std::upper_bound(keys.begin() + old, keys.end(), lateKeys[i]) - keys.begin());
+            mergedKeys.push_back(lateKeys[i]);
+            for (int channel{0}; channel < channels(); ++channel) {
+                mergedValues[channel].push_back(lateValues[i * channels() + channel]);
+            }
+        }
+        takeOld(keys.size());
+
+        if (chunk->isSpilled()) {
+            freeSpill(chunk->spillOffset(), chunk->compressedSize());
+        }
+        *chunk = SealedChunk{nextChunkId++, mergedKeys, mergedValues};
+        rematerialize(static_cast<std::size_t>(chunk - cold.begin()));
+        next = end;
+    }
+    lateKeys.swap(keptKeys);
+    lateValues.swap(keptValues);
+    lateKept = static_cast<int>(lateKeys.size());
+
+    // The merged chunks may cover more of the viewport now
+    updateDetails();
+}
+
+void Birdcage::removeFront(int count)
+{
+    // The container drops the cold samples it holds first
+    const int fromMaterialized{std::min(count, materialized)};
+    materialized -= fromMaterialized;
+    count -= fromMaterialized;
+    if (count <= 0) {
+        return;
+    }
+
+    for (auto& column : columns) {
+        column.shrinkFront(count);
+    }
+}
+
+void Birdcage::dropExpiredChunks()
+{
+    if (keySpanLimit() <= 0 || cold.empty() || data->isEmpty()) {
+        return;
+    }
+
+    // The container has already dropped the samples of these chunks. Late
+    // samples go with the chunk they are to be merged into, and those
+    // beyond the last chunk belong to it as well.
+    const double lowestKey{(data->constEnd() - 1)->sortKey() - keySpanLimit()};
+    const auto lastKey = [this]() {
+        return cold.size() == 1 && !lateKeys.empty()
+            ? std::max(cold.front().lastKey(), lateKeys.back())
+            : cold.front().lastKey();
+    };
+    int dropped{0};
+    while (!cold.empty() && lastKey() < lowestKey) {
+        const auto lateEnd{std::upper_bound(lateKeys.begin(), lateKeys.end(), lastKey())};
+        const auto lateCount{lateEnd - lateKeys.begin()};
+        lateKeys.erase(lateKeys.begin(), lateEnd);
+        lateValues.erase(lateValues.begin(), lateValues.begin() + lateCount * channels());
+
+        if (cold.front().isSpilled()) {
+            freeSpill(cold.front().spillOffset(), cold.front().compressedSize());
+        }
+        coldCount -= cold.front().size() + static_cast<int>(lateCount);
+        cold.pop_front();
+        ++dropped;
+    }
+    lateKept = std::min(lateKept, static_cast<int>(lateKeys.size()));
+    if (cold.empty()) {
+        spillFile.clear();
+        spillGaps.clear();
+    }
+    if (dropped > 0) {
+        details.erase(details.begin(), details.begin() + dropped);
+        updateDetails();
+    }
+}
+
+void Birdcage::seal()
+{
+    if (hotCount() < hotSize + chunkSize) {
+        return;
+    }
+
+    // Late samples are merged at least once per sealed chunk, so they show
+    // up soon
+    mergeLate();
+    const int hot{hotCount()};
+
+    // Samples with the same key stay in one tier, so the cold samples in
+    // the container can be told apart from the hot ones by their key
+    const auto first{data->constBegin() + materialized};
+    int count{chunkSize};
+    while (count < hot && (first + count)->sortKey() == (first + count - 1)->sortKey()) {
+        ++count;
+    }
+
+    std::vector<double> keys(count);
+    std::vector<std::vector<Value>> values(channels(), std::vector<Value>(count));
+    for (int i{0}; i < count; ++i) {
+        keys[i] = (first + i)->key;
+        for (int channel{0}; channel < channels(); ++channel) {
+            values[channel][i] = channel == viewed ? (first + i)->value : *(columns[channel].constBegin() + i);
+        }
+    }
+    cold.emplace_back(nextChunkId++, keys, values);
+    coldCount += count;
+
+    for (auto& column : columns) {
+        column.shrinkFront(count);
+    }
+
+    // The sealed samples stay in the container as they are, unless the
+    // chunk is to be drawn with less detail
+    materialized += count;
+    details.push_back(Full);
+    updateDetails();
+}
+
+std::vector<Birdcage::Detail> Birdcage::wantedDetails() const
+{
+    // Chunks within the viewport, plus one on either side so the line
+    // continues to the edges, are drawn with the decompressed samples if
+    // there are few enough per pixel, and with their envelopes otherwise.
+    // Without a viewport, all chunks are drawn with their envelopes.
+    std::vector<Detail> wanted(cold.size(), viewportPixels > 0 ? None : Envelope);
+    if (viewportPixels > 0 && !cold.empty()) {
+        auto begin{std::lower_bound(cold.begin(), cold.end(), viewportRange.lower,
+                                    [](const SealedChunk& chunk, double key) {
+                                        return chunk.lastKey() < key;
+                                    })};
+        auto end{std::upper_bound(cold.begin(), cold.end(), viewportRange.upper,
+                                  [](double key, const SealedChunk& chunk) {
+                                      return key < chunk.firstKey();
+                                  })};
+        if (begin != cold.begin()) {
+            --begin;
+        }
+        if (end != cold.end()) {
+            ++end;
+        }
+
+        const double pixelsPerKey{viewportPixels / std::max(viewportRange.size(), 1e-12)};
+        for (auto chunk{begin}; chunk != end; ++chunk) {
+            const double pixels{(chunk->lastKey() - chunk->firstKey()) * pixelsPerKey};
+            const bool dense{chunk->size() > 2 * SealedChunk::bucketSize * std::max(pixels, 1.0)};
+            wanted[chunk - cold.begin()] = dense ? Envelope : Full;
+        }
+    }
+
+    return wanted;
+}
+
+void Birdcage::materialize()
+{
+    details = wantedDetails();
+
+    // Replace the cold samples in front of the hot ones
+    const int hot{hotCount()};
+    if (hot == 0) {
+        data->clear();
+    } else {
+        data->removeBefore((data->constBegin() + materialized)->sortKey());
+    }
+
+    std::vector<QCPGraphData> samples;
+    for (std::size_t i{0}; i < cold.size(); ++i) {
+        if (details[i] == Envelope) {
+            const std::vector<QCPGraphData>& envelope{cold[i].envelope(viewed)};
+            samples.insert(samples.end(), envelope.begin(), envelope.end());
+        } else if (details[i] == Full) {
+            const Decoded* chunk{decoded(cold[i])};
+            if (!chunk) {
+                // The envelope is always at hand
+                details[i] = Envelope;
+                const std::vector<QCPGraphData>& envelope{cold[i].envelope(viewed)};
+                samples.insert(samples.end(), envelope.begin(), envelope.end());
+                continue;
+            }
+            for (std::size_t j{0}; j < chunk->keys.size(); ++j) {
+                samples.push_back(QCPGraphData(chunk->keys[j], chunk->values[viewed][j]));
+            }
+        }
+    }
+    data->add(samples.begin(), samples.end(), true);
+
+    // The container may drop some of them right away due to its key span
+    // limit
+    materialized = data->size() - hot;
+}
+
+void Birdcage::updateDetails()
+{
+    // Only the samples of the chunks whose detail changed are replaced,
+    // which leaves the rest of the container and its index alone
+    const std::vector<Detail> wanted{wantedDetails()};
+    for (std::size_t i{0}; i < cold.size(); ++i) {
+        if (wanted[i] != details[i]) {
+            details[i] = wanted[i];
+            rematerialize(i);
+        }
+    }
+}
+
+void Birdcage::rematerialize(std::size_t index)
+{
+    // Chunks don't overlap, so the samples of a chunk in the container are
+    // those within its key range
+    const SealedChunk& chunk{cold[index]};
+    const int hot{hotCount()};
+    const Decoded* decodedChunk{details[index] == Full ? decoded(chunk) : nullptr};
+    if (details[index] == Full && !decodedChunk) {
+        // The envelope is always at hand
+        details[index] = Envelope;
+    }
+
+    if (details[index] == Envelope) {
+        const std::vector<QCPGraphData>& envelope{chunk.envelope(viewed)};
+        data->replace(chunk.firstKey(), chunk.lastKey(), envelope.begin(), envelope.end());
+    } else {
+        std::vector<QCPGraphData> samples;
+        if (decodedChunk) {
+            samples.reserve(decodedChunk->keys.size());
+            for (std::size_t j{0}; j < decodedChunk->keys.size(); ++j) {
+                samples.push_back(QCPGraphData(decodedChunk->keys[j], decodedChunk->values[viewed][j]));
+            }
+        }
+        data->replace(chunk.firstKey(), chunk.lastKey(), samples.begin(), samples.end());
+    }
+
+    // The container may drop some of them right away due to its key span
+    // limit
+    materialized = data->size() - hot;
+}
+
+const Birdcage::Decoded* Birdcage::decoded(const SealedChunk& chunk)
+{
+    for (auto it{cache.begin()}; it != cache.end(); ++it) {
+        if (it->id == chunk.id()) {
+            cache.splice(cache.begin(), cache, it);
+            return &cache.front();
+        }
+    }
+
+    cache.emplace_front();
+    cache.front().id = chunk.id();
+    if (!chunk.decode(cache.front().keys, cache.front().values)) {
+        cache.pop_front();
+        return nullptr;
+    }
+    if (static_cast<int>(cache.size()) > cacheSize) {
+        cache.pop_back();
+    }
+
+    return &cache.front();
+}
+
+qint64 Birdcage::allocateSpill(qint64 bytes)
+{
+    // The first gap that chunks which were dropped or compressed again left
+    // behind and that is large enough, or else the end of the file
+    for (auto gap{spillGaps.begin()}; gap != spillGaps.end(); ++gap) {
+        if (gap->second >= bytes) {
+            const qint64 offset{gap->first};
+            const qint64 rest{gap->second - bytes};
+            spillGaps.erase(gap);
+            if (rest > 0) {
+                spillGaps.emplace(offset + bytes, rest);
+            }
+            return offset;
+        }
+    }
+
+    return spillFile->size();
+}
+
+void Birdcage::freeSpill(qint64 offset, qint64 bytes)
+{
+    // Join adjacent gaps, and give a gap at the end of the file back
+    auto next{spillGaps.lower_bound(offset)};
+    if (next != spillGaps.end() && offset + bytes == next->first) {
+        bytes += next->second;
+        next = spillGaps.erase(next);
+    }
+    if (next != spillGaps.begin()) {
+        const auto previous{std::prev(next)};
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            bytes += previous->second;
+            spillGaps.erase(previous);
+        }
+    }
+
+    if (offset + bytes >= spillFile->size()) {
+        spillFile->resize(offset);
+    } else {
+        spillGaps.emplace(offset, bytes);
+    }
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef BIRDCAGE_HPP
+#define BIRDCAGE_HPP
+
+#include <map>
+#include <list>
+#include <deque>
+#include <limits>
+#include <vector>
+#include <initializer_list>
+
+#include <QSharedPointer>
+#include <QTemporaryFile>
+
+#include "../qcustomplot/qcustomplot.h"
+#include "SealedChunk.hpp"
+#include "MemoryBudget.hpp"
+
+// Samples of several channels that share one timestamp. The timestamps are
+// stored once: together with the values of the viewed channel in the
+// container that is handed to the graph, and the values of the other
+// channels in columns that are kept in the same order.
+//
+// Only the most recent samples are kept like that (the hot tier). Older
+// ones are compressed into sealed chunks (the cold tier). In front of the
+// hot samples, the container holds the cold samples that the viewport
+// needs: the envelopes of chunks that are drawn with many samples per
+// pixel, and the decompressed samples of the others. Samples that arrive
+// too late for the hot tier are collected, and merged into their chunks a
+// batch at a time.
+class Birdcage
+{
+public:
+    using Value = decltype(QCPGraphData::value);
+
+    // Samples per sealed chunk, and hot samples that are never sealed
+    static constexpr int chunkSize{4096};
+    static constexpr int hotSize{1 << 16};
+
+    explicit Birdcage(int channels);
+
+    int channels() const;
+    int size() const;
+    bool isEmpty() const;
+
+    // Calls `visit(key, values)` for every sample in key order. Returns
+    // false if some spilled samples couldn't be read back, which are left
+    // out then.
+    template <typename Visitor>
+    bool forEach(Visitor visit) const;
+
+    void add(double key, std::initializer_list<double> values);
+    void clear();
+
+    // Keeps only the samples within `span` of the latest key, 0 keeps all.
+    // Cold samples are dropped a whole chunk at a time.
+    double keySpanLimit() const;
+    void setKeySpanLimit(double span);
+
+    // Switches the viewed channel in place, so previously returned views
+    // show the new channel as well
+    int viewedChannel() const;
+    QSharedPointer<QCPGraphDataContainer> view(int channel);
+
+    // Decides which cold samples the view holds, for a key axis showing
+    // `range` on `pixels` pixels
+    void setViewport(const QCPRange& range, int pixels);
+
+    // For the memory budget: decompressed chunks can be rebuilt, and the
+    // oldest chunks can be spilled to a temporary file
+    std::size_t memoryUsage() const;
+    std::size_t reclaim(MemoryBudget::Reclaim way, std::size_t bytes);
+
+private:
+    enum Detail : char { None, Envelope, Full };
+
+    struct Decoded
+    {
+        quint64 id;
+        std::vector<double> keys;
+        std::vector<std::vector<Value>> values;
+    };
+
+    int hotCount() const;
+    void addCold(double key, std::initializer_list<double> values);
+    void mergeLate();
+    void removeFront(int count);
+    void dropExpiredChunks();
+    void seal();
+    std::vector<Detail> wantedDetails() const;
+    void materialize();
+    void updateDetails();
+    void rematerialize(std::size_t index);
+    const Decoded* decoded(const SealedChunk& chunk);
+    qint64 allocateSpill(qint64 bytes);
+    void freeSpill(qint64 offset, qint64 bytes);
+
+    QSharedPointer<QCPGraphDataContainer> data;
+    std::vector<QCPDataBlockStorage<Value>> columns;
+    int viewed;
+
+    std::deque<SealedChunk> cold;
+    int coldCount;
+    quint64 nextChunkId;
+    int materialized;
+    std::vector<Detail> details;
+    std::list<Decoded> cache;
+    QSharedPointer<QTemporaryFile> spillFile;
+    std::map<qint64, qint64> spillGaps;
+
+    // Late samples in key order, with the values of all channels, and how
+    // many of them the last merge kept because their chunk couldn't be read
+    std::vector<double> lateKeys;
+    std::vector<Value> lateValues;
+    int lateKept;
+
+    QCPRange viewportRange;
+    int viewportPixels;
+};
+
+template <typename Visitor>
+bool Birdcage::forEach(Visitor visit) const
+{
+    std::vector<double> values(channels());
+
+    // Late samples that aren't merged into their chunks yet come after the
+    // cold samples with the same key
+    std::size_t late{0};
+    const auto visitLate = [&](double before) {
+        for (; late < lateKeys.size() && lateKeys[late] < before; ++late) {
+            for (int channel{0}; channel < channels(); ++channel) {
+                values[channel] = lateValues[late * channels() + channel];
+            }
+            visit(lateKeys[late], values);
+        }
+    };
+
+    bool complete{true};
+    std::vector<double> chunkKeys;
+    std::vector<std::vector<Value>> chunkValues;
+    for (const auto& chunk : cold) {
+        if (!chunk.decode(chunkKeys, chunkValues)) {
+            complete = false;
+            continue;
+        }
+        for (int i{0}; i < chunk.size(); ++i) {
+            visitLate(chunkKeys[i]);
+            for (int channel{0}; channel < channels(); ++channel) {
+                values[channel] = chunkValues[channel][i];
+            }
+            visit(chunkKeys[i], values);
+        }
+    }
+    visitLate(std::numeric_limits<double>::infinity());
+
+    int index{0};
+    for (auto it{data->constBegin() + materialized}; it != data->constEnd(); ++it, ++index) {
+        for (int channel{0}; channel < channels(); ++channel) {
+            values[channel] = channel == viewed ? it->value : *(columns[channel].constBegin() + index);
+        }
+        visit(it->key, values);
+    }
+
+    return complete;
+}
+
+#endif
@@ -14,6 +14,7 @@
 #include <QRect>
 #include <QStyle>
 #include <QLabel>
+#include <QSpinBox>
 #include <QComboBox>
 #include <QShortcut>
 #include <QMessageBox>
@@ -34,6 +35,8 @@ Birdview::Birdview()
     QVBoxLayout* toolbarLayout{new QVBoxLayout()};
     QVBoxLayout* graphBoxLayout{new QVBoxLayout()};
     QHBoxLayout* axisChooserLayout{new QHBoxLayout()};
+    QHBoxLayout* historyLayout{new QHBoxLayout()};
+    QHBoxLayout* memoryLayout{new QHBoxLayout()};
 
     // Create widgets
     connectionButton = new QPushButton;
@@ -41,9 +44,6 @@ Birdview::Birdview()
     connect(connectionButton, &QPushButton::clicked,
             this, &Birdview::toggleConnection);
 
-    xs = QSharedPointer<QCPGraphDataContainer>::create();
-    ys = QSharedPointer<QCPGraphDataContainer>::create();
-    zs = QSharedPointer<QCPGraphDataContainer>::create();
     plot = new QCustomPlot;
     plot->addGraph();
     plot->graph()->setAdaptiveSampling(true);
@@ -52,6 +52,25 @@ Birdview::Birdview()
     plot->xAxis->setRange(0, 1);
     plot->yAxis->setRange(0, 1);
     plot->replot();
+    connect(plot->xAxis, static_cast<void(QCPAxis::*)(const QCPRange&)>(&QCPAxis::rangeChanged),
+            this, &Birdview::onRangeChanged);
+
+    // The cursor readout is on the overlay layer, which has its own paint
+    // buffer, so following the mouse doesn't redraw the graphs
+    cursorLine = new QCPItemStraightLine(plot);
+    cursorLine->setLayer("overlay");
+    cursorLine->setPen(QPen(Qt::gray, 0, Qt::DashLine));
+    cursorLine->setVisible(false);
+    cursorText = new QCPItemText(plot);
+    cursorText->setLayer("overlay");
+    cursorText->position->setType(QCPItemPosition::ptAbsolute);
+    cursorText->setPositionAlignment(Qt::AlignLeft | Qt::AlignTop);
+    cursorText->setTextAlignment(Qt::AlignLeft);
+    cursorText->setBrush(QColor(255, 255, 255, 200));
+    cursorText->setPadding(QMargins(4, 4, 4, 4));
+    cursorText->setVisible(false);
+    connect(plot, &QCustomPlot::mouseMove,
+            this, &Birdview::onMouseMove);
 
     // Create group boxes
     QWidget* toolbarWidget{new QWidget()};
@@ -66,6 +85,37 @@ Birdview::Birdview()
     axisComboBox->setCurrentIndex(1);
     connect(axisComboBox, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
             this, &Birdview::onAxisChanged);
+    onAxisChanged(axisComboBox->currentIndex());
+
+    QLabel* historyLabel{new QLabel("History:")};
+    QSpinBox* historySpinBox{new QSpinBox()};
+    historySpinBox->setRange(0, 24 * 60);
+    historySpinBox->setSuffix(" min");
+    historySpinBox->setSpecialValueText("Unlimited");
+    connect(historySpinBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this, &Birdview::onHistoryChanged);
+
+    QLabel* memoryLabel{new QLabel("Memory:")};
+    QSpinBox* memorySpinBox{new QSpinBox()};
+    memorySpinBox->setRange(0, 64 * 1024);
+    memorySpinBox->setSingleStep(64);
+    memorySpinBox->setSuffix(" MB");
+    memorySpinBox->setSpecialValueText("Unlimited");
+    connect(memorySpinBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this, &Birdview::onMemoryLimitChanged);
+    memoryUsageLabel = new QLabel();
+    memoryUsageLabel->setAlignment(Qt::AlignRight);
+
+    // Register everything that grows with the data or the window
+    memoryBudget.add("Samples",
+                     [this]() { return birdcage.memoryUsage(); },
+                     [this](MemoryBudget::Reclaim way, std::size_t bytes) {
+                         return birdcage.reclaim(way, bytes);
+                     });
+    memoryBudget.add("Paint buffers",
+                     [this]() { return static_cast<std::size_t>(plot->paintBufferMemoryUsage()); });
+    connect(&memoryBudget, &MemoryBudget::usageChanged,
+            this, &Birdview::onMemoryUsageChanged);
 
     splitter = new QSplitter();
     splitter->addWidget(plot);
@@ -93,6 +143,17 @@ Birdview::Birdview()
     graphBoxLayout->addWidget(recordButton);
     graphBoxLayout->setAlignment(recordButton, Qt::AlignHCenter);
     graphBoxLayout->addLayout(axisChooserLayout);
+    historyLayout->addWidget(historyLabel);
+    historyLayout->addWidget(historySpinBox);
+    historyLayout->setStretch(0, 2);
+    historyLayout->setStretch(1, 8);
+    graphBoxLayout->addLayout(historyLayout);
+    memoryLayout->addWidget(memoryLabel);
+    memoryLayout->addWidget(memorySpinBox);
+    memoryLayout->setStretch(0, 2);
+    memoryLayout->setStretch(1, 8);
+    graphBoxLayout->addLayout(memoryLayout);
+    graphBoxLayout->addWidget(memoryUsageLabel);
     graphBox->setLayout(graphBoxLayout);
 
     splitter->setCollapsible(1, false);
@@ -204,9 +265,7 @@ void Birdview::deleteData()
             toggleRecord();
         }
 
-        xs->clear();
-        ys->clear();
-        zs->clear();
+        birdcage.clear();
 
         plot->xAxis->setRange(0, 1);
         plot->yAxis->setRange(0, 1);
@@ -224,35 +283,93 @@ bool Birdview::exportData(QString file) const
     QTextStream outputTextstream{&outputFile};
     outputTextstream << "timestamp x y z\n";
 
-    auto xs_it{xs->constBegin()};
-    auto ys_it{ys->constBegin()};
-    auto zs_it{zs->constBegin()};
-    for (; xs_it != xs->constEnd(); ++xs_it, ++ys_it, ++zs_it) {
-        outputTextstream << xs_it->key << " "
-                         << xs_it->value << " "
-                         << ys_it->value << " "
-                         << zs_it->value << "\n";
+    // Samples that can't be read back from the spill file are missing
+    return birdcage.forEach([&outputTextstream](double key, const std::vector<double>& values) {
+        outputTextstream << key << " "
+                         << values[0] << " "
+                         << values[1] << " "
+                         << values[2] << "\n";
+    });
+}
+
+void Birdview::onAxisChanged(int index)
+{
+    if (index >= 0 && index < birdcage.channels()) {
+        plot->graph()->setData(birdcage.view(index));
+        plot->graph()->setName(QString{"XYZ"}.mid(index, 1));
     }
 
-    return true;
+    plot->replot();
 }
 
-void Birdview::addFlock()
+void Birdview::onHistoryChanged(int minutes)
 {
-    QCPGraph* new_xs{plot->addLayer()}
+    // Timestamps are in seconds, and 0 keeps everything
+    birdcage.setKeySpanLimit(minutes * 60.0);
+    plot->replot();
 }
 
-void Birdview::onAxisChanged(int index)
+void Birdview::onMemoryLimitChanged(int megabytes)
 {
-    if (index == 0) {
-        plot->graph()->setData(xs);
-    } else if (index == 1) {
-        plot->graph()->setData(ys);
-    } else if (index == 2) {
-        plot->graph()->setData(zs);
+    // 0 is unlimited
+    memoryBudget.setLimit(static_cast<std::size_t>(megabytes) * 1024 * 1024);
+}
+
+void Birdview::onMemoryUsageChanged(std::size_t usage, std::size_t limit)
+{
+    QString text{"Using " + QString::number(usage / (1024.0 * 1024.0), 'f', 1) + " MB"};
+    if (limit > 0) {
+        text += " of " + QString::number(limit / (1024 * 1024)) + " MB";
     }
+    memoryUsageLabel->setText(text);
+    memoryUsageLabel->setToolTip(memoryBudget.report());
+}
 
-    plot->replot();
+void Birdview::onRangeChanged(const QCPRange& range)
+{
+    // Old samples are only decompressed where the plot shows them in detail
+    birdcage.setViewport(range, plot->axisRect()->width());
+}
+
+void Birdview::onMouseMove(QMouseEvent* event)
+{
+    const bool inside{plot->axisRect()->rect().contains(event->pos())};
+    if (!inside) {
+        // Moving outside the axis rect only hides the readout once
+        if (cursorLine->visible()) {
+            cursorLine->setVisible(false);
+            cursorText->setVisible(false);
+            plot->layer("overlay")->replot();
+        }
+        return;
+    }
+
+    const double key{plot->xAxis->pixelToCoord(event->pos().x())};
+    QString text{"t = " + QString::number(key)};
+    for (int i{0}; i < plot->graphCount(); ++i) {
+        const QCPGraph* graph{plot->graph(i)};
+        bool found{false};
+        const double value{graph->visible() ? graph->valueAtKey(key, found) : 0};
+        if (found) {
+            text += "\n" + graph->name() + " = " + QString::number(value);
+        }
+    }
+
+    // The readout looks the same, e.g. for repeated events at one position
+    const QPointF textPosition{event->pos() + QPoint{12, 12}};
+    if (cursorLine->visible() && cursorText->position->coords() == textPosition &&
+        cursorText->text() == text) {
+        return;
+    }
+
+    cursorLine->setVisible(true);
+    cursorText->setVisible(true);
+    cursorLine->point1->setCoords(key, 0);
+    cursorLine->point2->setCoords(key, 1);
+    cursorText->position->setCoords(textPosition);
+    cursorText->setText(text);
+
+    plot->layer("overlay")->replot();
 }
 
 void Birdview::onDataReceived()
@@ -268,9 +385,7 @@ void Birdview::onDataReceived()
             double z{bytesToFloat(datagram.data() + 8)};
             double timestamp{bytesToFloat(datagram.data() + 12)};
 
-            xs->add(QCPGraphData(timestamp, x));
-            ys->add(QCPGraphData(timestamp, y));
-            zs->add(QCPGraphData(timestamp, z));
+            birdcage.add(timestamp, {x, y, z});
 
             bool xRangeFound{false};
             bool yRangeFound{false};
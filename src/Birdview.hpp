@@ -8,14 +8,16 @@
 #ifndef BIRDVIEW_HPP
 #define BIRDVIEW_HPP
 
-#include <tuple>
 #include <limits>
 #include <vector>
+#include <cstddef>
 
 #include <QColor>
+#include <QLabel>
 #include <QString>
 #include <QWidget>
 #include <QGroupBox>
+#include <QMouseEvent>
 #include <QSplitter>
 #include <QTcpSocket>
 #include <QUdpSocket>
@@ -24,10 +26,8 @@
 #include <QSharedPointer>
 
 #include "../qcustomplot/qcustomplot.h"
-
-using Birdcage = QSharedPointer<QCPGraphDataContainer>;
-
-using Flock = std::tuple<QCPGraph*, QCPGraph*, QCPGraph*>;
+#include "Birdcage.hpp"
+#include "MemoryBudget.hpp"
 
 class Birdview : public QWidget
 {
@@ -46,17 +46,18 @@ private:
     bool exportData(QString) const;
     double bytesToFloat(char*) const;
 
-    Birdcage xs;
-    Birdcage ys;
-    Birdcage zs;
-    std::vector<Flock> flocks;
+    Birdcage birdcage{3};
+    MemoryBudget memoryBudget;
 
     QCustomPlot* plot;
+    QCPItemStraightLine* cursorLine;
+    QCPItemText* cursorText;
     QSplitter* splitter;
     QGroupBox* groupsBox;
     QVBoxLayout* groupsLayout;
     QPushButton* recordButton;
     QPushButton* connectionButton;
+    QLabel* memoryUsageLabel;
 
     bool replot;
     bool recording;
@@ -69,7 +70,6 @@ private:
     const QColor buttonGreen{"#47B84B"};
 
 private slots:
-    void addFlock();
     void deleteData();
 
     void toggleRecord();
@@ -78,6 +78,11 @@ private slots:
 
     void onDataReceived();
     void onAxisChanged(int);
+    void onHistoryChanged(int);
+    void onMemoryLimitChanged(int);
+    void onMemoryUsageChanged(std::size_t, std::size_t);
+    void onRangeChanged(const QCPRange&);
+    void onMouseMove(QMouseEvent*);
     void onSocketError(QTcpSocket::SocketError);
 };
 
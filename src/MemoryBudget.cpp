@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <algorithm>
+
+#include "MemoryBudget.hpp"
+
+namespace
+{
+
+// Memory is reclaimed above the high mark, down to the low mark, so it
+// isn't reclaimed again for every few samples that come in
+const double highMark{0.9};
+const double lowMark{0.75};
+
+const int updateMillis{1000};
+
+QString megabytes(std::size_t bytes)
+{
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MB";
+}
+
+} // namespace
+
+MemoryBudget::MemoryBudget(QObject* parent) :
+    QObject{parent},
+    maximum{0}
+{
+    connect(&timer, &QTimer::timeout,
+            this, &MemoryBudget::update);
+    timer.start(updateMillis);
+}
+
+void MemoryBudget::add(const QString& name, Usage usage, Reclaimer reclaim)
+{
+    consumers.push_back(Consumer{name, usage, reclaim});
+}
+
+std::size_t MemoryBudget::limit() const
+{
+    return maximum;
+}
+
+void MemoryBudget::setLimit(std::size_t bytes)
+{
+    maximum = bytes;
+    update();
+}
+
+std::size_t MemoryBudget::usage() const
+{
+    std::size_t bytes{0};
+    for (const auto& consumer : consumers) {
+        bytes += consumer.usage();
+    }
+
+    return bytes;
+}
+
+QString MemoryBudget::report() const
+{
+    QString text;
+    for (const auto& consumer : consumers) {
+        if (!text.isEmpty()) {
+            text += "\n";
+        }
+        text += consumer.name + ": " + megabytes(consumer.usage());
+    }
+
+    return text;
+}
+
+void MemoryBudget::update()
+{
+    std::size_t bytes{usage()};
+
+    if (maximum > 0 && bytes > maximum * highMark) {
+        const std::size_t target{static_cast<std::size_t>(maximum * lowMark)};
+        for (Reclaim way : {Spill, Rebuild}) {
+            for (auto& consumer : consumers) {
+                if (bytes <= target) {
+                    break;
+                }
+                if (consumer.reclaim) {
+                    const std::size_t freed{consumer.reclaim(way, bytes - target)};
+                    bytes -= std::min(freed, bytes);
+                }
+            }
+        }
+
+        // What was actually freed may differ from what was reported
+        bytes = usage();
+    }
+
+    emit usageChanged(bytes, maximum);
+}
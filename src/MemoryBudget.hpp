@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef MEMORYBUDGET_HPP
+#define MEMORYBUDGET_HPP
+
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+#include <QTimer>
+#include <QObject>
+#include <QString>
+
+// Keeps the memory taken up by large structures below a limit. Every
+// structure registers a function that reports its footprint, and optionally
+// one that frees some of it. Once the footprint of all of them approaches
+// the limit, they are asked to free memory, the coldest data first: first
+// what can be moved to disk, then what has to be rebuilt.
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Ways of freeing memory. Spilled data is only read back when it is
+    // looked at again, while rebuilt data may be needed by the next replot,
+    // so spilling is tried first
+    enum Reclaim { Rebuild, Spill };
+
+    using Usage = std::function<std::size_t()>;
+    using Reclaimer = std::function<std::size_t(Reclaim, std::size_t)>;
+
+    explicit MemoryBudget(QObject* parent = nullptr);
+
+    // `reclaim(way, bytes)` should try to free `bytes` in that way, and
+    // return how much it freed
+    void add(const QString& name, Usage usage, Reclaimer reclaim = {});
+
+    // 0 is unlimited
+    std::size_t limit() const;
+    void setLimit(std::size_t bytes);
+
+    std::size_t usage() const;
+
+    // The usage of every structure, one per line
+    QString report() const;
+
+public slots:
+    void update();
+
+signals:
+    void usageChanged(std::size_t usage, std::size_t limit);
+
+private:
+    struct Consumer
+    {
+        QString name;
+        Usage usage;
+        Reclaimer reclaim;
+    };
+
+    std::vector<Consumer> consumers;
+    std::size_t maximum;
+    QTimer timer;
+};
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cstring>
+#include <algorithm>
+
+#include <QtAlgorithms>
+
+#include "SealedChunk.hpp"
+
+namespace
+{
+
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<quint64>& words) :
+        words(words),
+        position{0}
+    {
+    }
+
+    void write(quint64 value, int count)
+    {
+        if (count < 64) {
+            value &= (quint64{1} << count) - 1;
+        }
+
+        const int used{position & 63};
+        if (used == 0) {
+            words.push_back(0);
+        }
+        words.back() |= value << used;
+        if (used + count > 64) {
+            words.push_back(value >> (64 - used));
+        }
+        position += count;
+    }
+
+private:
+    std::vector<quint64>& words;
+    int position;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const std::vector<quint64>& words) :
+        words(words),
+        position{0}
+    {
+    }
+
+    quint64 read(int count)
+    {
+        const int index{position >> 6};
+        const int used{position & 63};
+        quint64 value{words[index] >> used};
+        if (used + count > 64) {
+            value |= words[index + 1] << (64 - used);
+        }
+        position += count;
+
+        return count < 64 ? value & ((quint64{1} << count) - 1) : value;
+    }
+
+    // Reads `count` bits and sign-extends them
+    qint64 readSigned(int count)
+    {
+        const quint64 value{read(count)};
+        const quint64 sign{quint64{1} << (count - 1)};
+        return static_cast<qint64>((value ^ sign) - sign);
+    }
+
+private:
+    const std::vector<quint64>& words;
+    int position;
+};
+
+// Maps doubles to integers with the same order, so sorted timestamps have
+// small non-negative differences
+quint64 toOrdered(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits >> 63) ? ~bits : bits | (quint64{1} << 63);
+}
+
+double fromOrdered(quint64 bits)
+{
+    bits = (bits >> 63) ? bits & ~(quint64{1} << 63) : ~bits;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+quint64 toBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double fromBits(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Delta-of-delta buckets: prefix of ones terminated by a zero, then payload
+const int dodBits[]{7, 12, 20};
+
+} // namespace
+
+constexpr int SealedChunk::bucketSize;
+
+SealedChunk::SealedChunk(quint64 id,
+                         const std::vector<double>& keys,
+                         const std::vector<std::vector<Value>>& values) :
+    identifier{id},
+    count{static_cast<int>(keys.size())},
+    first{keys.front()},
+    last{keys.back()},
+    keyShift{0},
+    filePosition{0},
+    spillWords{0},
+    envelopes(values.size())
+{
+    BitWriter writer{bits};
+
+    // Timestamps: the first one as is, then the differences of consecutive
+    // differences. Differences usually share trailing zero bits (e.g. when
+    // the timestamps were floats), which are shifted out.
+    quint64 allDeltas{0};
+    for (int i{1}; i < count; ++i) {
+        allDeltas |= toOrdered(keys[i]) - toOrdered(keys[i - 1]);
+    }
+    keyShift = allDeltas == 0 ? 0 : qCountTrailingZeroBits(allDeltas);
+    writer.write(toOrdered(first), 64);
+
+    quint64 previousDelta{0};
+    for (int i{1}; i < count; ++i) {
+        const quint64 delta{(toOrdered(keys[i]) - toOrdered(keys[i - 1])) >> keyShift};
+        const qint64 dod{static_cast<qint64>(delta - previousDelta)};
+        previousDelta = delta;
+
+        if (dod == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+        int bucket{0};
+        while (bucket < 3 && (dod < -(qint64{1} << (dodBits[bucket] - 1)) ||
+                              dod >= (qint64{1} << (dodBits[bucket] - 1)))) {
+            ++bucket;
+        }
+        writer.write((quint64{1} << (bucket + 1)) - 1, bucket + 1);
+        if (bucket < 3) {
+            writer.write(0, 1);
+            writer.write(static_cast<quint64>(dod), dodBits[bucket]);
+        } else {
+            writer.write(static_cast<quint64>(dod), 64);
+        }
+    }
+
+    // Values: the first one as is, then the XOR with the previous value,
+    // reusing the previous window of meaningful bits when it fits
+    for (const auto& channel : values) {
+        quint64 previous{toBits(channel.front())};
+        int windowLead{-1};
+        int windowTrail{0};
+        writer.write(previous, 64);
+        for (int i{1}; i < count; ++i) {
+            const quint64 current{toBits(channel[i])};
+            const quint64 difference{current ^ previous};
+            previous = current;
+
+            if (difference == 0) {
+                writer.write(0, 1);
+                continue;
+            }
+            const int lead{static_cast<int>(qCountLeadingZeroBits(difference))};
+            const int trail{static_cast<int>(qCountTrailingZeroBits(difference))};
+            if (windowLead >= 0 && lead >= windowLead && trail >= windowTrail) {
+                writer.write(1, 2);
+                writer.write(difference >> windowTrail, 64 - windowLead - windowTrail);
+            } else {
+                const int length{64 - lead - trail};
+                writer.write(3, 2);
+                writer.write(static_cast<quint64>(lead), 6);
+                writer.write(static_cast<quint64>(length - 1), 6);
+                writer.write(difference >> trail, length);
+                windowLead = lead;
+                windowTrail = trail;
+            }
+        }
+    }
+    bits.shrink_to_fit();
+
+    // Envelope: the extremes of every bucket, plus the first and last
+    // sample so the key range is complete
+    for (int channel{0}; channel < static_cast<int>(values.size()); ++channel) {
+        const std::vector<Value>& channelValues{values[channel]};
+        std::vector<int> indices{0};
+        for (int begin{0}; begin < count; begin += bucketSize) {
+            const auto from{channelValues.begin() + begin};
+            const auto to{channelValues.begin() + std::min(count, begin + bucketSize)};
+            const auto extremes{std::minmax_element(from, to)};
+            indices.push_back(static_cast<int>(extremes.first - channelValues.begin()));
+            indices.push_back(static_cast<int>(extremes.second - channelValues.begin()));
+        }
+        indices.push_back(count - 1);
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+        std::vector<QCPGraphData>& envelope{envelopes[channel]};
+        envelope.reserve(indices.size());
+        for (int index : indices) {
+            envelope.push_back(QCPGraphData(keys[index], channelValues[index]));
+        }
+    }
+}
+
+quint64 SealedChunk::id() const
+{
+    return identifier;
+}
+
+int SealedChunk::size() const
+{
+    return count;
+}
+
+double SealedChunk::firstKey() const
+{
+    return first;
+}
+
+double SealedChunk::lastKey() const
+{
+    return last;
+}
+
+bool SealedChunk::decode(std::vector<double>& keys,
+                         std::vector<std::vector<Value>>& values) const
+{
+    std::vector<quint64> spilled;
+    if (spillFile) {
+        spilled.resize(spillWords);
+        const qint64 size{spillWords * static_cast<qint64>(sizeof(quint64))};
+        if (!spillFile->seek(filePosition) ||
+            spillFile->read(reinterpret_cast<char*>(spilled.data()), size) != size) {
+            return false;
+        }
+    }
+    BitReader reader{spillFile ? spilled : bits};
+
+    keys.resize(count);
+    quint64 key{reader.read(64)};
+    quint64 delta{0};
+    keys[0] = fromOrdered(key);
+    for (int i{1}; i < count; ++i) {
+        int bucket{0};
+        while (bucket < 4 && reader.read(1)) {
+            ++bucket;
+        }
+        if (bucket == 4) {
+            delta += reader.read(64);
+        } else if (bucket > 0) {
+            delta += static_cast<quint64>(reader.readSigned(dodBits[bucket - 1]));
+        }
+        key += delta << keyShift;
+        keys[i] = fromOrdered(key);
+    }
+
+    values.resize(envelopes.size());
+    for (auto& channel : values) {
+        channel.resize(count);
+        quint64 value{reader.read(64)};
+        int windowLead{0};
+        int windowTrail{0};
+        channel[0] = static_cast<Value>(fromBits(value));
+        for (int i{1}; i < count; ++i) {
+            if (reader.read(1)) {
+                if (reader.read(1)) {
+                    windowLead = static_cast<int>(reader.read(6));
+                    windowTrail = 64 - windowLead - static_cast<int>(reader.read(6)) - 1;
+                }
+                value ^= reader.read(64 - windowLead - windowTrail) << windowTrail;
+            }
+            channel[i] = static_cast<Value>(fromBits(value));
+        }
+    }
+
+    return true;
+}
+
+const std::vector<QCPGraphData>& SealedChunk::envelope(int channel) const
+{
+    return envelopes[channel];
+}
+
+bool SealedChunk::spill(const QSharedPointer<QFile>& file, qint64 offset)
+{
+    if (spillFile) {
+        return true;
+    }
+
+    const qint64 size{compressedSize()};
+    if (!file->seek(offset) ||
+        file->write(reinterpret_cast<const char*>(bits.data()), size) != size) {
+        return false;
+    }
+
+    spillFile = file;
+    filePosition = offset;
+    spillWords = static_cast<int>(bits.size());
+    std::vector<quint64>().swap(bits);
+
+    return true;
+}
+
+bool SealedChunk::isSpilled() const
+{
+    return !spillFile.isNull();
+}
+
+qint64 SealedChunk::compressedSize() const
+{
+    const std::size_t words{spillFile ? static_cast<std::size_t>(spillWords) : bits.size()};
+    return static_cast<qint64>(words * sizeof(quint64));
+}
+
+qint64 SealedChunk::spillOffset() const
+{
+    return filePosition;
+}
+
+std::size_t SealedChunk::memoryUsage() const
+{
+    std::size_t bytes{sizeof(*this) + bits.capacity() * sizeof(quint64)};
+    for (const auto& envelope : envelopes) {
+        bytes += sizeof(envelope) + envelope.capacity() * sizeof(QCPGraphData);
+    }
+
+    return bytes;
+}
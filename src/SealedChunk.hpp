@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#ifndef SEALEDCHUNK_HPP
+#define SEALEDCHUNK_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include <QFile>
+#include <QtGlobal>
+#include <QSharedPointer>
+
+#include "../qcustomplot/qcustomplot.h"
+
+// A compressed, immutable run of samples of several channels. Timestamps
+// are stored as delta-of-deltas and values as the XOR with the previous
+// value of their channel (like Gorilla), which makes regular timestamps
+// cost a bit or two and slowly changing values a few bits per sample.
+//
+// Besides the compressed samples, the chunk keeps the minimum and maximum
+// of every bucket of samples per channel, which is enough to draw the chunk
+// when the plot shows many samples per pixel.
+//
+// To save memory, the compressed samples can be moved to a file. The
+// envelopes always stay in memory.
+class SealedChunk
+{
+public:
+    using Value = decltype(QCPGraphData::value);
+
+    // Samples per bucket of the envelope
+    static constexpr int bucketSize{64};
+
+    SealedChunk(quint64 id,
+                const std::vector<double>& keys,
+                const std::vector<std::vector<Value>>& values);
+
+    quint64 id() const;
+    int size() const;
+    double firstKey() const;
+    double lastKey() const;
+
+    // Returns false if the spilled samples couldn't be read back, and
+    // leaves `keys` and `values` as they are then
+    bool decode(std::vector<double>& keys,
+                std::vector<std::vector<Value>>& values) const;
+
+    // The first and last sample and the minimum and maximum of every bucket,
+    // in key order
+    const std::vector<QCPGraphData>& envelope(int channel) const;
+
+    // Writes the compressed samples to `file` at `offset` and frees them,
+    // returns false if they couldn't be written. They are read back from
+    // the file for every decode().
+    bool spill(const QSharedPointer<QFile>& file, qint64 offset);
+    bool isSpilled() const;
+
+    // Bytes taken up by the compressed samples, in memory or in the file,
+    // and where they are in the file
+    qint64 compressedSize() const;
+    qint64 spillOffset() const;
+
+    std::size_t memoryUsage() const;
+
+private:
+    quint64 identifier;
+    int count;
+    double first;
+    double last;
+    int keyShift;
+    std::vector<quint64> bits;
+    QSharedPointer<QFile> spillFile;
+    qint64 filePosition;
+    int spillWords;
+    std::vector<std::vector<QCPGraphData>> envelopes;
+};
+
+#endif
@@ -11,6 +11,11 @@
 
 int main(int argc, char** argv)
 {
+    // Pack the sample blocks into huge pages. The allocator has to outlive
+    // every container, so it's created first.
+    QCPHugePageAllocator allocator;
+    QCPBlockAllocator::setInstance(&allocator);
+
     QApplication app(argc, argv);
     Birdview birdview;
     birdview.show();
@@ -0,0 +1,2 @@
+TEMPLATE = subdirs
+SUBDIRS = birdcage compactgraphdata graphsampling replotallocations
@@ -0,0 +1,6 @@
+TARGET = tst_birdcage
+CONFIG += testcase
+include(../../tests.pri)
+
+HEADERS += ../../../src/Birdcage.hpp ../../../src/SealedChunk.hpp
+SOURCES += tst_birdcage.cpp ../../../src/Birdcage.cpp ../../../src/SealedChunk.cpp
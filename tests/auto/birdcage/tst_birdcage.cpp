@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <QtTest>
+#include <QTemporaryFile>
+
+#include "Birdcage.hpp"
+#include "SealedChunk.hpp"
+
+// Checks that samples come back from the cold tier exactly as they went in:
+// through the codec of the sealed chunks, after spilling them to a file,
+// after merging late samples into them, and through forEach() and the view
+// across both tiers.
+class BirdcageTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void spilledRoundTrip();
+    void lateSamples();
+    void reclaimAndSpill();
+};
+
+namespace
+{
+
+using Value = Birdcage::Value;
+
+const int channelCount{3};
+
+// Enough samples in order to seal eight chunks
+const int sampleCount{Birdcage::hotSize + 8 * Birdcage::chunkSize + 1000};
+
+double fromBits(quint64 bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+quint64 toBits(double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Compares the bits, so that NaN, -0 and +0 have to come back as they were
+template <typename T>
+bool sameBits(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+// Values with every special case, values that change slowly, and a
+// constant, so all paths of the XOR encoding are taken
+std::vector<std::vector<Value>> makeValues(int count, std::mt19937& generator)
+{
+    const Value specials[]{std::numeric_limits<Value>::quiet_NaN(),
+                           Value{0},
+                           -Value{0},
+                           std::numeric_limits<Value>::infinity(),
+                           -std::numeric_limits<Value>::infinity(),
+                           std::numeric_limits<Value>::max(),
+                           std::numeric_limits<Value>::lowest(),
+                           std::numeric_limits<Value>::denorm_min(),
+                           Value{1},
+                           Value{1}};
+    std::uniform_real_distribution<double> random{-1000, 1000};
+    std::vector<std::vector<Value>> values(channelCount, std::vector<Value>(count));
+    for (int i{0}; i < count; ++i) {
+        values[0][i] = i % 3 == 0 ? specials[i / 3 % 10] : static_cast<Value>(random(generator));
+        values[1][i] = static_cast<Value>(std::sin(i * 1e-3));
+        values[2][i] = Value{42};
+    }
+
+    return values;
+}
+
+void checkRoundTrip(const SealedChunk& chunk,
+                    const std::vector<double>& keys,
+                    const std::vector<std::vector<Value>>& values)
+{
+    std::vector<double> decodedKeys;
+    std::vector<std::vector<Value>> decodedValues;
+    QVERIFY(chunk.decode(decodedKeys, decodedValues));
+    QCOMPARE(chunk.size(), static_cast<int>(keys.size()));
+    QVERIFY(sameBits(decodedKeys, keys));
+    QCOMPARE(decodedValues.size(), values.size());
+    for (std::size_t channel{0}; channel < values.size(); ++channel) {
+        QVERIFY(sameBits(decodedValues[channel], values[channel]));
+    }
+}
+
+// Keys with delta-of-deltas on both sides of every bucket boundary, one
+// that needs the 64 bit escape, and irregular deltas. The keys are built
+// from their bits, so the deltas are exact. The odd base delta keeps all
+// bits of the deltas.
+std::vector<double> makeBoundaryKeys(std::mt19937& generator)
+{
+    std::vector<qint64> deltaOfDeltas;
+    for (qint64 boundary : {qint64{64}, qint64{2048}, qint64{524288}}) {
+        for (qint64 dod : {boundary - 1, boundary, -boundary, -boundary - 1}) {
+            deltaOfDeltas.push_back(dod);
+        }
+    }
+    deltaOfDeltas.push_back(qint64{1} << 40);
+    deltaOfDeltas.push_back(-(qint64{1} << 40));
+
+    const quint64 baseDelta{(quint64{1} << 41) + 1};
+    quint64 bits{toBits(1.0)};
+    std::vector<double> keys{fromBits(bits)};
+    for (qint64 dod : deltaOfDeltas) {
+        // The delta of the next key goes back to the base, which makes the
+        // negated delta-of-delta as well
+        bits += baseDelta + static_cast<quint64>(dod);
+        keys.push_back(fromBits(bits));
+        bits += baseDelta;
+        keys.push_back(fromBits(bits));
+    }
+
+    std::uniform_int_distribution<quint64> random{0, quint64{1} << 30};
+    for (int i{0}; i < 1000; ++i) {
+        bits += i % 50 == 0 ? 0 : random(generator);
+        keys.push_back(fromBits(bits));
+    }
+
+    return keys;
+}
+
+// Samples in the order Birdcage keeps them: by key, and in the order they
+// were added for equal keys
+struct Sample
+{
+    double key;
+    std::vector<Value> values;
+};
+
+class Feed
+{
+public:
+    explicit Feed(Birdcage& birdcage) :
+        birdcage(birdcage),
+        generator{11},
+        random{0, 1},
+        inOrder{0},
+        count{0}
+    {
+    }
+
+    void add(double key)
+    {
+        // The key as the container stores it, so that it compares equal
+        // after the round trip through either tier. The container keeps
+        // keys as float offsets from a base per block, which holds keys on a
+        // binary grid exactly, and may round others differently depending
+        // on their block
+        key = QCPGraphData(std::ldexp(std::round(std::ldexp(key, 12)), -12), 0).key;
+        const std::vector<Value> values{static_cast<Value>(std::sin(key)),
+                                        static_cast<Value>(random(generator)),
+                                        static_cast<Value>(count++)};
+        birdcage.add(key, {values[0], values[1], values[2]});
+        const auto position{std::upper_bound(samples.begin(), samples.end(), key,
+                                             [](double key, const Sample& sample) {
+                                                 return key < sample.key;
+                                             })};
+        samples.insert(position, Sample{key, values});
+    }
+
+    // In order, a hundredth apart with some jitter
+    void addInOrder(int count)
+    {
+        for (int i{0}; i < count; ++i, ++inOrder) {
+            add(inOrder * 0.01 + random(generator) * 0.005);
+        }
+    }
+
+    // Anywhere before `before`
+    void addLate(int count, double before)
+    {
+        for (int i{0}; i < count; ++i) {
+            add(random(generator) * before);
+        }
+    }
+
+    Birdcage& birdcage;
+    std::vector<Sample> samples;
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> random;
+    int inOrder;
+    int count;
+};
+
+void checkForEach(const Birdcage& birdcage, const std::vector<Sample>& expected)
+{
+    std::vector<Sample> visited;
+    const bool complete{birdcage.forEach([&](double key, const std::vector<double>& values) {
+        visited.push_back(Sample{key, std::vector<Value>(values.begin(), values.end())});
+    })};
+    QVERIFY(complete);
+    QCOMPARE(birdcage.size(), static_cast<int>(expected.size()));
+    QCOMPARE(visited.size(), expected.size());
+    for (std::size_t i{0}; i < visited.size(); ++i) {
+        QVERIFY(visited[i].key == expected[i].key);
+        QVERIFY(visited[i].values == expected[i].values);
+    }
+}
+
+// The viewport has few samples per pixel, so the view holds the
+// decompressed samples of the chunks there
+void checkView(Birdcage& birdcage, int channel, const QCPRange& range, const std::vector<Sample>& expected)
+{
+    const QSharedPointer<QCPGraphDataContainer> data{birdcage.view(channel)};
+    std::vector<QCPGraphData> viewed;
+    for (auto it{data->findBegin(range.lower, false)}; it != data->findEnd(range.upper, false); ++it) {
+        viewed.push_back(*it);
+    }
+    std::vector<QCPGraphData> wanted;
+    for (const Sample& sample : expected) {
+        if (sample.key >= range.lower && sample.key <= range.upper) {
+            wanted.push_back(QCPGraphData(sample.key, sample.values[channel]));
+        }
+    }
+    QVERIFY(!wanted.empty());
+    QCOMPARE(viewed.size(), wanted.size());
+    for (std::size_t i{0}; i < viewed.size(); ++i) {
+        QVERIFY(viewed[i].key == wanted[i].key);
+        QCOMPARE(viewed[i].value, wanted[i].value);
+    }
+}
+
+} // namespace
+
+void BirdcageTest::roundTrip()
+{
+    std::mt19937 generator{7};
+    const std::vector<double> boundaryKeys{makeBoundaryKeys(generator)};
+    const std::vector<std::vector<Value>> boundaryValues{makeValues(static_cast<int>(boundaryKeys.size()), generator)};
+    checkRoundTrip(SealedChunk{0, boundaryKeys, boundaryValues}, boundaryKeys, boundaryValues);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    // Keys from -1 to 1 with irregular deltas, including both zeros
+    std::uniform_real_distribution<double> random{0, 1};
+    std::vector<double> signedKeys{-1};
+    while (signedKeys.back() < -1e-3) {
+        signedKeys.push_back(signedKeys.back() + random(generator) * 1e-3);
+    }
+    signedKeys.push_back(-0.0);
+    signedKeys.push_back(0.0);
+    while (signedKeys.back() < 1) {
+        signedKeys.push_back(signedKeys.back() + std::pow(random(generator), 4) * 1e-2);
+    }
+    const std::vector<std::vector<Value>> signedValues{makeValues(static_cast<int>(signedKeys.size()), generator)};
+    checkRoundTrip(SealedChunk{1, signedKeys, signedValues}, signedKeys, signedValues);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    // Keys that were floats, whose deltas share trailing zero bits
+    std::vector<double> floatKeys;
+    for (int i{0}; i < 4096; ++i) {
+        floatKeys.push_back(static_cast<float>(1000 + i * 0.01 + (i % 100 == 0 ? i * 0.1 : 0)));
+    }
+    std::sort(floatKeys.begin(), floatKeys.end());
+    const std::vector<std::vector<Value>> floatValues{makeValues(static_cast<int>(floatKeys.size()), generator)};
+    checkRoundTrip(SealedChunk{2, floatKeys, floatValues}, floatKeys, floatValues);
+}
+
+void BirdcageTest::spilledRoundTrip()
+{
+    std::mt19937 generator{7};
+    const std::vector<double> keys{makeBoundaryKeys(generator)};
+    const std::vector<std::vector<Value>> values{makeValues(static_cast<int>(keys.size()), generator)};
+    std::vector<double> otherKeys(keys);
+    for (double& key : otherKeys) {
+        key = -key;
+    }
+    std::reverse(otherKeys.begin(), otherKeys.end());
+    const std::vector<std::vector<Value>> otherValues{makeValues(static_cast<int>(otherKeys.size()), generator)};
+
+    // Both chunks in one file, the first one not at its start
+    const QSharedPointer<QTemporaryFile> file{QSharedPointer<QTemporaryFile>::create()};
+    QVERIFY(file->open());
+    SealedChunk chunk{0, keys, values};
+    SealedChunk other{1, otherKeys, otherValues};
+    const qint64 compressedSize{chunk.compressedSize()};
+    const std::size_t memoryUsage{chunk.memoryUsage()};
+    QVERIFY(chunk.spill(file, 8));
+    QVERIFY(other.spill(file, 8 + compressedSize));
+    QVERIFY(chunk.isSpilled());
+    QCOMPARE(chunk.compressedSize(), compressedSize);
+    QCOMPARE(chunk.spillOffset(), qint64{8});
+    QVERIFY(chunk.memoryUsage() < memoryUsage);
+
+    checkRoundTrip(chunk, keys, values);
+    checkRoundTrip(other, otherKeys, otherValues);
+}
+
+void BirdcageTest::lateSamples()
+{
+    Birdcage birdcage{channelCount};
+    Feed feed{birdcage};
+    feed.addInOrder(sampleCount);
+    const double coldEnd{8 * Birdcage::chunkSize * 0.01};
+
+    // Two batches of late samples, which are merged into their chunks
+    feed.addLate(2048, coldEnd);
+    checkForEach(birdcage, feed.samples);
+    const QCPRange range{100, 110};
+    birdcage.setViewport(range, 1000);
+    checkView(birdcage, 0, range, feed.samples);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    // Late samples that aren't merged yet come after the cold samples with
+    // the same key, and the hot samples follow
+    feed.addLate(500, coldEnd);
+    checkForEach(birdcage, feed.samples);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+    feed.addInOrder(1000);
+    checkForEach(birdcage, feed.samples);
+}
+
+void BirdcageTest::reclaimAndSpill()
+{
+    Birdcage birdcage{channelCount};
+    Feed feed{birdcage};
+    feed.addInOrder(sampleCount);
+    const double coldEnd{8 * Birdcage::chunkSize * 0.01};
+    feed.addLate(1024, coldEnd);
+    const QCPRange range{100, 110};
+    birdcage.setViewport(range, 1000);
+
+    // All chunks go to the file, and the decompressed ones are dropped, so
+    // they are read back from the file
+    const std::size_t all{std::numeric_limits<std::size_t>::max()};
+    QVERIFY(birdcage.reclaim(MemoryBudget::Spill, all) > 0);
+    QVERIFY(birdcage.reclaim(MemoryBudget::Rebuild, all) > 0);
+    checkForEach(birdcage, feed.samples);
+    checkView(birdcage, 1, range, feed.samples);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    // Merging decodes the spilled chunks, and compresses them again
+    feed.addLate(1024, coldEnd);
+    checkForEach(birdcage, feed.samples);
+    checkView(birdcage, 2, range, feed.samples);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    QVERIFY(birdcage.reclaim(MemoryBudget::Spill, all) > 0);
+    checkView(birdcage, 0, range, feed.samples);
+}
+
+QTEST_APPLESS_MAIN(BirdcageTest)
+
+#include "tst_birdcage.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_compactgraphdata
+CONFIG += testcase
+include(../../tests.pri)
+
+SOURCES += tst_compactgraphdata.cpp
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <QtTest>
+
+#include "qcustomplot.h"
+
+// Checks the size and the precision of the graph data with
+// QCUSTOMPLOT_COMPACT_GRAPH_DATA and QCUSTOMPLOT_USE_BLOCK_STORAGE, where the
+// container keeps the keys as float offsets from a base per block, at the
+// key magnitudes Birdview sees: timestamps in seconds since epoch, and
+// seconds since the start of a session.
+class CompactGraphData : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void size();
+    void epochKeys();
+    void sessionKeys();
+    void exactKeys();
+    void keyOrder();
+    void lookups();
+    void edits();
+    void values();
+    void specialKeys();
+};
+
+namespace
+{
+
+const double epoch{1.7e9};
+const int blockSize{QCPDataBlockStorage<QCPGraphData>::blockSize};
+
+// The error a key may have in a block whose keys span `blockSpan`: the
+// resolution of a float offset from the base, which is the first key of the
+// block rounded down by about 2^-36 of its magnitude, plus the rounding of
+// the double that is returned
+double keyTolerance(double key, double blockSpan)
+{
+    const double ulp{std::nextafter(std::abs(key), std::numeric_limits<double>::infinity()) - std::abs(key)};
+    return std::ldexp(blockSpan + std::ldexp(std::abs(key), -35), -23) + 2 * ulp;
+}
+
+// Returns whether all keys from `origin` to `origin + span` are within the
+// tolerance after a round trip through a container, and never larger than
+// the original keys
+bool checkKeys(double origin, double span, double step)
+{
+    QVector<QCPGraphData> data;
+    for (double offset{0}; offset < span; offset += step) {
+        data.append(QCPGraphData(origin + offset, 0));
+    }
+    QCPGraphDataContainer container;
+    container.set(data, true);
+    double worst{0};
+    bool ok{container.size() == data.size()};
+    auto it{container.constBegin()};
+    for (int i{0}; ok && i < data.size(); ++i, ++it) {
+        const double key{data.at(i).key};
+        const double error{key - it->key};
+        if (error < 0 || error > keyTolerance(key, blockSize * step)) {
+            ok = false;
+        }
+        worst = std::max(worst, error);
+    }
+    qInfo("keys from %.0f to %.0f: worst error %g s", origin, origin + span, worst);
+
+    return ok;
+}
+
+// Returns whether the keys in `container` are in order and each is at most
+// `tolerance` below the corresponding key of `expected`
+bool matches(const QCPGraphDataContainer &container, std::vector<double> expected, double tolerance)
+{
+    std::sort(expected.begin(), expected.end());
+    if (container.size() != int(expected.size())) {
+        return false;
+    }
+    auto it{container.constBegin()};
+    for (std::size_t i{0}; i < expected.size(); ++i, ++it) {
+        const double error{expected[i] - it->key};
+        if (error < 0 || error > tolerance) {
+            return false;
+        }
+        if (it != container.constBegin() && (it - 1)->key > it->key) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void CompactGraphData::size()
+{
+    QCOMPARE(sizeof(QCPPackedGraphData), std::size_t{8});
+
+    // Full blocks take 8 bytes per data point, plus the block header and
+    // the block table entry
+    QVector<QCPGraphData> data;
+    for (int i{0}; i < 10 * blockSize; ++i) {
+        data.append(QCPGraphData(epoch + i * 0.001, i));
+    }
+    QCPGraphDataContainer container;
+    container.set(data, true);
+    QVERIFY(double(container.memoryUsage()) / container.size() < 8.05);
+}
+
+void CompactGraphData::epochKeys()
+{
+    // An hour at 1 kHz with an odd step, so the keys aren't round numbers
+    QVERIFY(checkKeys(epoch, 3600, 0.0010000003));
+    QVERIFY(keyTolerance(epoch + 3600, blockSize * 0.001) < 1e-6);
+}
+
+void CompactGraphData::sessionKeys()
+{
+    // A day at about 8 Hz, and microsecond timestamps over a second
+    QVERIFY(checkKeys(0, 86400, 0.123456789));
+    QVERIFY(checkKeys(0, 1, 0.000001));
+}
+
+void CompactGraphData::exactKeys()
+{
+    // Keys on a binary grid close to the base of their block are stored
+    // exactly, even at epoch timestamps
+    QVector<QCPGraphData> data;
+    for (int i{0}; i < 3 * blockSize; ++i) {
+        data.append(QCPGraphData(epoch + i / 1024.0, i));
+    }
+    QCPGraphDataContainer container;
+    container.set(data, true);
+    auto it{container.constBegin()};
+    for (int i{0}; i < data.size(); ++i, ++it) {
+        QCOMPARE(it->key, data.at(i).key);
+    }
+}
+
+void CompactGraphData::keyOrder()
+{
+    // Samples a microsecond apart stay distinct and in order, which absolute
+    // floats can't resolve at epoch timestamps
+    QCPGraphDataContainer container;
+    for (int i{0}; i < 10000; ++i) {
+        container.add(QCPGraphData(epoch + i * 1e-6, i));
+    }
+    QCOMPARE(container.size(), 10000);
+    int index{0};
+    for (auto it{container.constBegin()}; it != container.constEnd(); ++it, ++index) {
+        QCOMPARE(it->value, static_cast<float>(index));
+        if (it != container.constBegin()) {
+            QVERIFY((it - 1)->key < it->key);
+        }
+    }
+}
+
+void CompactGraphData::lookups()
+{
+    // Looking up or removing a key read back from the container finds that
+    // data point, even though encoding the key again may round it
+    QCPGraphDataContainer container;
+    for (int i{0}; i < 10000; ++i) {
+        container.add(QCPGraphData(epoch + i * 0.0010000003, i));
+    }
+    for (int i{0}; i < container.size(); ++i) {
+        const double key{(container.constBegin() + i)->key};
+        QCOMPARE(int(container.findBegin(key, false) - container.constBegin()), i);
+        QCOMPARE(int(container.findEnd(key, false) - container.constBegin()), i + 1);
+    }
+    const double removed{(container.constBegin() + 5000)->key};
+    container.remove(removed);
+    QCOMPARE(container.size(), 9999);
+    QVERIFY((container.constBegin() + 5000)->key > removed);
+}
+
+void CompactGraphData::edits()
+{
+    // Inserting, prepending, merging and removing move data points between
+    // blocks and bases, and they keep their order and precision
+    const double step{0.0010000003};
+    const double tolerance{keyTolerance(epoch, 4 * blockSize * step)};
+    std::vector<double> keys;
+    QCPGraphDataContainer container;
+    QVector<QCPGraphData> data;
+    for (int i{0}; i < 5 * blockSize; ++i) {
+        data.append(QCPGraphData(epoch + (i * 7919 % (5 * blockSize)) * step, i));
+        keys.push_back(data.last().key);
+    }
+    container.set(data);
+    QVERIFY(matches(container, keys, tolerance));
+
+    data.clear();
+    for (int i{0}; i < blockSize; ++i) {
+        data.append(QCPGraphData(epoch + (2 * blockSize + i + 0.5) * step, i));
+        keys.push_back(data.last().key);
+    }
+    container.add(data, true);
+    QVERIFY(matches(container, keys, tolerance));
+
+    data.clear();
+    for (int i{0}; i < 100; ++i) {
+        data.append(QCPGraphData(epoch - (i + 1) * step, i));
+        keys.push_back(data.last().key);
+    }
+    container.add(data);
+    QVERIFY(matches(container, keys, tolerance));
+
+    for (int i{0}; i < 50; ++i) {
+        container.add(QCPGraphData(epoch + (i * 397 % (5 * blockSize) + 0.25) * step, i));
+        keys.push_back(epoch + (i * 397 % (5 * blockSize) + 0.25) * step);
+    }
+    QVERIFY(matches(container, keys, tolerance));
+
+    // The bounds lie between keys, so rounding doesn't move keys across them
+    const double from{epoch + (blockSize + 0.1) * step};
+    const double to{epoch + (3.5 * blockSize + 0.1) * step};
+    container.remove(from, to);
+    keys.erase(std::remove_if(keys.begin(), keys.end(), [&](double key) { return key >= from && key < to; }), keys.end());
+    QVERIFY(matches(container, keys, tolerance));
+
+    // Moving the data points between blocks again and again doesn't add up
+    // their errors
+    for (int i{0}; i < 200; ++i) {
+        const double key{epoch + (100 + i + 0.75) * step};
+        container.add(QCPGraphData(key, i));
+        container.remove(key - 0.1 * step, key + 0.1 * step);
+    }
+    QVERIFY(matches(container, keys, tolerance));
+}
+
+void CompactGraphData::values()
+{
+    const double bound{std::ldexp(1.0, -24)};
+    for (double value{-1e6}; value < 1e6; value += 12.3456789) {
+        const QCPGraphData data(0, value);
+        QVERIFY(std::abs(data.value - value) <= bound * std::abs(value));
+    }
+}
+
+void CompactGraphData::specialKeys()
+{
+    const double infinity{std::numeric_limits<double>::infinity()};
+    QVERIFY(qIsNaN(QCPGraphData(qQNaN(), 0).key));
+    QVERIFY(qIsNaN(QCPPackedGraphData::keyOffset(epoch, qQNaN())));
+
+    // Infinite keys are kept, keys too far from the base for a float offset
+    // are rounded down to the largest one, and the keys between them aren't
+    // affected
+    QCPGraphDataContainer container;
+    container.add(QCPGraphData(-infinity, 1));
+    container.add(QCPGraphData(epoch, 2));
+    container.add(QCPGraphData(epoch + 1e300, 3));
+    container.add(QCPGraphData(infinity, 4));
+    QCOMPARE(container.size(), 4);
+    auto it{container.constBegin()};
+    QCOMPARE(it->key, -infinity);
+    QCOMPARE((++it)->key, epoch);
+    ++it;
+    QVERIFY(it->key >= std::numeric_limits<float>::max() && it->key < 1e300);
+    QCOMPARE((++it)->key, infinity);
+    QCOMPARE(it->value, 4.0f);
+}
+
+QTEST_APPLESS_MAIN(CompactGraphData)
+
+#include "tst_compactgraphdata.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_graphsampling
+CONFIG += testcase
+include(../../tests.pri)
+
+SOURCES += tst_graphsampling.cpp
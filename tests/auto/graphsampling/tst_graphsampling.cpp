@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <QtTest>
+
+#include "qcustomplot.h"
+
+// Measures the pixel error of the sampling strategies of QCPGraph against
+// the undecimated line. The lines are rasterized by the test, once with
+// every pixel the ideal line passes through and once with Bresenham's
+// algorithm, so the results don't depend on the paint engine. M4 has to
+// match the undecimated line exactly under both. The image QCustomPlot
+// renders without antialiasing is compared as well, for information.
+class GraphSampling : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void m4IsExact();
+    void lttbError();
+    void renderedError();
+    void m4Resume();
+    void adaptiveResume();
+    void parallelSampling();
+};
+
+namespace
+{
+
+const int width{640};
+const int height{480};
+const int pointCount{200000};
+const int offsetCount{20};
+
+// Enough data points for eight chunks of parallel sampling, which have at
+// least 1 << 17 data points each
+const int parallelPointCount{1 << 20};
+const int parallelThreadCount{8};
+
+// Gives access to the lines QCPGraph draws, in pixel coordinates
+class Graph : public QCPGraph
+{
+public:
+    using QCPGraph::QCPGraph;
+
+    QVector<QPointF> lines(bool fromScratch = false) const
+    {
+        if (fromScratch) {
+            mLineCache.valid = false;
+        }
+        QVector<QPointF> result;
+        getLines(&result, QCPDataRange(0, dataCount()));
+        return result;
+    }
+};
+
+class Plot
+{
+public:
+    Plot()
+    {
+        plot.axisRect()->setAutoMargins(QCP::msNone);
+        plot.axisRect()->setMargins(QMargins());
+        plot.setViewport(QRect(0, 0, width, height));
+        plot.setNotAntialiasedElements(QCP::aeAll);
+        graph = new Graph{plot.xAxis, plot.yAxis};
+        plot.yAxis->setRange(-2, 2);
+        plot.replot(); // lays out the axis rect
+    }
+
+    // Shows the keys from 0 to `span`, shifted by a fraction of a pixel
+    void setKeyRange(double span, double pixelOffset)
+    {
+        const double shift{pixelOffset * span / width};
+        plot.xAxis->setRange(-shift, span - shift);
+    }
+
+    QImage render()
+    {
+        QImage image{width, height, QImage::Format_ARGB32_Premultiplied};
+        image.fill(Qt::white);
+        {
+            QCPPainter painter{&image};
+            plot.toPainter(&painter, width, height);
+        }
+        return image;
+    }
+
+    QCustomPlot plot;
+    Graph* graph;
+};
+
+// The pixels a polyline covers
+class Raster
+{
+public:
+    Raster() :
+        pixels(width * height)
+    {
+    }
+
+    void draw(const QVector<QPointF>& lines, bool supercover)
+    {
+        for (int i{0}; i + 1 < lines.size(); ++i) {
+            const QPointF& a{lines.at(i)};
+            const QPointF& b{lines.at(i + 1)};
+            if (qIsNaN(a.x()) || qIsNaN(a.y()) || qIsNaN(b.x()) || qIsNaN(b.y())) {
+                continue;
+            }
+            if (supercover) {
+                drawSupercover(a, b);
+            } else {
+                drawBresenham(a, b);
+            }
+        }
+    }
+
+    int difference(const Raster& other) const
+    {
+        int count{0};
+        for (std::size_t i{0}; i < pixels.size(); ++i) {
+            count += pixels[i] != other.pixels[i];
+        }
+        return count;
+    }
+
+    int count() const
+    {
+        return static_cast<int>(std::count(pixels.begin(), pixels.end(), true));
+    }
+
+private:
+    void set(int x, int y)
+    {
+        if (x >= 0 && y >= 0 && x < width && y < height) {
+            pixels[y * width + x] = true;
+        }
+    }
+
+    // Every pixel the segment passes through, by stepping from one pixel
+    // border crossing to the next
+    void drawSupercover(const QPointF& a, const QPointF& b)
+    {
+        const double infinity{std::numeric_limits<double>::infinity()};
+        int x{static_cast<int>(std::floor(a.x()))};
+        int y{static_cast<int>(std::floor(a.y()))};
+        const int x1{static_cast<int>(std::floor(b.x()))};
+        const int y1{static_cast<int>(std::floor(b.y()))};
+        const double dx{b.x() - a.x()};
+        const double dy{b.y() - a.y()};
+        const double stepTimeX{dx != 0 ? 1 / std::abs(dx) : infinity};
+        const double stepTimeY{dy != 0 ? 1 / std::abs(dy) : infinity};
+        double timeX{dx > 0 ? (x + 1 - a.x()) * stepTimeX : dx < 0 ? (a.x() - x) * stepTimeX : infinity};
+        double timeY{dy > 0 ? (y + 1 - a.y()) * stepTimeY : dy < 0 ? (a.y() - y) * stepTimeY : infinity};
+        set(x, y);
+        for (int steps{std::abs(x1 - x) + std::abs(y1 - y)}; steps > 0; --steps) {
+            if (timeX < timeY) {
+                timeX += stepTimeX;
+                x += dx > 0 ? 1 : -1;
+            } else {
+                timeY += stepTimeY;
+                y += dy > 0 ? 1 : -1;
+            }
+            set(x, y);
+        }
+    }
+
+    void drawBresenham(const QPointF& a, const QPointF& b)
+    {
+        int x{static_cast<int>(std::floor(a.x()))};
+        int y{static_cast<int>(std::floor(a.y()))};
+        const int x1{static_cast<int>(std::floor(b.x()))};
+        const int y1{static_cast<int>(std::floor(b.y()))};
+        const int dx{std::abs(x1 - x)};
+        const int dy{-std::abs(y1 - y)};
+        const int stepX{x < x1 ? 1 : -1};
+        const int stepY{y < y1 ? 1 : -1};
+        int error{dx + dy};
+        for (;;) {
+            set(x, y);
+            if (x == x1 && y == y1) {
+                break;
+            }
+            const int doubled{2 * error};
+            if (doubled >= dy) {
+                error += dy;
+                x += stepX;
+            }
+            if (doubled <= dx) {
+                error += dx;
+                y += stepY;
+            }
+        }
+    }
+
+    std::vector<bool> pixels;
+};
+
+// A noisy sine, a random walk, and spikes on jittered keys
+void fill(QCPGraph* graph, int signal, std::mt19937& generator)
+{
+    std::uniform_real_distribution<double> random{0, 1};
+    QVector<double> keys(pointCount);
+    QVector<double> values(pointCount);
+    double walk{0};
+    for (int i{0}; i < pointCount; ++i) {
+        const double key{i * 0.5 + (signal == 2 ? random(generator) * 0.4 : 0)};
+        keys[i] = key;
+        if (signal == 0) {
+            values[i] = std::sin(key * 1e-3) + 0.2 * (random(generator) - 0.5);
+        } else if (signal == 1) {
+            walk += 0.02 * (random(generator) - 0.5);
+            values[i] = walk;
+        } else {
+            values[i] = std::sin(key * 3e-4) * (random(generator) < 0.0005 ? 1.8 : 0.5);
+        }
+    }
+    graph->setData(keys, values, true);
+}
+
+const char* strategyName(QCPGraph::SamplingStrategy strategy)
+{
+    switch (strategy) {
+    case QCPGraph::ssAdaptive:
+        return "adaptive";
+    case QCPGraph::ssM4:
+        return "M4";
+    case QCPGraph::ssLttb:
+        return "LTTB";
+    }
+
+    return "";
+}
+
+struct Error
+{
+    qint64 supercover;
+    qint64 bresenham;
+    qint64 points;
+    qint64 litPixels;
+};
+
+// The pixels in which the sampled lines differ from the undecimated ones,
+// summed over all signals and sub-pixel offsets of the key range
+Error measure(QCPGraph::SamplingStrategy strategy)
+{
+    Plot plot;
+    std::mt19937 generator{7};
+    Error error{0, 0, 0, 0};
+    for (int signal{0}; signal < 3; ++signal) {
+        fill(plot.graph, signal, generator);
+        for (int offset{0}; offset < offsetCount; ++offset) {
+            plot.setKeyRange(pointCount * 0.5, 0.5 * offset / offsetCount);
+
+            plot.graph->setAdaptiveSampling(false);
+            const QVector<QPointF> full{plot.graph->lines(true)};
+            plot.graph->setAdaptiveSampling(true);
+            plot.graph->setSamplingStrategy(strategy);
+            const QVector<QPointF> sampled{plot.graph->lines(true)};
+
+            for (bool supercover : {true, false}) {
+                Raster expected;
+                Raster actual;
+                expected.draw(full, supercover);
+                actual.draw(sampled, supercover);
+                (supercover ? error.supercover : error.bresenham) += expected.difference(actual);
+                if (supercover) {
+                    error.litPixels += expected.count();
+                }
+            }
+            error.points += sampled.size();
+        }
+    }
+    qInfo("%s: %lld line points, %lld of %lld lit pixels differ with supercover, %lld with Bresenham",
+          strategyName(strategy), error.points, error.supercover, error.litPixels, error.bresenham);
+
+    return error;
+}
+
+void compareLines(const QVector<QPointF>& actual, const QVector<QPointF>& expected)
+{
+    QCOMPARE(actual.size(), expected.size());
+    for (int i{0}; i < actual.size(); ++i) {
+        QVERIFY(std::memcmp(&actual.at(i), &expected.at(i), sizeof(QPointF)) == 0);
+    }
+}
+
+// Data is appended in every frame, and the line cache only samples the new
+// data points. The result has to be the same as sampling all data. With a
+// key span limit, data points are removed from the front as well.
+void checkResume(QCPGraph::SamplingStrategy strategy, const QCPRange& keyRange, double keySpanLimit, bool pyramidIndex)
+{
+    Plot plot;
+    Graph* reference{new Graph{plot.plot.xAxis, plot.plot.yAxis}};
+    reference->setData(plot.graph->data());
+    plot.graph->setSamplingStrategy(strategy);
+    reference->setSamplingStrategy(strategy);
+    plot.graph->data()->setKeySpanLimit(keySpanLimit);
+    plot.graph->data()->setPyramidIndex(pyramidIndex);
+    plot.plot.xAxis->setRange(keyRange);
+
+    std::mt19937 generator{3};
+    std::uniform_real_distribution<double> random{0, 1};
+    double key{0};
+    for (int frame{0}; frame < 100; ++frame) {
+        const int added{frame == 0 ? 5000 : (frame % 17 == 0 ? 20000 : static_cast<int>(random(generator) * 400))};
+        for (int i{0}; i < added; ++i) {
+            key += random(generator) < 0.002 ? 300 * random(generator) : random(generator) * 0.4;
+            const double value{random(generator) < 0.001 ? qQNaN() : std::sin(key * 0.01) + 0.3 * random(generator)};
+            plot.graph->addData(key, value);
+        }
+        compareLines(plot.graph->lines(), reference->lines(true));
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
+void GraphSampling::m4IsExact()
+{
+    const Error m4{measure(QCPGraph::ssM4)};
+    QCOMPARE(m4.supercover, qint64{0});
+    QCOMPARE(m4.bresenham, qint64{0});
+
+    // For comparison, adaptive sampling moves the extremes within a pixel
+    measure(QCPGraph::ssAdaptive);
+}
+
+void GraphSampling::lttbError()
+{
+    // LTTB trades narrow extremes for about one point per pixel, so it
+    // isn't exact, but it has far fewer points than M4
+    const Error m4{measure(QCPGraph::ssM4)};
+    const Error lttb{measure(QCPGraph::ssLttb)};
+    QVERIFY(lttb.points * 2 < m4.points);
+    QVERIFY(lttb.points <= qint64{3} * offsetCount * (width + 2));
+    QVERIFY(lttb.supercover < lttb.litPixels);
+}
+
+void GraphSampling::renderedError()
+{
+    Plot plot;
+    std::mt19937 generator{7};
+    for (int signal{0}; signal < 3; ++signal) {
+        fill(plot.graph, signal, generator);
+        plot.setKeyRange(pointCount * 0.5, 0);
+        plot.graph->setAdaptiveSampling(false);
+        const QImage full{plot.render()};
+        plot.graph->setAdaptiveSampling(true);
+
+        for (auto strategy : {QCPGraph::ssAdaptive, QCPGraph::ssM4, QCPGraph::ssLttb}) {
+            plot.graph->setSamplingStrategy(strategy);
+            const QImage sampled{plot.render()};
+            QCOMPARE(sampled.size(), full.size());
+            int difference{0};
+            for (int y{0}; y < height; ++y) {
+                const QRgb* expected{reinterpret_cast<const QRgb*>(full.constScanLine(y))};
+                const QRgb* actual{reinterpret_cast<const QRgb*>(sampled.constScanLine(y))};
+                for (int x{0}; x < width; ++x) {
+                    difference += expected[x] != actual[x];
+                }
+            }
+            qInfo("signal %d, %s: %d pixels of the rendered image differ", signal,
+                  strategyName(strategy), difference);
+        }
+    }
+}
+
+void GraphSampling::m4Resume()
+{
+    checkResume(QCPGraph::ssM4, QCPRange(0, 40000), 0, false);
+}
+
+void GraphSampling::adaptiveResume()
+{
+    // Sampled point by point, or with the pyramid index, which jumps over
+    // pixels with many data points. Either way, the line cache resumes
+    // point by point. The data points the key span limit removes are first
+    // outside the key range, and later inside it.
+    for (bool pyramidIndex : {false, true}) {
+        checkResume(QCPGraph::ssAdaptive, QCPRange(0, 40000), 0, pyramidIndex);
+        checkResume(QCPGraph::ssAdaptive, QCPRange(10000, 50000), 45000, pyramidIndex);
+    }
+}
+
+void GraphSampling::parallelSampling()
+{
+    // The chunks are sampled on their own, and stitched together where the
+    // serial algorithm continues. The data is meant to throw chunks out of
+    // step with it: the first data point of every pixel is on its border,
+    // where rounding decides whether it still belongs to the interval of the
+    // previous pixel, and is an extreme value, so that this shows. Bursts of
+    // data points in one pixel span several chunks, and NaN values are gaps.
+    // On a logarithmic axis, the pixel width changes with every pixel.
+    QThreadPool* pool{QThreadPool::globalInstance()};
+    const int maxThreadCount{pool->maxThreadCount()};
+    Plot plot;
+    QCPAxis* keyAxis{plot.plot.xAxis};
+    std::mt19937 generator{5};
+    std::uniform_real_distribution<double> random{0, 1};
+    for (int signal{0}; signal < 3; ++signal) {
+        for (auto scaleType : {QCPAxis::stLinear, QCPAxis::stLogarithmic}) {
+            keyAxis->setScaleType(scaleType);
+            keyAxis->setRange(0.1, 1000.3);
+            QVector<double> keys(parallelPointCount);
+            QVector<double> values(parallelPointCount);
+            double key{0.1};
+            for (int i{0}; i < parallelPointCount; ++i) {
+                double value{random(generator) < 0.001 ? qQNaN() : std::sin(key) + 0.2 * random(generator)};
+                if (signal == 0) {
+                    key += random(generator) < 0.0001 ? 0.05 : random(generator) * 0.9e-3;
+                } else if (signal == 1) {
+                    const int pixel{static_cast<int>(static_cast<qint64>(i) * width / parallelPointCount)};
+                    const double border{keyAxis->pixelToCoord(pixel)};
+                    if (i == 0 || static_cast<int>(static_cast<qint64>(i - 1) * width / parallelPointCount) != pixel) {
+                        key = border;
+                        value = -1.5;
+                    } else {
+                        key = std::max(key, border + (keyAxis->pixelToCoord(pixel + 1) - border) * random(generator));
+                    }
+                } else {
+                    key += i % 400000 < 100000 ? 3e-3 : 3e-10;
+                }
+                keys[i] = key;
+                values[i] = value;
+            }
+            plot.graph->setData(keys, values, true);
+
+            pool->setMaxThreadCount(1);
+            const QVector<QPointF> serial{plot.graph->lines(true)};
+            pool->setMaxThreadCount(parallelThreadCount);
+            const QVector<QPointF> parallel{plot.graph->lines(true)};
+            pool->setMaxThreadCount(maxThreadCount);
+            compareLines(parallel, serial);
+            if (QTest::currentTestFailed()) {
+                return;
+            }
+        }
+    }
+}
+
+QTEST_MAIN(GraphSampling)
+
+#include "tst_graphsampling.moc"
@@ -0,0 +1,5 @@
+TARGET = tst_replotallocations
+CONFIG += testcase
+include(../../tests.pri)
+
+SOURCES += tst_replotallocations.cpp
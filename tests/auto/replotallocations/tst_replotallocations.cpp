@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+#include <QtTest>
+#include <QPaintEngine>
+
+#include "qcustomplot.h"
+
+// Counts the heap allocations QCPGraph makes while drawing a live plot, in
+// which data points are appended and the key axis scrolls with them. After
+// a warm-up, in which the graph's buffers grow to the size they need, no
+// replot may allocate. The graph draws with a paint engine that does
+// nothing, so the allocations of Qt's own paint engines aren't counted.
+class ReplotAllocations : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void adaptiveSampling();
+    void parallelSampling();
+    void m4();
+    void lttb();
+    void withoutSampling();
+    void scatters();
+};
+
+namespace
+{
+
+std::atomic<bool> counting{false};
+std::atomic<long> allocations{0};
+
+void countAllocation()
+{
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+#ifdef __GLIBC__
+// Qt's containers allocate with malloc instead of operator new, so with
+// glibc, the C allocation functions are counted as well
+extern "C" void* __libc_malloc(std::size_t size);
+extern "C" void* __libc_calloc(std::size_t count, std::size_t size);
+extern "C" void* __libc_realloc(void* pointer, std::size_t size);
+extern "C" void __libc_free(void* pointer);
+
+extern "C" void* malloc(std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(std::size_t count, std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, std::size_t size) noexcept
+{
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+namespace
+{
+
+void* allocate(std::size_t size)
+{
+    return __libc_malloc(size == 0 ? 1 : size);
+}
+
+void deallocate(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+} // namespace
+#else
+namespace
+{
+
+void* allocate(std::size_t size)
+{
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void deallocate(void* pointer)
+{
+    std::free(pointer);
+}
+
+} // namespace
+#endif
+
+void* operator new(std::size_t size)
+{
+    countAllocation();
+    if (void* pointer = allocate(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    deallocate(pointer);
+}
+
+namespace
+{
+
+const int width{1000};
+const int height{600};
+const double keySpan{100000};
+const int pointsPerFrame{200};
+const int warmUpFrames{50};
+const int frameCount{200};
+
+// Enough data points for QCPGraph to sample them in four chunks on as many
+// threads, with chunks of at least 1 << 17 data points
+const double parallelKeySpan{1 << 19};
+const int parallelChunkCount{4};
+
+// Accepts everything and draws nothing
+class NullPaintEngine : public QPaintEngine
+{
+public:
+    NullPaintEngine() :
+        QPaintEngine{QPaintEngine::AllFeatures}
+    {
+    }
+
+    bool begin(QPaintDevice*) override
+    {
+        return true;
+    }
+
+    bool end() override
+    {
+        return true;
+    }
+
+    void updateState(const QPaintEngineState&) override
+    {
+    }
+
+    void drawPixmap(const QRectF&, const QPixmap&, const QRectF&) override
+    {
+    }
+
+    void drawPolygon(const QPointF*, int, PolygonDrawMode) override
+    {
+    }
+
+    void drawLines(const QLineF*, int) override
+    {
+    }
+
+    void drawEllipse(const QRectF&) override
+    {
+    }
+
+    Type type() const override
+    {
+        return QPaintEngine::User;
+    }
+};
+
+class NullPaintDevice : public QPaintDevice
+{
+public:
+    QPaintEngine* paintEngine() const override
+    {
+        return &engine;
+    }
+
+protected:
+    int metric(PaintDeviceMetric metric) const override
+    {
+        switch (metric) {
+        case PdmWidth:
+            return width;
+        case PdmHeight:
+            return height;
+        case PdmWidthMM:
+            return width * 254 / 960;
+        case PdmHeightMM:
+            return height * 254 / 960;
+        case PdmNumColors:
+            return 0;
+        case PdmDepth:
+            return 32;
+        case PdmDpiX:
+        case PdmDpiY:
+        case PdmPhysicalDpiX:
+        case PdmPhysicalDpiY:
+            return 96;
+        default:
+            return QPaintDevice::metric(metric);
+        }
+    }
+
+private:
+    mutable NullPaintEngine engine;
+};
+
+class Graph : public QCPGraph
+{
+public:
+    using QCPGraph::QCPGraph;
+
+    void drawTo(QCPPainter* painter)
+    {
+        draw(painter);
+    }
+};
+
+double signal(double key)
+{
+    return std::sin(key * 0.0314) + 0.3 * std::sin(key * 2.1);
+}
+
+// Streams data into the graph and returns the number of allocations in the
+// replots after the warm-up. The key axis either scrolls with the data, or
+// stays where it is while the old data points are removed. The graph holds
+// the data points of `span` keys.
+long replotAllocations(const std::function<void(QCPGraph*)>& setup, bool scrolling, double span = keySpan)
+{
+    QCustomPlot plot;
+    plot.axisRect()->setAutoMargins(QCP::msNone);
+    plot.axisRect()->setMargins(QMargins());
+    plot.setViewport(QRect(0, 0, width, height));
+    Graph* graph{new Graph{plot.xAxis, plot.yAxis}};
+    setup(graph);
+    graph->data()->setKeySpanLimit(span);
+    plot.xAxis->setRange(0, span);
+    plot.yAxis->setRange(-2, 2);
+    plot.replot(); // lays out the axis rect
+
+    double key{0};
+    for (; key < span; ++key) {
+        graph->addData(key, signal(key));
+    }
+
+    NullPaintDevice device;
+    QCPPainter painter{&device};
+    long steadyAllocations{0};
+    for (int frame{0}; frame < warmUpFrames + frameCount; ++frame) {
+        for (int i{0}; i < pointsPerFrame; ++i, ++key) {
+            graph->addData(key, signal(key));
+        }
+        if (scrolling) {
+            plot.xAxis->setRange(key - span, key);
+        }
+
+        allocations = 0;
+        counting = true;
+        graph->drawTo(&painter);
+        counting = false;
+        if (frame >= warmUpFrames) {
+            steadyAllocations += allocations;
+        }
+    }
+
+    return steadyAllocations;
+}
+
+} // namespace
+
+void ReplotAllocations::adaptiveSampling()
+{
+    const auto setup = [](QCPGraph* graph) {
+        graph->setSamplingStrategy(QCPGraph::ssAdaptive);
+    };
+    QCOMPARE(replotAllocations(setup, true), 0L);
+    QCOMPARE(replotAllocations(setup, false), 0L);
+}
+
+void ReplotAllocations::parallelSampling()
+{
+    QThreadPool* pool{QThreadPool::globalInstance()};
+    const int maxThreadCount{pool->maxThreadCount()};
+    pool->setMaxThreadCount(parallelChunkCount);
+
+    // Every replot samples all data points again while the axis scrolls.
+    // The chunks are reused, but QThreadPool may allocate a part of its
+    // queue whenever one of them is started.
+    const auto setup = [](QCPGraph* graph) {
+        graph->setSamplingStrategy(QCPGraph::ssAdaptive);
+    };
+    const long poolAllocations{static_cast<long>(frameCount) * (parallelChunkCount - 1)};
+    const long allocations{replotAllocations(setup, true, parallelKeySpan)};
+    pool->setMaxThreadCount(maxThreadCount);
+    QVERIFY(allocations <= poolAllocations);
+}
+
+void ReplotAllocations::m4()
+{
+    const auto setup = [](QCPGraph* graph) {
+        graph->setSamplingStrategy(QCPGraph::ssM4);
+    };
+    QCOMPARE(replotAllocations(setup, true), 0L);
+    QCOMPARE(replotAllocations(setup, false), 0L);
+}
+
+void ReplotAllocations::lttb()
+{
+    const auto setup = [](QCPGraph* graph) {
+        graph->setSamplingStrategy(QCPGraph::ssLttb);
+    };
+    QCOMPARE(replotAllocations(setup, true), 0L);
+    QCOMPARE(replotAllocations(setup, false), 0L);
+}
+
+void ReplotAllocations::withoutSampling()
+{
+    const auto setup = [](QCPGraph* graph) {
+        graph->setAdaptiveSampling(false);
+    };
+    QCOMPARE(replotAllocations(setup, true), 0L);
+    QCOMPARE(replotAllocations(setup, false), 0L);
+}
+
+void ReplotAllocations::scatters()
+{
+    const auto setup = [](QCPGraph* graph) {
+        graph->setScatterStyle(QCPScatterStyle{QCPScatterStyle::ssCircle, 4});
+    };
+    QCOMPARE(replotAllocations(setup, true), 0L);
+
+    const auto deduplicated = [](QCPGraph* graph) {
+        graph->setLineStyle(QCPGraph::lsNone);
+        graph->setScatterStyle(QCPScatterStyle{QCPScatterStyle::ssCircle, 4});
+        graph->setScatterDeduplication(true);
+    };
+    QCOMPARE(replotAllocations(deduplicated, true), 0L);
+}
+
+QTEST_MAIN(ReplotAllocations)
+
+#include "tst_replotallocations.moc"
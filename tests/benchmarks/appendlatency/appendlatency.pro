@@ -0,0 +1,4 @@
+TARGET = tst_bench_appendlatency
+include(../../tests.pri)
+
+SOURCES += tst_bench_appendlatency.cpp
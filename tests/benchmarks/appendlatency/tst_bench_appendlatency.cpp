@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "qcustomplot.h"
+
+// Appends data points one at a time, the way a live stream does, and
+// reports how long the single appends take with either storage backend.
+// The percentiles show the typical append, the maximum shows the hitches
+// when the storage grows.
+class AppendLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void vectorStorage();
+    void blockStorage();
+};
+
+namespace
+{
+
+const int pointCount{20000000};
+
+qint64 percentile(const QVector<qint64>& sorted, double fraction)
+{
+    const int index{static_cast<int>(fraction * sorted.size())};
+    return sorted.at(std::min(index, sorted.size() - 1));
+}
+
+template <typename Storage>
+void measure(const char* name)
+{
+    QCPDataContainer<QCPGraphData, Storage> container;
+    QVector<qint64> latencies(pointCount);
+
+    QElapsedTimer timer;
+    for (int i{0}; i < pointCount; ++i) {
+        const QCPGraphData point(i, std::sin(i * 0.001));
+        timer.start();
+        container.add(point);
+        latencies[i] = timer.nsecsElapsed();
+    }
+    QCOMPARE(container.size(), pointCount);
+
+    qint64 total{0};
+    for (const qint64 latency : latencies) {
+        total += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    // The growth of QVector depends on the Qt version, so it is printed
+    // with the measurements
+    qInfo("%s (Qt %s, %.1f bytes per point): %d appends in %.2f s, p50 %lld ns, p99 %lld ns, "
+          "p99.9 %lld ns, max %.2f ms",
+          name, qVersion(), double(container.memoryUsage()) / pointCount, pointCount, total / 1e9,
+          percentile(latencies, 0.5), percentile(latencies, 0.99),
+          percentile(latencies, 0.999), latencies.last() / 1e6);
+}
+
+} // namespace
+
+void AppendLatency::vectorStorage()
+{
+    measure<QVector<QCPGraphData>>("QVector");
+}
+
+void AppendLatency::blockStorage()
+{
+    measure<QCPDataBlockStorage<QCPGraphData>>("QCPDataBlockStorage");
+}
+
+QTEST_APPLESS_MAIN(AppendLatency)
+
+#include "tst_bench_appendlatency.moc"
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#include "qcustomplot.h"
+
+// Compares block storages that get their blocks from the heap with ones
+// that get them from a QCPHugePageAllocator: the page faults while
+// appending, the throughput of a min/max decimation pass over all data
+// points, and random lookups, which are bound by TLB misses. The last case
+// allocates and deallocates blocks while thousands of slabs are in use.
+class BlockAllocator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void heap();
+    void hugePages();
+    void manySlabs();
+};
+
+namespace
+{
+
+const int pointCount{20000000};
+const int frameCount{20};
+const int pixelCount{2000};
+const int lookupCount{2000000};
+
+using Container = QCPDataContainer<QCPGraphData, QCPDataBlockStorage<QCPGraphData>>;
+
+// Minor page faults of the process so far, or -1 where they aren't counted
+long pageFaults()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+#else
+    return -1;
+#endif
+}
+
+// The amount of memory backed by transparent huge pages, on Linux
+QByteArray hugePageUsage()
+{
+    QFile file{"/proc/self/smaps_rollup"};
+    if (file.open(QIODevice::ReadOnly)) {
+        for (const QByteArray& line : file.readAll().split('\n')) {
+            if (line.startsWith("AnonHugePages:")) {
+                return line.mid(14).simplified();
+            }
+        }
+    }
+
+    return "unknown";
+}
+
+void measure(const char* name)
+{
+    QElapsedTimer timer;
+    const long faultsBefore{pageFaults()};
+    timer.start();
+    Container container;
+    for (int i{0}; i < pointCount; ++i) {
+        container.add(QCPGraphData(i * 0.001, std::sin(i * 0.0001)));
+    }
+    const double appendTime{timer.nsecsElapsed() / 1e6};
+    const long appendFaults{faultsBefore < 0 ? -1 : pageFaults() - faultsBefore};
+    QCOMPARE(container.size(), pointCount);
+
+    // The point-wise min/max pass of adaptive sampling over the whole range
+    timer.start();
+    double sink{0};
+    const int perPixel{pointCount / pixelCount};
+    for (int frame{0}; frame < frameCount; ++frame) {
+        auto it{container.constBegin()};
+        for (int pixel{0}; pixel < pixelCount; ++pixel) {
+            double minimum{it->value};
+            double maximum{it->value};
+            for (const auto end{it + perPixel}; it != end; ++it) {
+                minimum = std::min(minimum, static_cast<double>(it->value));
+                maximum = std::max(maximum, static_cast<double>(it->value));
+            }
+            sink += maximum - minimum;
+        }
+    }
+    const double decimationRate{double(frameCount) * pointCount / timer.nsecsElapsed() * 1e3};
+
+    std::mt19937 generator{1};
+    std::uniform_int_distribution<int> index{0, pointCount - 1};
+    timer.start();
+    for (int i{0}; i < lookupCount; ++i) {
+        sink += container.findBegin(index(generator) * 0.001, false)->value;
+    }
+    const double lookupTime{timer.nsecsElapsed() / 1e6};
+    QVERIFY(sink != 0);
+
+    qInfo("%s: %d appends in %.0f ms with %ld page faults, decimation %.0f M points/s, "
+          "%d random lookups in %.0f ms, huge pages %s",
+          name, pointCount, appendTime, appendFaults, decimationRate, lookupCount, lookupTime,
+          hugePageUsage().constData());
+}
+
+} // namespace
+
+void BlockAllocator::heap()
+{
+    measure("heap");
+}
+
+void BlockAllocator::hugePages()
+{
+    QCPHugePageAllocator allocator;
+    QCPBlockAllocator::setInstance(&allocator);
+    measure("QCPHugePageAllocator");
+    QCPBlockAllocator::setInstance(nullptr);
+    QCOMPARE(allocator.slabCount(), 1);
+}
+
+void BlockAllocator::manySlabs()
+{
+    // Every other block is freed, so all slabs have room again, and is then
+    // allocated anew. The slabs are small, so there are thousands of them.
+    // The blocks are never written to, so they take up no physical memory.
+    const qint64 blockBytes{4096};
+    const int blockCount{200000};
+    QCPHugePageAllocator allocator{64 * 1024};
+    std::vector<void*> blocks(blockCount);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (auto& block : blocks) {
+        block = allocator.allocate(blockBytes);
+    }
+    const int slabs{allocator.slabCount()};
+    for (int i{0}; i < blockCount; i += 2) {
+        allocator.deallocate(blocks[i], blockBytes);
+    }
+    for (int i{0}; i < blockCount; i += 2) {
+        blocks[i] = allocator.allocate(blockBytes);
+    }
+    const double time{timer.nsecsElapsed() / 1e6};
+    QCOMPARE(allocator.slabCount(), slabs);
+
+    for (void* block : blocks) {
+        allocator.deallocate(block, blockBytes);
+    }
+    QCOMPARE(allocator.slabCount(), 1);
+
+    qInfo("%d allocations and %d deallocations of %lld bytes over %d slabs in %.1f ms",
+          blockCount * 3 / 2, blockCount / 2, blockBytes, slabs, time);
+}
+
+QTEST_APPLESS_MAIN(BlockAllocator)
+
+#include "tst_bench_blockallocator.moc"
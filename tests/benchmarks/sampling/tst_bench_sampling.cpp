@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <cmath>
+#include <random>
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "qcustomplot.h"
+
+// Reports how fast QCPGraph turns dense data into the lines it draws, with
+// each sampling strategy and without sampling. The line cache is cleared
+// before every pass, so all data points are sampled every time, like after
+// zooming or panning.
+class Sampling : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unsampled();
+    void adaptive();
+    void m4();
+    void lttb();
+};
+
+namespace
+{
+
+const int pointCount{2000000};
+const int passCount{10};
+const int width{1000};
+const int height{600};
+
+class Graph : public QCPGraph
+{
+public:
+    using QCPGraph::QCPGraph;
+
+    int sample(QVector<QPointF>& lines) const
+    {
+        mLineCache.valid = false;
+        getLines(&lines, QCPDataRange(0, dataCount()));
+        return lines.size();
+    }
+};
+
+void measure(const char* name, bool adaptiveSampling, QCPGraph::SamplingStrategy strategy)
+{
+    QCustomPlot plot;
+    plot.axisRect()->setAutoMargins(QCP::msNone);
+    plot.axisRect()->setMargins(QMargins());
+    plot.setViewport(QRect(0, 0, width, height));
+    Graph* graph{new Graph{plot.xAxis, plot.yAxis}};
+    graph->setAdaptiveSampling(adaptiveSampling);
+    graph->setSamplingStrategy(strategy);
+
+    std::mt19937 generator{1};
+    std::uniform_real_distribution<double> noise{0, 0.1};
+    QVector<double> keys(pointCount);
+    QVector<double> values(pointCount);
+    for (int i{0}; i < pointCount; ++i) {
+        keys[i] = i;
+        values[i] = std::sin(i * 1e-4) + noise(generator);
+    }
+    graph->setData(keys, values, true);
+    plot.xAxis->setRange(0, pointCount);
+    plot.yAxis->setRange(-2, 2);
+    plot.replot(); // lays out the axis rect
+
+    QVector<QPointF> lines;
+    graph->sample(lines); // warm-up
+    QElapsedTimer timer;
+    timer.start();
+    int pointsDrawn{0};
+    for (int pass{0}; pass < passCount; ++pass) {
+        pointsDrawn = graph->sample(lines);
+    }
+    const double time{timer.nsecsElapsed() / 1e6 / passCount};
+    QVERIFY(pointsDrawn > 0);
+
+    qInfo("%s: %.2f ms per pass over %d points (%.0f M points/s) on %d px, %d line points",
+          name, time, pointCount, pointCount / time / 1e3, width, pointsDrawn);
+}
+
+} // namespace
+
+void Sampling::unsampled()
+{
+    measure("unsampled", false, QCPGraph::ssAdaptive);
+}
+
+void Sampling::adaptive()
+{
+    measure("adaptive", true, QCPGraph::ssAdaptive);
+}
+
+void Sampling::m4()
+{
+    measure("M4", true, QCPGraph::ssM4);
+}
+
+void Sampling::lttb()
+{
+    measure("LTTB", true, QCPGraph::ssLttb);
+}
+
+QTEST_MAIN(Sampling)
+
+#include "tst_bench_sampling.moc"
@@ -0,0 +1,4 @@
+TARGET = tst_bench_sort
+include(../../tests.pri)
+
+SOURCES += tst_bench_sort.cpp
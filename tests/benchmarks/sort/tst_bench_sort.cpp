@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 Te Ropu Awhina (Victoria University of Wellington)
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ */
+
+#include <random>
+#include <algorithm>
+
+#include <QtTest>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+#include "qcustomplot.h"
+
+// Sorts bulk loads the way QCPDataContainer::set(data, false) does, and
+// compares the time with std::sort, which the container used before. The
+// results are checked against std::stable_sort.
+class Sort : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void randomKeys();
+    void shuffledTimestamps();
+    void fewRuns();
+    void manyRuns();
+    void alreadySorted();
+};
+
+namespace
+{
+
+const int pointCount{10000000};
+const double epoch{1.7e9};
+
+// The value holds the original index, so the stability can be checked
+QVector<QCPGraphData> timestamps()
+{
+    QVector<QCPGraphData> data(pointCount);
+    for (int i{0}; i < pointCount; ++i) {
+        data[i] = QCPGraphData(epoch + i * 0.001, i);
+    }
+
+    return data;
+}
+
+// Concatenated recordings of `devices` devices over the same time span
+QVector<QCPGraphData> runs(int devices)
+{
+    QVector<QCPGraphData> data(pointCount);
+    const int perDevice{pointCount / devices};
+    for (int i{0}; i < pointCount; ++i) {
+        data[i] = QCPGraphData(epoch + (i % perDevice) * 0.001 * devices + (i / perDevice) * 0.0001, i);
+    }
+
+    return data;
+}
+
+double milliseconds(const QElapsedTimer& timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+// Returns whether the data was sorted like std::stable_sort does
+bool measure(const char* name, const QVector<QCPGraphData>& data)
+{
+    QVector<QCPGraphData> expected{data};
+    std::stable_sort(expected.begin(), expected.end(), qcpLessThanSortKey<QCPGraphData>);
+
+    QVector<QCPGraphData> standard{data};
+    QElapsedTimer timer;
+    timer.start();
+    std::sort(standard.begin(), standard.end(), qcpLessThanSortKey<QCPGraphData>);
+    const double standardTime{milliseconds(timer)};
+
+    QThreadPool* pool{QThreadPool::globalInstance()};
+    const int threads{pool->maxThreadCount()};
+    pool->setMaxThreadCount(1);
+    QVector<QCPGraphData> serial{data};
+    timer.start();
+    qcpSortByKey<QCPGraphData>(serial.begin(), serial.end());
+    const double serialTime{milliseconds(timer)};
+    pool->setMaxThreadCount(threads);
+
+    QVector<QCPGraphData> parallel{data};
+    timer.start();
+    qcpSortByKey<QCPGraphData>(parallel.begin(), parallel.end());
+    const double parallelTime{milliseconds(timer)};
+
+    qInfo("%s: std::sort %.0f ms, qcpSortByKey %.0f ms single threaded, %.0f ms on %d threads",
+          name, standardTime, serialTime, parallelTime, threads);
+
+    const auto same = [&expected](const QVector<QCPGraphData>& sorted) {
+        for (int i{0}; i < sorted.size(); ++i) {
+            if (sorted.at(i).key != expected.at(i).key || sorted.at(i).value != expected.at(i).value) {
+                return false;
+            }
+        }
+        return sorted.size() == expected.size();
+    };
+
+    return same(serial) && same(parallel);
+}
+
+} // namespace
+
+void Sort::randomKeys()
+{
+    std::mt19937 generator{1};
+    std::uniform_real_distribution<double> key{-1e6, 1e6};
+    QVector<QCPGraphData> data(pointCount);
+    for (int i{0}; i < pointCount; ++i) {
+        data[i] = QCPGraphData(key(generator), i);
+    }
+    QVERIFY(measure("random keys", data));
+}
+
+void Sort::shuffledTimestamps()
+{
+    QVector<QCPGraphData> data{timestamps()};
+    std::shuffle(data.begin(), data.end(), std::mt19937{2});
+    QVERIFY(measure("shuffled timestamps", data));
+}
+
+void Sort::fewRuns()
+{
+    QVERIFY(measure("5 sorted runs", runs(5)));
+}
+
+void Sort::manyRuns()
+{
+    QVERIFY(measure("40 sorted runs", runs(40)));
+}
+
+void Sort::alreadySorted()
+{
+    QVERIFY(measure("already sorted", timestamps()));
+}
+
+QTEST_APPLESS_MAIN(Sort)
+
+#include "tst_bench_sort.moc"
@@ -0,0 +1,12 @@
+# Settings shared by the tests and benchmarks. They are built against
+# QCustomPlot with the same defines as Birdview.
+
+QT += testlib widgets printsupport
+CONFIG += c++14 console
+CONFIG -= app_bundle
+DEFINES += QCUSTOMPLOT_USE_BLOCK_STORAGE QCUSTOMPLOT_COMPACT_GRAPH_DATA
+INCLUDEPATH += $$PWD/../qcustomplot $$PWD/../src
+!win32:QMAKE_CXXFLAGS += -Wfatal-errors
+
+HEADERS += $$PWD/../qcustomplot/qcustomplot.h
+SOURCES += $$PWD/../qcustomplot/qcustomplot.cpp